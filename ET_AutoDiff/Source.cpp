@@ -1,18 +1,32 @@
-#pragma once
-
 #include <iostream>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
 #include "et_autodiff.h"
-
-#if defined(_DEBUG)
-template <class T> constexpr std::string_view
-type_name()
-{
-	using namespace std;
-	string_view p = __FUNCSIG__;
-	return string_view(p.data() + 84, p.size() - 84 - 7);
-}
-#endif 
+#include "sweep.h"
+#include "runtime_expr.h"
+#include "codegen.h"
+#include "model.h"
+#include "graph_stats.h"
+#include "variable_binding.h"
+#include "metrics.h"
+#include "snapshot.h"
+#include "pipeline.h"
+#include "out_of_core.h"
+#include "virtual_tensor.h"
+#include "structured_matrix.h"
+#include "multiprocess.h"
+#include "param_server.h"
+#include "readme_objective_generated.h"
 
 void AutodiffTest() 
 {
@@ -40,6 +54,277 @@ void AutodiffTest()
 	std::cout << "Final Value : " << Optimizer.GetPostResult() << std::endl;
 }
 
+void PackedAutodiffTest()
+{
+	Et::ConstantExpr C1{ Et::PackD<8>{ 4.0 } }, C2{ Et::PackD<8>{ 2.0 } };
+	Et::VariableExpr X1{ Et::PackD<8>{ { 5.53, -1.0, 0.0, 2.5, 10.0, -7.25, 3.0, 0.5 } } };
+	Et::VariableExpr X2{ Et::PackD<8>{ { -3.12, 1.0, 4.0, -2.5, 0.0, 6.5, -9.0, 1.5 } } };
+	Et::PlaceholderExpr<Et::PackD<8>> P;
+
+	auto Y = X1 * X1 + X2 * X2 + C1 * X1 + C2 * X2 + P;
+
+	Et::GradientDescentOptimizer Optimizer{ Y };
+
+	int Iterations = 500;
+	for (int i = 0; i < Iterations; i++)
+	{
+		Optimizer
+			.ForwardPass(Et::H(P, Et::PackD<8>{ -6.3 }))
+			.Minimize(0.01);
+	}
+	auto const Final = Optimizer.GetPostResult();
+	bool Converged = true;
+	for (size_t i = 0; i < 8; i++)
+	{
+		Converged = Converged && std::abs(Final[i] + 11.3) < 1e-3;
+	}
+	std::cout << "Final Values : " << Final << ", converged : " << (Converged ? "yes" : "no") << std::endl;
+}
+
+void SweepTest()
+{
+	auto Jobs = Et::MakeSweepJobs({ 0.001, 0.01, 0.1, 0.5 }, { { 5.53, -3.12 }, { -20.0, 20.0 }, { 100.0, 0.0 } });
+
+	Et::SweepOptions Options;
+	Options.iterations = 1000;
+	Options.min_iterations = 50;
+
+	auto Results = Et::SweepRunner{ Options }.Run(Jobs, [](Et::SweepControl& Control)
+	{
+		auto const& Job = Control.Job();
+
+		Et::ConstantExpr C1{ 4 }, C2{ 2 };
+		Et::VariableExpr X1{ Job.initial_values[0] }, X2{ Job.initial_values[1] };
+		Et::PlaceholderExpr P;
+
+		auto Y = X1 * X1 + X2 * X2 + C1 * X1 + C2 * X2 + P;
+
+		Et::GradientDescentOptimizer Optimizer{ Y };
+
+		for (int i = 1; Control.Report(i, Optimizer.ForwardPass(Et::H(P, -6.3)).Minimize(Job.learning_rate).GetPreResult()); i++);
+		return double(Optimizer.GetPostResult());
+	});
+
+	Et::PrintSweepTable(std::cout, Results);
+
+	double Best = Results.empty() ? 0.0 : Results.front().loss;
+	for (auto const& Result : Results)
+	{
+		Best = std::min(Best, Result.loss);
+	}
+	bool const Converged = Results.size() == Jobs.size() && std::abs(Best + 11.3) < 1e-6;
+	std::cout << "Best loss : " << Best << ", converged : " << (Converged ? "yes" : "no") << std::endl;
+}
+
+void RuntimeExprTest()
+{
+	auto Program = Et::Runtime::Compile("x1^2 + x2^2 + 4*x1 + 2*x2 + p", { "x1", "x2" }, { "p" });
+	Program.Disassemble(std::cout);
+
+	Et::Runtime::Evaluator Evaluator{ Program };
+	std::vector<double> Variables{ 5.53, -3.12 }, Placeholders{ -6.3 }, Gradient;
+
+	int Iterations = 500;
+	for (int i = 0; i < Iterations; i++)
+	{
+		Evaluator.Gradient(Variables, Placeholders, Gradient);
+		for (size_t j = 0; j < Variables.size(); j++)
+		{
+			Variables[j] -= 0.01 * Gradient[j];
+		}
+	}
+	std::cout << "Final Value : " << Evaluator.Forward(Variables, Placeholders) << std::endl;
+}
+
+void CodegenBenchmark()
+{
+	auto const Program = Et::Runtime::Compile("x1^2 + x2^2 + 4*x1 + 2*x2 + p", { "x1", "x2" }, { "p" });
+	std::cout << Et::Runtime::EmitCpp(Program, "ReadmeObjective") << std::endl;
+	std::ofstream{ "readme_objective_emitted.h", std::ios::binary } << Et::Runtime::EmitCppHeader(Program, "ReadmeObjective");
+
+	int Iterations = 1000000;
+
+	Et::ConstantExpr C1{ 4 }, C2{ 2 };
+	Et::VariableExpr X1{ 5.53 }, X2{ -3.12 };
+	Et::PlaceholderExpr P;
+
+	auto Y = X1 * X1 + X2 * X2 + C1 * X1 + C2 * X2 + P;
+
+	Et::GradientDescentOptimizer Optimizer{ Y };
+
+	auto begin = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < Iterations; i++)
+	{
+		Optimizer.ForwardPass(Et::H(P, -6.3)).Minimize(0.01);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	auto et_ns = std::chrono::duration<double, std::nano>(end - begin).count() / Iterations;
+
+	double Variables[2]{ 5.53, -3.12 }, Placeholders[1]{ -6.3 }, Gradient[2];
+
+	begin = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < Iterations; i++)
+	{
+		ReadmeObjective_gradient(Variables, Placeholders, Gradient);
+		Variables[0] -= 0.01 * Gradient[0];
+		Variables[1] -= 0.01 * Gradient[1];
+	}
+	end = std::chrono::high_resolution_clock::now();
+	auto generated_ns = std::chrono::duration<double, std::nano>(end - begin).count() / Iterations;
+
+	std::cout << "GradientDescentOptimizer : " << et_ns << "ns/iteration, final value " << Optimizer.GetPostResult() << std::endl;
+	std::cout << "Generated straight-line  : " << generated_ns << "ns/iteration, final value " << ReadmeObjective(Variables, Placeholders) << std::endl;
+	bool const Matches = std::abs(ReadmeObjective(Variables, Placeholders) - double(Optimizer.GetPostResult())) < 1e-9;
+	std::cout << "generated matches : " << (Matches ? "yes" : "no") << std::endl;
+}
+
+void ModelTest()
+{
+	Et::ConstantExpr C1{ 4 }, C2{ 2 };
+	Et::VariableExpr X1{ 5.53 }, X2{ -3.12 };
+	Et::PlaceholderExpr P;
+
+	auto Y = X1 * X1 + X2 * X2 + C1 * X1 + C2 * X2 + P;
+
+	Et::GradientDescentOptimizer Optimizer{ Y };
+
+	int Iterations = 500;
+	for (int i = 0; i < Iterations; i++)
+	{
+		Optimizer.ForwardPass(Et::H(P, -6.3)).Minimize(0.01);
+	}
+
+	Et::Runtime::SaveModel("readme_objective.etmd", Y, { { "x1", X1 }, { "x2", X2 } }, { { "p", P } });
+
+	auto Model = Et::Runtime::LoadModel("readme_objective.etmd");
+	Et::Runtime::Evaluator Evaluator{ Model.program };
+	std::cout << "Served Value : " << Evaluator.Forward(Model.variables, { -6.3 }) << std::endl;
+
+	std::ifstream Input{ "readme_objective.etmd", std::ios::binary };
+	std::vector<char> Bytes{ std::istreambuf_iterator<char>{ Input }, std::istreambuf_iterator<char>{} };
+	Et::Runtime::ModelHeader Header{};
+	std::memcpy(&Header, Bytes.data(), sizeof(Header));
+	Et::Runtime::ModelInstruction Original{};
+	std::memcpy(&Original, Bytes.data() + Header.code_offset, sizeof(Original));
+	Et::Runtime::ModelInstruction Corrupt = Original;
+	Corrupt.op = static_cast<uint8_t>(Et::Runtime::OpCode::Sin);
+	Corrupt.second = 0xFFFFFFFFu;
+	std::memcpy(Bytes.data() + Header.code_offset, &Corrupt, sizeof(Corrupt));
+	std::ofstream{ "corrupt_objective.etmd", std::ios::binary }.write(Bytes.data(), static_cast<std::streamsize>(Bytes.size()));
+
+	bool Rejected = false;
+	try
+	{
+		Et::Runtime::LoadModel("corrupt_objective.etmd");
+	}
+	catch (Et::Runtime::ModelError const& Error)
+	{
+		std::cout << "Corrupt model : " << Error.what() << std::endl;
+		Rejected = true;
+	}
+
+	std::memcpy(Bytes.data() + Header.code_offset, &Original, sizeof(Original));
+	Et::Runtime::ModelShape const Tensor{ 1, { 8, 0, 0, 0 } };
+	std::memcpy(Bytes.data() + Header.shapes_offset, &Tensor, sizeof(Tensor));
+	std::ofstream{ "tensor_objective.etmd", std::ios::binary }.write(Bytes.data(), static_cast<std::streamsize>(Bytes.size()));
+
+	bool Shaped = false;
+	try
+	{
+		Et::Runtime::LoadModel("tensor_objective.etmd");
+	}
+	catch (Et::Runtime::ModelError const& Error)
+	{
+		std::cout << "Tensor-valued model : " << Error.what() << std::endl;
+		Shaped = true;
+	}
+
+	bool Unnamed = false;
+	try
+	{
+		Et::Runtime::LowerModel(Y, { { "x1", X1 } }, { { "p", P } });
+	}
+	catch (Et::Runtime::ModelError const& Error)
+	{
+		std::cout << "Unnamed variable : " << Error.what() << std::endl;
+		Unnamed = true;
+	}
+	std::cout << "corrupt rejected : " << (Rejected && Shaped && Unnamed ? "yes" : "no") << std::endl;
+}
+
+void ProfileTest()
+{
+	Et::ConstantExpr C1{ 4 }, C2{ 2 };
+	Et::VariableExpr X1{ 5.53 }, X2{ -3.12 };
+	Et::PlaceholderExpr P;
+
+	auto Y = sin(X1) * log(X1 * X1) + tan(X2 / C1) + pow(X2, C1) / C2 + P;
+
+	Et::GradientDescentOptimizer Optimizer{ Y };
+
+	double const Initial = Optimizer.ForwardPass(Et::H(P, -6.3)).GetPreResult();
+	int Iterations = 10000;
+	for (int i = 0; i < Iterations; i++)
+	{
+		Optimizer.ForwardPass(Et::H(P, -6.3)).Minimize(0.0001);
+	}
+	Et::Profile::Report(std::cout);
+	double const Final = Optimizer.GetPostResult();
+	std::cout << "loss decreased : " << (std::isfinite(Final) && Final < Initial ? "yes" : "no") << std::endl;
+}
+
+void TraceTest()
+{
+	Et::Trace::TraceOptions Options;
+	Options.sample_every = 10;
+	Et::Trace::Start(Options);
+
+	SweepTest();
+
+	Et::Trace::Stop();
+	Et::Trace::WriteChromeJson("sweep.trace.json");
+
+#if defined(ET_TRACE)
+	std::ifstream Stream{ "sweep.trace.json" };
+	std::string const Json{ std::istreambuf_iterator<char>{ Stream }, std::istreambuf_iterator<char>{} };
+	bool Written = true;
+	for (char const* Name : { "\"name\":\"ForwardPass\"", "\"name\":\"Backward\"", "\"name\":\"Update\"" })
+	{
+		Written = Written && Json.find(Name) != std::string::npos;
+	}
+	std::cout << "trace written : " << (Written ? "yes" : "no") << std::endl;
+#else
+	std::cout << "trace written : disabled" << std::endl;
+#endif
+}
+
+void PerfCounterTest()
+{
+	Et::ConstantExpr C1{ 4 }, C2{ 2 };
+	Et::VariableExpr X1{ 5.53 }, X2{ -3.12 };
+	Et::PlaceholderExpr P;
+
+	auto Y = sin(X1) * log(X1 * X1) + tan(X2 / C1) + pow(X2, C1) / C2 + P;
+
+	Et::GradientDescentOptimizer Optimizer{ Y };
+
+	double const Initial = Optimizer.ForwardPass(Et::H(P, -6.3)).GetPreResult();
+	for (int i = 0; i < 10000; i++)
+	{
+		Optimizer.ForwardPass(Et::H(P, -6.3)).Minimize(0.0001);
+	}
+
+	auto x = TTest::TensorFactory::MakeTensorWithInitValue<double, 512, 512>(5.0);
+	auto y = TTest::TensorFactory::MakeTensorWithInitValue<double, 512, 512>(1.2);
+	for (int i = 0; i < 20; i++)
+	{
+		auto z = x * y + sin(x);
+	}
+	Et::Perf::Report(std::cout);
+	double const Final = Optimizer.GetPostResult();
+	std::cout << "loss decreased : " << (std::isfinite(Final) && Final < Initial ? "yes" : "no") << std::endl;
+}
+
 void TensorTests()
 {
 	auto x = TTest::TensorFactory::MakeTensorWithInitValue<double, 100, 10>(5.0);
@@ -47,18 +332,862 @@ void TensorTests()
 	auto a = TTest::TensorFactory::MakeTensorWithInitValue<double, 100, 10>(1.2);
 	auto z = 4 * x * y - tan(a) + a + log(a / y);
 	std::cout << z(3, 4) << std::endl;
+	bool const Matches = std::abs(z(3, 4) - (4 * 5.0 * 1.2 - std::tan(1.2) + 1.2 + std::log(1.2 / 1.2))) < 1e-12;
+	std::cout << "matches scalar : " << (Matches ? "yes" : "no") << std::endl;
+}
+
+void AllocationTest()
+{
+	auto x = TTest::TensorFactory::MakeTensorWithInitValue<double, 100, 10>(5.0);
+	auto y = TTest::TensorFactory::MakeTensorWithInitValue<double, 100, 10>(1.2);
+	auto z = TTest::TensorFactory::MakeZeroTensor<double, 100, 10>();
+
+	TTest::AllocationCheckpoint Steady;
+	for (int i = 0; i < 100; i++)
+	{
+		TTEST_ALLOCATION_SITE("AllocationTest loop");
+		z = 4 * x * y + log(x / y);
+	}
+	auto const LeakedBytes = Steady.LiveBytesDelta();
+	std::cout << "Allocations per iteration : " << Steady.Allocations() / 100 << ", leaked bytes : " << LeakedBytes << std::endl;
+
+	TTest::AllocationCheckpoint InPlace;
+	auto it1 = x.cbegin();
+	auto it2 = y.cbegin();
+	for (auto it3 = z.cbegin(); it3 != z.cend(); it1++, it2++, it3++)
+	{
+		*it3 = 4 * *it1 * *it2 + std::log(*it1 / *it2);
+	}
+	bool const InPlaceFree = InPlace.AllocationFree();
+
+	TTest::ReportAllocations(std::cout);
+	std::cout << "in place allocation free : " << (InPlaceFree && LeakedBytes == 0 ? "yes" : "no") << std::endl;
+}
+
+void GraphStatsTest()
+{
+	Et::ConstantExpr C1{ 4 }, C2{ 2 };
+	Et::VariableExpr X1{ 5.53 }, X2{ -3.12 };
+	Et::PlaceholderExpr P;
+
+	auto Y = X1 * X1 + X2 * X2 + C1 * X1 + C2 * X2 + P;
+
+	constexpr Et::GraphStats Stats = Et::graph_stats_v<decltype(Y)>;
+	static_assert(Stats.nodes == 17 && Stats.variables == 6 && Stats.binary == 8 && Stats.depth == 6);
+	static_assert(Stats.storage_bytes == sizeof(Et::dfs_final_tuple_t<decltype(Y)>));
+	static_assert(Stats.gradient_bytes == 8 * sizeof(Et::ScalarD) + 6 * sizeof(Et::GradSlot<Et::ScalarD>));
+
+	Et::PrintGraph(std::cout, Y);
+	std::cout << "unique variables : " << Et::UniqueVariableCount(Y) << std::endl;
+}
+
+void MetricsTest()
+{
+	Et::ConstantExpr C1{ 4 }, C2{ 2 };
+	Et::VariableExpr X1{ 5.53 }, X2{ -3.12 };
+	Et::PlaceholderExpr P;
+
+	auto Y = X1 * X1 + X2 * X2 + C1 * X1 + C2 * X2 + P;
+
+	Et::GradientDescentOptimizer Optimizer{ Y };
+
+	int const Iterations = 100000;
+	bool Sealed = false;
+	{
+		Et::Metrics::Sink Sink{ "metrics.etms" };
+		uint32_t const Loss = Sink.Register("loss");
+		uint32_t const X1Value = Sink.Register("x1");
+		Sink.Start();
+
+		auto const Begin = std::chrono::steady_clock::now();
+		for (int i = 0; i < Iterations; i++)
+		{
+			Sink.Record(Loss, i, Optimizer.ForwardPass(Et::H(P, -6.3)).Minimize(0.01).GetPreResult());
+			Sink.Record(X1Value, i, X1());
+			if (i == Iterations / 2)
+			{
+				Sink.Stop();
+				Sink.Start();
+			}
+		}
+		try
+		{
+			Sink.Register("late");
+		}
+		catch (std::logic_error const&)
+		{
+			Sealed = true;
+		}
+		auto const Elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Begin).count();
+		std::cout << "ns per iteration with two metrics : " << Elapsed / Iterations << std::endl;
+	}
+
+	std::ifstream Stream{ "metrics.etms", std::ios::binary };
+	auto const Log = Et::Metrics::ReadBinary(Stream);
+	std::ostringstream Undrained;
+	uint64_t Dropped = 0;
+	{
+		Et::Metrics::Sink Small{ Undrained, Et::Metrics::Encoding::Csv, 8 };
+		uint32_t const Loss = Small.Register("loss");
+		for (int i = 0; i < 20; i++)
+		{
+			Small.Record(Loss, i, 0.0);
+		}
+		Dropped = Small.Dropped();
+	}
+
+	std::string const Buffered = Undrained.str();
+	bool const Flushed = std::count(Buffered.begin(), Buffered.end(), '\n') == 9;
+	bool const Complete = Log.samples.size() == 2 * Iterations && Log.names.size() == 2 && Dropped == 12 && Flushed && Sealed;
+	std::cout << "Samples read back : " << Log.samples.size() << ", complete : " << (Complete ? "yes" : "no");
+	if (Complete)
+	{
+		std::cout << ", final " << Log.names[Log.samples[Log.samples.size() - 2].metric] << " : " << Log.samples[Log.samples.size() - 2].value;
+	}
+	std::cout << std::endl;
+
+	Et::Metrics::Sink Csv{ std::cout };
+	uint32_t const Loss = Csv.Register("loss");
+	Csv.Start();
+	for (int i = 0; i < 5; i++)
+	{
+		Csv.Record(Loss, i, Optimizer.ForwardPass(Et::H(P, -6.3)).Minimize(0.01).GetPreResult());
+	}
+}
+
+template <typename V>
+auto WideGraphLoss(V const& Start, Et::ThreadPool* Pool) -> V
+{
+	Et::ConstantExpr C{ V{ 0.5 } };
+	Et::VariableExpr X1{ Start }, X2{ Start }, X3{ Start }, X4{ Start };
+	Et::PlaceholderExpr<V> P;
+
+	auto Y = (sin(X1 * C) + cos(X2 * X1)) * (sin(X3 * C) + cos(X4 * X3)) + (X1 * X2 + X3 * X4) * P;
+
+	Et::GradientDescentOptimizer Optimizer{ Y };
+	Optimizer.SetMinForkBytes(0);
+	for (int i = 0; i < 20; i++)
+	{
+		if (Pool)
+		{
+			Optimizer.ParallelForwardPass(*Pool, Et::H(P, V{ 0.1 })).ParallelMinimize(*Pool, 0.01);
+		}
+		else
+		{
+			Optimizer.ForwardPass(Et::H(P, V{ 0.1 })).Minimize(0.01);
+		}
+	}
+	return Optimizer.GetPostResult();
+}
+
+void ParallelEvalTest()
+{
+	using V = Et::PackD<4096>;
+	V Start{ 0.0 };
+	for (size_t i = 0; i < 4096; i++)
+	{
+		Start[i] = 0.001 * static_cast<double>(i);
+	}
+
+	Et::ThreadPool Pool{ 3 };
+	auto const Begin = std::chrono::steady_clock::now();
+	V const Sequential = WideGraphLoss(Start, nullptr);
+	auto const Middle = std::chrono::steady_clock::now();
+	V const Parallel = WideGraphLoss(Start, &Pool);
+	auto const End = std::chrono::steady_clock::now();
+
+	size_t Mismatches = 0;
+	for (size_t i = 0; i < 4096; i++)
+	{
+		Mismatches += Sequential[i] != Parallel[i] ? 1 : 0;
+	}
+	std::cout << "Parallel matches sequential : " << (Mismatches == 0 ? "yes" : "no") << std::endl;
+	std::cout << "Mismatched lanes : " << Mismatches << ", sequential : " << std::chrono::duration_cast<std::chrono::microseconds>(Middle - Begin).count() << "us, parallel : "
+		<< std::chrono::duration_cast<std::chrono::microseconds>(End - Middle).count() << "us, value[1000] : " << Parallel[1000] << std::endl;
+}
+
+void OutOfCoreTest()
+{
+	constexpr size_t Elements = size_t{ 1 } << 21;
+	constexpr size_t M = 512, K = 384, N = 96;
+	TTest::StreamOptions Options;
+	Options.tile_bytes = size_t{ 1 } << 20;
+	TTest::TileStream Stream{ Options };
+
+	bool Matches = true;
+	{
+		auto A = TTest::MappedTensor<double, Elements>::Create("outofcore_a.bin");
+		auto B = TTest::MappedTensor<double, Elements>::Create("outofcore_b.bin");
+		auto C = TTest::MappedTensor<double, Elements>::Create("outofcore_c.bin");
+		for (size_t i = 0; i < Elements; i++)
+		{
+			A(i) = static_cast<double>(i % 1024);
+			B(i) = 0.5;
+		}
+		Stream.Transform(C, [](double X, double Y) { return X * Y + 1.0; }, A, B);
+		double const Total = Stream.Sum(C);
+		Matches = Matches && Total == Elements / 1024 * (0.5 * 1023 * 1024 / 2 + 1024);
+	}
+	{
+		auto A = TTest::MappedTensor<double, M, K>::Create("outofcore_a.bin");
+		auto B = TTest::MappedTensor<double, K, N>::Create("outofcore_b.bin");
+		auto C = TTest::MappedTensor<double, M, N>::Create("outofcore_c.bin");
+		auto DenseA = TTest::TensorFactory::MakeTensorWithRandomValues<double, M, K>(-1.0, 1.0);
+		auto DenseB = TTest::TensorFactory::MakeTensorWithRandomValues<double, K, N>(-1.0, 1.0);
+		std::copy(DenseA.cbegin(), DenseA.cend(), A.cbegin());
+		std::copy(DenseB.cbegin(), DenseB.cend(), B.cbegin());
+		auto const Input = TTest::MappedTensor<double, M, K>::Open("outofcore_a.bin");
+		Stream.Matmul(Input, B, C);
+		try
+		{
+			TTest::MappedTensor<double, M, K + 1>::Open("outofcore_a.bin");
+			Matches = false;
+		}
+		catch (std::runtime_error const&)
+		{
+		}
+		auto const Dense = TTest::matmul(DenseA, DenseB);
+		double MaxError = 0.0;
+		for (size_t j = 0; j < N; j++)
+		{
+			for (size_t i = 0; i < M; i++)
+			{
+				MaxError = std::max(MaxError, std::abs(C(i, j) - Dense(i, j)));
+			}
+		}
+		Matches = Matches && MaxError < 1e-9;
+	}
+	for (char const* Path : { "outofcore_a.bin", "outofcore_b.bin", "outofcore_c.bin" })
+	{
+		std::remove(Path);
+	}
+
+	auto const& Stats = Stream.Stats();
+	std::cout << "Tiles : " << Stats.tiles << ", streamed : " << Stats.bytes / (1 << 20) << " MiB at " << Stats.bytes / Stats.seconds / (1 << 30)
+		<< " GiB/s, passes over A : " << Stats.matmul_passes << ", matches dense : " << (Matches ? "yes" : "no") << std::endl;
+}
+
+void VirtualTensorTest()
+{
+	auto y = TTest::TensorFactory::MakeTensorWithInitValue<double, 100, 10>(1.2);
+	double Shift = 0.5;
+
+	auto x = TTest::VirtualTensorFactory::MakeConstant<double, 100, 10>(5.0);
+	auto a = TTest::VirtualTensorFactory::MakeIota<double, 100, 10>(1.0, 0.001);
+	auto Noise = TTest::VirtualTensorFactory::MakeRandom<double, 100, 10>(-1.0, 1.0, 42);
+	auto Offset = TTest::VirtualTensorFactory::MakeBroadcast<double, 100, 10>(Shift);
+
+	TTest::AllocationCheckpoint Generated;
+	auto const Lazy = 4 * x - tan(a) + a + Offset + 0.01 * Noise;
+	double const LazySum = sum(Lazy);
+	bool const NoStorage = Generated.AllocationFree();
+
+	auto z = Lazy * y;
+	auto const Dense = 4 * x.Materialize() * y - tan(a.Materialize()) * y + a.Materialize() * y + Offset.Materialize() * y + 0.01 * Noise.Materialize() * y;
+	double MaxError = std::abs(LazySum - sum(Lazy.Materialize()));
+	for (size_t j = 0; j < 10; j++)
+	{
+		for (size_t i = 0; i < 100; i++)
+		{
+			MaxError = std::max(MaxError, std::abs(z(i, j) - Dense(i, j)));
+		}
+	}
+	bool const Repeatable = Noise(7, 3) == TTest::VirtualTensorFactory::MakeRandom<double, 100, 10>(-1.0, 1.0, 42)(7, 3);
+
+	std::cout << "Sum : " << LazySum << ", allocation free : " << (NoStorage ? "yes" : "no") << ", repeatable : " << (Repeatable ? "yes" : "no")
+		<< ", matches dense : " << (MaxError < 1e-9 && NoStorage && Repeatable ? "yes" : "no") << std::endl;
 }
 
-int main()
+template <bool Solve, typename S, typename B>
+auto StructuredError(S const& Matrix, B const& Dense) -> double
 {
+	auto const Product = matmul(Matrix, Dense);
+	auto const Reference = TTest::matmul(Num::ToDense(Matrix), Dense);
+	double Error = 0.0;
+	for (auto it1 = Product.cbegin(), it2 = Reference.cbegin(); it1 != Product.cend(); it1++, it2++)
+	{
+		Error = std::max(Error, std::abs(*it1 - *it2));
+	}
+	if constexpr (Solve)
+	{
+		auto const Solved = solve(Matrix, Product);
+		for (auto it1 = Solved.cbegin(), it2 = Dense.cbegin(); it1 != Solved.cend(); it1++, it2++)
+		{
+			Error = std::max(Error, std::abs(*it1 - *it2));
+		}
+	}
+	return Error;
+}
+
+void StructuredMatrixTest()
+{
+	constexpr size_t N = 64, K = 8;
+	auto const Dense = TTest::TensorFactory::MakeTensorWithRandomValues<double, N, K>(-1.0, 1.0);
+	auto const Random = TTest::VirtualTensorFactory::MakeRandom<double, 4096>(-1.0, 1.0, 3);
+
+	Num::Diagonal<double, N> D;
+	Num::Banded<double, N, 2, 1> B;
+	Num::Triangular<double, N, Num::Triangle::Lower> L;
+	Num::Triangular<double, N, Num::Triangle::Upper> U;
+	Num::LowRank<double, N, N, 4> R;
+	for (size_t i = 0; i < R.coefficients_v; i++)
+	{
+		R[i] = Random(i);
+		L[i] = 0.1 * Random(i + 512);
+		U[i] = 0.1 * Random(i + 1024);
+		if (i < B.coefficients_v)
+		{
+			B[i] = 0.1 * Random(i + 2048);
+		}
+	}
+	for (size_t i = 0; i < N; i++)
+	{
+		D[i] = 1.0 + Random(i + 3072) * 0.5;
+		B(i, i) = L(i, i) = U(i, i) = 4.0 + Random(i + 3584);
+	}
+
+	double Error = std::max({ StructuredError<true>(D, Dense), StructuredError<true>(B, Dense), StructuredError<true>(L, Dense), StructuredError<true>(U, Dense), StructuredError<false>(R, Dense) });
+
+	auto const SparseSin = Num::ToDense(sin(B) + 2.0 * B);
+	auto const DenseSin = TTest::sin(Num::ToDense(B)) + 2.0 * Num::ToDense(B);
+	auto const Cosine = cos(U);
+	auto const DenseU = Num::ToDense(U);
+	auto const Scaled = Num::ToDense(Num::map_coefficients(R, [](double x) { return 2.0 * x; }));
+	for (size_t j = 0; j < N; j++)
+	{
+		for (size_t i = 0; i < N; i++)
+		{
+			Error = std::max({ Error, std::abs(SparseSin(i, j) - DenseSin(i, j)), std::abs(Cosine(i, j) - std::cos(DenseU(i, j))), std::abs(Scaled(i, j) - 4.0 * R(i, j)) });
+		}
+	}
+
+	using Band = Num::Banded<double, 8, 1, 1>;
+	using Diag = Num::Diagonal<double, 8>;
+	Band Target;
+	Diag Half;
+	for (size_t i = 0; i < Target.coefficients_v; i++)
+	{
+		Target[i] = 0.8 * Random(i);
+		if (i < Half.coefficients_v)
+		{
+			Half[i] = 0.25 + 0.1 * Random(i + 64);
+		}
+	}
+	Et::VariableExpr W{ Band{ 0.0 } };
+	Et::VariableExpr S{ Diag{ 0.0 } };
+	Et::ConstantExpr C{ Diag{ 2.0 } };
+	Et::PlaceholderExpr<Band> T;
+	Et::PlaceholderExpr<Diag> P;
+	auto BandLoss = (sin(W) - T) * (sin(W) - T);
+	auto DiagonalLoss = (tan(S) * C - P) * (tan(S) * C - P);
+	Et::GradientDescentOptimizer BandOptimizer{ BandLoss };
+	Et::GradientDescentOptimizer DiagonalOptimizer{ DiagonalLoss };
+	for (int i = 0; i < 400; i++)
+	{
+		BandOptimizer.ForwardPass(Et::H(T, sin(Target))).Minimize(0.2);
+		DiagonalOptimizer.ForwardPass(Et::H(P, Half)).Minimize(0.2);
+	}
+	double Fit = 0.0;
+	for (size_t i = 0; i < Target.coefficients_v; i++)
+	{
+		Fit = std::max(Fit, std::abs(W()[i] - Target[i]));
+	}
+	for (size_t i = 0; i < Half.coefficients_v; i++)
+	{
+		Fit = std::max(Fit, std::abs(S()[i] - std::atan(Half[i] / 2.0)));
+	}
+
+	std::cout << "Structured max error : " << Error << ", band fit error : " << Fit << ", band coefficients : " << Band::coefficients_v
+		<< " of " << 8 * 8 << ", matches dense : " << (Error < 1e-9 && Fit < 1e-6 ? "yes" : "no") << std::endl;
+}
+
+void SnapshotTest()
+{
+	Et::ConstantExpr C1{ 4 }, C2{ 2 };
+	Et::VariableExpr X1{ 5.53 }, X2{ -3.12 };
+	Et::PlaceholderExpr P;
+	auto Y = X1 * X1 + X2 * X2 + C1 * X1 + C2 * X2 + P;
+	Et::GradientDescentOptimizer Optimizer{ Y };
+	Et::Snapshot::ParameterPublisher Publisher{ Y };
+
+	constexpr int Steps = 20000;
+	constexpr int PublishEvery = 10;
+	std::atomic<bool> Training{ true };
+	std::atomic<uint64_t> Reads{ 0 }, OutOfOrder{ 0 }, Torn{ 0 };
+
+	auto Serve = [&]()
+	{
+		Et::ConstantExpr R1{ 4 }, R2{ 2 };
+		Et::VariableExpr Z1{ 0.0 }, Z2{ 0.0 };
+		Et::PlaceholderExpr Q;
+		auto Replica = Z1 * Z1 + Z2 * Z2 + R1 * Z1 + R2 * Z2 + Q;
+		Et::GradientDescentOptimizer Evaluator{ Replica };
+		Et::VariableBinding Binding{ Replica };
+		auto Reader = Publisher.MakeReader();
+
+		uint64_t Last = 0;
+		while (Training.load(std::memory_order_relaxed))
+		{
+			{
+				auto const Snapshot = Reader.Read();
+				OutOfOrder += Snapshot.Version() < Last;
+				Last = Snapshot.Version();
+				double const Decay = std::pow(0.98, static_cast<double>(Snapshot->step));
+				Torn += std::abs(Snapshot->values[0] - (-2.0 + 7.53 * Decay)) > 1e-9 || std::abs(Snapshot->values[1] - (-1.0 - 2.12 * Decay)) > 1e-9;
+				Binding.Write(Snapshot->values.data());
+			}
+			Evaluator.ForwardPass(Et::H(Q, -6.3));
+			Reads++;
+		}
+	};
+
+	std::thread Servers[] = { std::thread{ Serve }, std::thread{ Serve } };
+	size_t MaxPending = 0;
+	for (int i = 1; i <= Steps; i++)
+	{
+		Optimizer.ForwardPass(Et::H(P, -6.3)).Minimize(0.01);
+		if (i % PublishEvery == 0)
+		{
+			Publisher.Publish(i);
+			MaxPending = std::max(MaxPending, Publisher.GetCell().Pending());
+			std::this_thread::yield();
+		}
+	}
+	Training = false;
+	for (auto& Server : Servers)
+	{
+		Server.join();
+	}
+
+	Publisher.GetCell().Reclaim();
+	size_t const Leaked = Publisher.GetCell().Pending();
+
+	auto Reader = Publisher.MakeReader();
+	auto const Latest = Reader.Read();
+	bool const MatchesTrainer = Latest->step == Steps && Latest->values[0] == double(X1()) && Latest->values[1] == double(X2());
+	std::cout << "Snapshots published : " << Latest.Version() << ", reads : " << Reads << ", out of order : " << OutOfOrder << ", torn : " << Torn
+		<< ", max pending : " << MaxPending << " of " << Steps / PublishEvery << ", pending after readers left : " << Leaked
+		<< ", matches trainer : " << (MatchesTrainer && MaxPending < Steps / PublishEvery / 2 ? "yes" : "no") << ", x1 : " << Latest->values[0] << std::endl;
+}
+
+#if defined(__cpp_impl_coroutine)
+struct PipelineBatch
+{
+	int Step;
+	std::vector<double> Inputs;
+	std::vector<double> Targets;
+};
+
+struct PipelineCheckpoint
+{
+	int Step;
+	double W;
+	double B;
+};
+
+Et::Pipeline::Task LoadBatches(std::string Path, int BatchSize, Et::Pipeline::Channel<PipelineBatch>& Batches)
+{
+	std::ifstream Stream{ Path, std::ios::binary };
+	for (int Step = 0;; Step++)
+	{
+		PipelineBatch Batch{ Step, std::vector<double>(BatchSize), std::vector<double>(BatchSize) };
+		for (int i = 0; i < BatchSize; i++)
+		{
+			Stream.read(reinterpret_cast<char*>(&Batch.Inputs[i]), sizeof(double));
+			Stream.read(reinterpret_cast<char*>(&Batch.Targets[i]), sizeof(double));
+		}
+		if (!Stream || !co_await Batches.Send(std::move(Batch)))
+		{
+			break;
+		}
+	}
+	Batches.Close();
+}
+
+template <typename O, typename X, typename T, typename W, typename B>
+Et::Pipeline::Task TrainBatches(O& Optimizer, X& Input, T& Target, W& Weight, B& Bias, int CheckpointEvery,
+	Et::Pipeline::Channel<PipelineBatch>& Batches, Et::Pipeline::Channel<PipelineCheckpoint>& Checkpoints, Et::Metrics::Sink& Sink, uint32_t Loss)
+{
+	while (auto Batch = co_await Batches.Receive())
+	{
+		double Total = 0.0;
+		for (size_t i = 0; i < Batch->Inputs.size(); i++)
+		{
+			Total += Optimizer.ForwardPass(Et::H(Input, Batch->Inputs[i]), Et::H(Target, Batch->Targets[i])).Minimize(0.05).GetPreResult();
+		}
+		Sink.Record(Loss, Batch->Step, Total / Batch->Inputs.size());
+		if ((Batch->Step + 1) % CheckpointEvery == 0)
+		{
+			co_await Checkpoints.Send(PipelineCheckpoint{ Batch->Step, Weight(), Bias() });
+		}
+	}
+	Checkpoints.Close();
+}
+
+Et::Pipeline::Task WriteCheckpoints(std::string Path, Et::Pipeline::Channel<PipelineCheckpoint>& Checkpoints, int& Written)
+{
+	while (auto Checkpoint = co_await Checkpoints.Receive())
+	{
+		std::ofstream Stream{ Path, std::ios::app };
+		Stream << Checkpoint->Step << ',' << Checkpoint->W << ',' << Checkpoint->B << '\n';
+		Written++;
+	}
+}
+
+Et::Pipeline::Task CountUp(Et::Pipeline::Channel<int>& Numbers)
+{
+	for (int i = 0;; i++)
+	{
+		if (!co_await Numbers.Send(i))
+		{
+			break;
+		}
+	}
+}
+
+Et::Pipeline::Task FailAfter(int Limit, Et::Pipeline::Channel<int>& Numbers, Et::Pipeline::Channel<int>& Results)
+{
+	while (auto Number = co_await Numbers.Receive())
+	{
+		if (*Number == Limit)
+		{
+			throw std::runtime_error{ "stage failed" };
+		}
+		co_await Results.Send(*Number);
+	}
+}
+
+Et::Pipeline::Task Drain(Et::Pipeline::Channel<int>& Results, int& Drained)
+{
+	while (auto Result = co_await Results.Receive())
+	{
+		Drained++;
+	}
+}
+
+void PipelineTest()
+{
+	constexpr int Samples = 1 << 15;
+	constexpr int BatchSize = 64;
+	std::string const DataPath = "pipeline_batches.bin";
+	std::string const CheckpointPath = "pipeline_checkpoints.csv";
+	{
+		std::ofstream Stream{ DataPath, std::ios::binary };
+		for (int i = 0; i < Samples; i++)
+		{
+			double const Input = -1.0 + 2.0 * (i * 7919 % Samples) / Samples;
+			double const Sample[2] = { Input, 2.0 * Input + 0.5 };
+			Stream.write(reinterpret_cast<char const*>(Sample), sizeof(Sample));
+		}
+		std::ofstream Truncate{ CheckpointPath };
+	}
+
+	Et::VariableExpr W{ 0.0 }, B{ 0.0 };
+	Et::PlaceholderExpr X, T;
+	auto E = W * X + B - T;
+	auto Y = E * E;
+	Et::GradientDescentOptimizer Optimizer{ Y };
+
+	std::ostringstream Log;
+	Et::Metrics::Sink Sink{ Log };
+	uint32_t const Loss = Sink.Register("loss");
+	Sink.Start();
+
+	Et::ThreadPool Pool{ 3 };
+	Et::Pipeline::Channel<PipelineBatch> Batches{ Pool, 2 };
+	Et::Pipeline::Channel<PipelineCheckpoint> Checkpoints{ Pool, 1 };
+	int Written = 0;
+
+	auto const Begin = std::chrono::steady_clock::now();
+	{
+		Et::Pipeline::Runner Runner{ Pool };
+		Runner.CloseOnError(Batches);
+		Runner.CloseOnError(Checkpoints);
+		Runner.Spawn(LoadBatches(DataPath, BatchSize, Batches));
+		Runner.Spawn(TrainBatches(Optimizer, X, T, W, B, 64, Batches, Checkpoints, Sink, Loss));
+		Runner.Spawn(WriteCheckpoints(CheckpointPath, Checkpoints, Written));
+		Runner.Wait();
+	}
+	auto const Elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - Begin).count();
+	Sink.Stop();
+
+	bool Cancelled = false;
+	int Drained = 0;
+	{
+		Et::Pipeline::Channel<int> Numbers{ Pool, 1 }, Results{ Pool, 1 };
+		Et::Pipeline::Runner Failing{ Pool };
+		Failing.CloseOnError(Numbers);
+		Failing.CloseOnError(Results);
+		Failing.Spawn(CountUp(Numbers));
+		Failing.Spawn(FailAfter(100, Numbers, Results));
+		Failing.Spawn(Drain(Results, Drained));
+		try
+		{
+			Failing.Wait();
+		}
+		catch (std::runtime_error const&)
+		{
+			Cancelled = Drained <= 100;
+		}
+	}
+
+	bool const Converged = std::abs(W() - 2.0) < 1e-3 && std::abs(B() - 0.5) < 1e-3 && Written == Samples / BatchSize / 64 && Cancelled;
+	std::cout << "Batches : " << Sink.Recorded() << ", checkpoints : " << Written << ", " << Elapsed << "us, w : " << W() << ", b : " << B()
+		<< ", failed stage cancelled : " << (Cancelled ? "yes" : "no") << ", converged : " << (Converged ? "yes" : "no") << std::endl;
+}
+#endif
+
+#if defined(__linux__)
+void MultiProcessTest()
+{
+	constexpr int Samples = 4096;
+	constexpr int Epochs = 200;
+
+	auto Train = [](Et::MultiProcess::WorkerContext& Context)
+	{
+		Et::VariableExpr W{ 0.0 }, B{ 0.0 };
+		Et::PlaceholderExpr X, T;
+		auto E = W * X + B - T;
+		auto Y = E * E;
+		Et::GradientDescentOptimizer Optimizer{ Y };
+
+		double Gradients[decltype(Optimizer)::gradient_size_v];
+		for (int Epoch = 0; Epoch < Epochs; Epoch++)
+		{
+			int Count = 0;
+			for (int i = static_cast<int>(Context.Rank()); i < Samples; i += static_cast<int>(Context.Size()), Count++)
+			{
+				double const Input = -1.0 + 2.0 * i / Samples;
+				Optimizer.ForwardPass(Et::H(X, Input), Et::H(T, 2.0 * Input + 0.5)).Backward();
+			}
+			Optimizer.ExportGradients(Gradients);
+			for (double& Gradient : Gradients)
+			{
+				Gradient /= Count;
+			}
+			Context.AllReduce(Gradients, std::size(Gradients));
+			Optimizer.ImportGradients(Gradients).ApplyGradients(0.1);
+		}
+		Context.Report(W());
+	};
+
+	for (auto Reduction : { Et::MultiProcess::Reduction::ReduceScatter, Et::MultiProcess::Reduction::Tree })
+	{
+		Et::MultiProcess::Options Options;
+		Options.workers = 4;
+		Options.reduction = Reduction;
+		Et::MultiProcess::Trainer Trainer{ 16, Options };
+		auto const Statuses = Trainer.Run(Train);
+
+		bool Agree = true;
+		for (auto const& Status : Statuses)
+		{
+			Agree = Agree && Status.exited && Status.exit_code == 0 && Status.report == Statuses[0].report;
+		}
+		std::cout << (Reduction == Et::MultiProcess::Reduction::ReduceScatter ? "ReduceScatter" : "Tree") << " : " << Statuses.size() << " workers, replicas agree : "
+			<< (Agree ? "yes" : "no") << ", w : " << Statuses[0].report << std::endl;
+	}
+	Et::MultiProcess::Options Options;
+	Options.workers = 3;
+	Et::MultiProcess::Trainer Trainer{ 1, Options };
+	auto const Statuses = Trainer.Run([](Et::MultiProcess::WorkerContext& Context)
+	{
+		double Value = 1.0;
+		for (int Step = 0; Step < 10 && !(Context.Rank() == 1 && Step == 5); Step++)
+		{
+			Context.AllReduce(&Value, 1);
+		}
+	});
+	bool Detected = Statuses.size() == 3 && Statuses[1].exited && Statuses[1].exit_code == 0;
+	for (size_t Rank : { 0, 2 })
+	{
+		Detected = Detected && Rank < Statuses.size() && Statuses[Rank].exited && Statuses[Rank].exit_code == 3;
+	}
+	std::cout << "early exit detected : " << (Detected ? "yes" : "no") << std::endl;
+}
+
+void ParamServerTest()
+{
+	constexpr int Samples = 1024;
+	constexpr int Workers = 3;
+	constexpr int Steps = 300;
+	constexpr int Batch = 32;
+
+	struct Config
+	{
+		char const* Name;
+		Et::ParamServer::ClientOptions Options;
+		bool Shutdown;
+	};
+	Config const Configs[] = {
+		{ "dense", { Et::ParamServer::Compression::None, 0, 1 }, true },
+		{ "fp16", { Et::ParamServer::Compression::Fp16, 0, 1 }, false },
+		{ "top-k", { Et::ParamServer::Compression::TopK, 1, 1 }, true },
+		{ "batched", { Et::ParamServer::Compression::None, 0, 4 }, false } };
+
+	for (auto const& Setup : Configs)
+	{
+		std::string const Path = "/tmp/et_autodiff_ps_" + std::to_string(getpid()) + ".sock";
+		Et::ParamServer::ServerOptions ServerOptions;
+		ServerOptions.learning_rate = 0.05;
+		ServerOptions.max_staleness = 2 * Workers;
+		ServerOptions.expected_workers = Setup.Shutdown ? 0 : Workers + 3;
+		Et::ParamServer::Server Server{ Path, { 0.0, 0.0 }, ServerOptions };
+
+		std::cout.flush();
+		pid_t const ServerPid = fork();
+		if (ServerPid == 0)
+		{
+			auto const Stats = Server.Serve();
+			std::cout << Setup.Name << " : " << Stats.pushes << " pushes applied, " << Stats.rejected << " stale, " << Stats.bytes_received << " bytes received" << std::endl;
+			_exit(0);
+		}
+
+		sockaddr_un Address{};
+		Address.sun_family = AF_UNIX;
+		std::strncpy(Address.sun_path, Path.c_str(), sizeof(Address.sun_path) - 1);
+		int const Stalled = socket(AF_UNIX, SOCK_STREAM, 0);
+		int const Oversized = socket(AF_UNIX, SOCK_STREAM, 0);
+		bool Rejected = connect(Stalled, reinterpret_cast<sockaddr const*>(&Address), sizeof(Address)) == 0
+			&& connect(Oversized, reinterpret_cast<sockaddr const*>(&Address), sizeof(Address)) == 0;
+		if (Rejected)
+		{
+			Et::ParamServer::FrameHeader const Huge{ Et::ParamServer::frame_magic_v, static_cast<uint16_t>(Et::ParamServer::MessageType::Push), 0, 0, 2, uint32_t{ 1 } << 30 };
+			char Reply = 0;
+			Rejected = write(Stalled, &Huge, sizeof(Huge) / 2) > 0 && write(Oversized, &Huge, sizeof(Huge)) == sizeof(Huge) && read(Oversized, &Reply, 1) == 0;
+		}
+		close(Oversized);
+
+		std::vector<pid_t> Pids;
+		for (int Rank = 0; Rank < Workers; Rank++)
+		{
+			pid_t const Pid = fork();
+			if (Pid != 0)
+			{
+				Pids.push_back(Pid);
+				continue;
+			}
+			int Code = 0;
+			try
+			{
+				Et::VariableExpr W{ 0.0 }, B{ 0.0 };
+				Et::PlaceholderExpr X, T;
+				auto E = W * X + B - T;
+				auto Y = E * E;
+				Et::GradientDescentOptimizer Optimizer{ Y };
+				Et::ParamServer::Binding Binding{ Y };
+				Et::ParamServer::Client Client{ Path, Setup.Options };
+
+				double Parameters[2], Gradients[decltype(Optimizer)::gradient_size_v], Folded[2];
+				for (int Step = 0; Step < Steps; Step++)
+				{
+					uint64_t const Version = Client.Pull(Parameters, Binding.Size());
+					Binding.Write(Parameters);
+					for (int i = 0; i < Batch; i++)
+					{
+						int const Sample = (Rank + Workers * (Step * Batch + i)) % Samples;
+						double const Input = -1.0 + 2.0 * Sample / Samples;
+						Optimizer.ForwardPass(Et::H(X, Input), Et::H(T, 2.0 * Input + 0.5)).Backward();
+					}
+					Optimizer.ExportGradients(Gradients);
+					Binding.Fold(Gradients, Folded);
+					for (double& Gradient : Folded)
+					{
+						Gradient /= Batch;
+					}
+					Client.Push(Folded, Binding.Size(), Version);
+					Optimizer.ResetGradients();
+				}
+				Client.Flush();
+			}
+			catch (std::exception const& Error)
+			{
+				std::cerr << "worker " << Rank << " : " << Error.what() << std::endl;
+				Code = 2;
+			}
+			_exit(Code);
+		}
+
+		bool Healthy = true;
+		for (pid_t Pid : Pids)
+		{
+			int Status = 0;
+			waitpid(Pid, &Status, 0);
+			Healthy = Healthy && WIFEXITED(Status) && WEXITSTATUS(Status) == 0;
+		}
+		close(Stalled);
+
+		double Parameters[2];
+		{
+			Et::ParamServer::Client Client{ Path };
+			Client.Pull(Parameters, 2);
+			if (Setup.Shutdown)
+			{
+				Client.Shutdown();
+			}
+		}
+		int Status = 0;
+		waitpid(ServerPid, &Status, 0);
+		bool const Converged = Healthy && Rejected && std::abs(Parameters[0] - 2.0) < 0.05 && std::abs(Parameters[1] - 0.5) < 0.05;
+		std::cout << Setup.Name << " : w : " << Parameters[0] << ", b : " << Parameters[1] << ", converged : " << (Converged ? "yes" : "no") << std::endl;
+	}
+}
+#endif
+
+int main(int argc, char** argv)
+{
+	std::map<std::string, void(*)()> const Examples{
+		{ "autodiff", AutodiffTest },
+		{ "packed", PackedAutodiffTest },
+		{ "sweep", SweepTest },
+		{ "runtime", RuntimeExprTest },
+		{ "codegen", CodegenBenchmark },
+		{ "model", ModelTest },
+		{ "profile", ProfileTest },
+		{ "trace", TraceTest },
+		{ "perf", PerfCounterTest },
+		{ "allocations", AllocationTest },
+		{ "graph", GraphStatsTest },
+		{ "metrics", MetricsTest },
+		{ "parallel", ParallelEvalTest },
+		{ "snapshot", SnapshotTest },
+		{ "outofcore", OutOfCoreTest },
+		{ "virtual", VirtualTensorTest },
+		{ "structured", StructuredMatrixTest },
+#if defined(__cpp_impl_coroutine)
+		{ "pipeline", PipelineTest },
+#endif
+#if defined(__linux__)
+		{ "multiprocess", MultiProcessTest },
+		{ "paramserver", ParamServerTest },
+#endif
+		{ "tensor", TensorTests } };
+
 	auto begin = std::chrono::high_resolution_clock::now();
 
-	//AutodiffTest();
-	TensorTests();
+	if (argc < 2)
+	{
+		TensorTests();
+	}
+	for (int i = 1; i < argc; i++)
+	{
+		auto const Example = Examples.find(argv[i]);
+		if (Example == Examples.end())
+		{
+			std::cerr << "unknown example " << argv[i] << ", expected one of:";
+			for (auto const& Known : Examples)
+			{
+				std::cerr << ' ' << Known.first;
+			}
+			std::cerr << std::endl;
+			return 1;
+		}
+		Example->second();
+	}
 
 	auto end = std::chrono::high_resolution_clock::now();
 
 	std::cout << "Time elapsed : " << std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() << "us" << std::endl;
 	
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "runtime_expr.h"
+
+namespace Et {
+
+	namespace Runtime {
+
+		class _impl_CppEmitter
+		{
+		private:
+			Program const& _program;
+			std::ostringstream _stream;
+
+			auto _impl_Operand(uint32_t index) -> std::string
+			{
+				std::ostringstream operand;
+				if (index < _program.Constants().size() && std::isnan(_program.Constants()[index]))
+				{
+					operand << "NAN";
+				}
+				else if (index < _program.Constants().size() && std::isinf(_program.Constants()[index]))
+				{
+					operand << (_program.Constants()[index] > 0 ? "HUGE_VAL" : "(-HUGE_VAL)");
+				}
+				else if (index < _program.Constants().size())
+				{
+					operand << std::setprecision(std::numeric_limits<double>::max_digits10) << std::showpoint << _program.Constants()[index];
+				}
+				else if (index < _program.PlaceholderRegister(0))
+				{
+					operand << "x[" << index - _program.VariableRegister(0) << "]";
+				}
+				else if (index < _program.PlaceholderRegister(0) + _program.Placeholders().size())
+				{
+					operand << "p[" << index - _program.PlaceholderRegister(0) << "]";
+				}
+				else
+				{
+					operand << "t" << index;
+				}
+				return operand.str();
+			}
+
+			auto _impl_Expression(Instruction const& instruction) -> std::string
+			{
+				std::string const a = _impl_Operand(instruction.first);
+				std::string const b = _impl_Operand(instruction.second);
+				switch (instruction.op)
+				{
+				case OpCode::Add: return a + " + " + b;
+				case OpCode::Subtract: return a + " - " + b;
+				case OpCode::Multiply: return a + " * " + b;
+				case OpCode::Divide: return a + " / " + b;
+				case OpCode::Power: return "std::pow(" + a + ", " + b + ")";
+				case OpCode::Negate: return "-" + a;
+				case OpCode::Log: return "std::log(" + a + ")";
+				case OpCode::Sin: return "std::sin(" + a + ")";
+				case OpCode::Cos: return "std::cos(" + a + ")";
+				default: return "std::tan(" + a + ")";
+				}
+			}
+
+			auto _impl_EmitForward() -> void
+			{
+				for (auto const& instruction : _program.Code())
+				{
+					_stream << "\tdouble const t" << instruction.target << " = " << _impl_Expression(instruction) << ";\n";
+				}
+			}
+
+			auto _impl_Adjoint(uint32_t index, std::vector<bool>& assigned, std::string const& term, bool negate) -> void
+			{
+				_stream << "\t";
+				if (assigned[index])
+				{
+					_stream << "g" << index << (negate ? " -= " : " += ") << term << ";\n";
+				}
+				else
+				{
+					_stream << "double g" << index << " = " << (negate ? "-(" + term + ")" : term) << ";\n";
+					assigned[index] = true;
+				}
+			}
+
+			auto _impl_EmitReverse() -> void
+			{
+				std::vector<bool> assigned(_program.RegisterCount(), false);
+				uint32_t const result = _program.ResultRegister();
+				_stream << "\tdouble g" << result << " = 1.0;\n";
+				assigned[result] = true;
+
+				auto const& code = _program.Code();
+				for (size_t i = code.size(); i-- > 0;)
+				{
+					auto const& instruction = code[i];
+					if (!assigned[instruction.target])
+					{
+						continue;
+					}
+					std::string const g = "g" + std::to_string(instruction.target);
+					std::string const a = _impl_Operand(instruction.first);
+					std::string const b = _impl_Operand(instruction.second);
+					std::string const t = _impl_Operand(instruction.target);
+					bool const da = instruction.first_needs_grad;
+					bool const db = instruction.second_needs_grad;
+
+					switch (instruction.op)
+					{
+					case OpCode::Add:
+						if (da) _impl_Adjoint(instruction.first, assigned, g, false);
+						if (db) _impl_Adjoint(instruction.second, assigned, g, false);
+						break;
+					case OpCode::Subtract:
+						if (da) _impl_Adjoint(instruction.first, assigned, g, false);
+						if (db) _impl_Adjoint(instruction.second, assigned, g, true);
+						break;
+					case OpCode::Multiply:
+						if (da) _impl_Adjoint(instruction.first, assigned, g + " * " + b, false);
+						if (db) _impl_Adjoint(instruction.second, assigned, g + " * " + a, false);
+						break;
+					case OpCode::Divide:
+						if (da) _impl_Adjoint(instruction.first, assigned, g + " / " + b, false);
+						if (db) _impl_Adjoint(instruction.second, assigned, g + " * " + t + " / " + b, true);
+						break;
+					case OpCode::Power:
+						if (da) _impl_Adjoint(instruction.first, assigned, g + " * " + b + " * std::pow(" + a + ", " + b + " - 1.0)", false);
+						if (db) _impl_Adjoint(instruction.second, assigned, g + " * " + t + " * std::log(" + a + ")", false);
+						break;
+					case OpCode::Negate:
+						if (da) _impl_Adjoint(instruction.first, assigned, g, true);
+						break;
+					case OpCode::Log:
+						if (da) _impl_Adjoint(instruction.first, assigned, g + " / " + a, false);
+						break;
+					case OpCode::Sin:
+						if (da) _impl_Adjoint(instruction.first, assigned, g + " * std::cos(" + a + ")", false);
+						break;
+					case OpCode::Cos:
+						if (da) _impl_Adjoint(instruction.first, assigned, g + " * std::sin(" + a + ")", true);
+						break;
+					default:
+						if (da) _impl_Adjoint(instruction.first, assigned, g + " * (1.0 + " + t + " * " + t + ")", false);
+						break;
+					}
+				}
+
+				for (size_t i = 0; i < _program.Variables().size(); i++)
+				{
+					uint32_t const index = _program.VariableRegister(i);
+					_stream << "\tgrad[" << i << "] = " << (assigned[index] ? "g" + std::to_string(index) : std::string{ "0.0" }) << ";\n";
+				}
+			}
+
+			auto _impl_EmitSignatureComment() -> void
+			{
+				_stream << "// x: ";
+				for (size_t i = 0; i < _program.Variables().size(); i++)
+				{
+					_stream << (i > 0 ? ", " : "") << _program.Variables()[i];
+				}
+				_stream << "\n// p: ";
+				for (size_t i = 0; i < _program.Placeholders().size(); i++)
+				{
+					_stream << (i > 0 ? ", " : "") << _program.Placeholders()[i];
+				}
+				_stream << '\n';
+			}
+
+		public:
+			_impl_CppEmitter(Program const& program) : _program{ program } {}
+
+			auto Emit(std::string const& name) -> std::string
+			{
+				_impl_EmitSignatureComment();
+
+				_stream << "inline double " << name << "([[maybe_unused]] double const* x, [[maybe_unused]] double const* p)\n{\n";
+				_impl_EmitForward();
+				_stream << "\treturn " << _impl_Operand(_program.ResultRegister()) << ";\n}\n\n";
+
+				_impl_EmitSignatureComment();
+				_stream << "inline double " << name << "_gradient([[maybe_unused]] double const* x, [[maybe_unused]] double const* p, double* grad)\n{\n";
+				_impl_EmitForward();
+				_impl_EmitReverse();
+				_stream << "\treturn " << _impl_Operand(_program.ResultRegister()) << ";\n}\n";
+				return _stream.str();
+			}
+		};
+
+		inline auto EmitCpp(Program const& program, std::string const& name) -> std::string
+		{
+			return _impl_CppEmitter{ program }.Emit(name);
+		}
+
+		inline auto EmitCppHeader(Program const& program, std::string const& name) -> std::string
+		{
+			return "#pragma once\n\n#include <cmath>\n\n// Generated by Et::Runtime::EmitCpp.\n" + EmitCpp(program, name);
+		}
+	}
+}
@@ -2,14 +2,25 @@
 
 #include <type_traits>
 #include <tuple>
+#include <utility>
 #include <cmath>
 #include "tensor.h"
+#include "structured_matrix.h"
+#include "perf_counters.h"
+#include "profiler.h"
+#include "trace.h"
+#include "thread_pool.h"
 
 namespace Et {
 
 	using ScalarD = Num::Scalar<double>;
 	using ScalarL = Num::Scalar<long double>;
 
+	template <size_t N>
+	using PackD = Num::Pack<double, N>;
+	template <size_t N>
+	using PackL = Num::Pack<long double, N>;
+
 	struct ExprBase {};
 
 	struct _impl_TerminalExpr {};
@@ -20,11 +31,157 @@ namespace Et {
 	template<typename... T>
 	constexpr bool is_expr_v = std::conjunction_v<std::is_base_of<ExprBase, std::decay_t<T>>...>;
 
+	template <typename E>
+	constexpr auto _impl_subtree_cost() -> size_t
+	{
+		if constexpr (std::is_base_of_v<_impl_BinaryExpr, E>)
+		{
+			return sizeof(typename E::value_t) + _impl_subtree_cost<typename E::first_expr_t>() + _impl_subtree_cost<typename E::second_expr_t>();
+		}
+		else if constexpr (std::is_base_of_v<_impl_UnaryExpr, E>)
+		{
+			return sizeof(typename E::value_t) + _impl_subtree_cost<typename E::first_expr_t>();
+		}
+		else
+		{
+			return 0;
+		}
+	}
+
+	template <typename E>
+	constexpr size_t subtree_cost_v = _impl_subtree_cost<std::decay_t<E>>();
+
+	template <typename E>
+	constexpr auto _impl_has_trainable() -> bool
+	{
+		if constexpr (std::is_base_of_v<_impl_BinaryExpr, E>)
+		{
+			return _impl_has_trainable<typename E::first_expr_t>() || _impl_has_trainable<typename E::second_expr_t>();
+		}
+		else if constexpr (std::is_base_of_v<_impl_UnaryExpr, E>)
+		{
+			return _impl_has_trainable<typename E::first_expr_t>();
+		}
+		else
+		{
+			return std::is_base_of_v<_impl_TrainableExpr, E>;
+		}
+	}
+
+	template <typename E>
+	constexpr bool has_trainable_v = _impl_has_trainable<std::decay_t<E>>();
+
+	class ParallelScope
+	{
+	private:
+		ThreadPool* _previous_pool;
+		size_t _previous_min_fork_bytes;
+
+		inline static thread_local ThreadPool* _pool = nullptr;
+		inline static thread_local size_t _min_fork_bytes = 0;
+
+	public:
+		ParallelScope(ThreadPool* pool, size_t min_fork_bytes) : _previous_pool{ _pool }, _previous_min_fork_bytes{ _min_fork_bytes }
+		{
+			_pool = pool;
+			_min_fork_bytes = min_fork_bytes;
+		}
+
+		ParallelScope(ParallelScope const&) = delete;
+		auto operator=(ParallelScope const&) -> ParallelScope & = delete;
+
+		~ParallelScope()
+		{
+			_pool = _previous_pool;
+			_min_fork_bytes = _previous_min_fork_bytes;
+		}
+
+		static auto Pool() -> ThreadPool*
+		{
+			return _pool;
+		}
+
+		static auto MinForkBytes() -> size_t
+		{
+			return _min_fork_bytes;
+		}
+
+		static auto ShouldFork(size_t first_cost, size_t second_cost) -> bool
+		{
+			return _pool != nullptr && first_cost >= _min_fork_bytes && second_cost >= _min_fork_bytes;
+		}
+
+		template <typename F1, typename F2>
+		static auto Fork(F1&& first, F2&& second) -> void
+		{
+			ThreadPool* const pool = _pool;
+			size_t const min_fork_bytes = _min_fork_bytes;
+			TaskGroup group{ *pool };
+			group.Run([&first, pool, min_fork_bytes]()
+			{
+				ParallelScope scope{ pool, min_fork_bytes };
+				first();
+			});
+			second();
+			group.Wait();
+		}
+	};
+
+	template <int I1, int I2, typename E1, typename E2, typename T>
+	constexpr auto _impl_EvalChildren(E1& first_expr, E2& second_expr, T& tuple)
+	{
+		using first_value_t = std::decay_t<decltype(first_expr.template Eval<I1>(tuple))>;
+		using second_value_t = std::decay_t<decltype(second_expr.template Eval<I2>(tuple))>;
+		constexpr size_t first_cost = subtree_cost_v<E1>;
+		constexpr size_t second_cost = subtree_cost_v<E2>;
+
+		if constexpr (first_cost > 0 && second_cost > 0)
+		{
+			if (ParallelScope::ShouldFork(first_cost, second_cost))
+			{
+				std::pair<first_value_t, second_value_t> values;
+				ParallelScope::Fork(
+					[&]() { values.first = first_expr.template Eval<I1>(tuple); },
+					[&]() { values.second = second_expr.template Eval<I2>(tuple); });
+				return values;
+			}
+		}
+		return std::pair<first_value_t, second_value_t>{ first_expr.template Eval<I1>(tuple), second_expr.template Eval<I2>(tuple) };
+	}
+
+	template <typename V>
+	constexpr auto _impl_LocalCos(V const& value) -> V
+	{
+		if constexpr (Num::is_structured_v<V>)
+		{
+			return Num::map_coefficients(value, [](auto x) { return std::cos(x); });
+		}
+		else
+		{
+			return Num::cos(value);
+		}
+	}
+
+	template <typename V>
+	constexpr auto _impl_LocalSecSquared(V const& value) -> V
+	{
+		if constexpr (Num::is_structured_v<V>)
+		{
+			return Num::map_coefficients(value, [](auto x) { return 1.0 / (std::cos(x) * std::cos(x)); });
+		}
+		else
+		{
+			auto const sec_value = Num::sec(value);
+			return sec_value * sec_value;
+		}
+	}
+
 	template <typename V>
 	class ConstantExpr : private ExprBase, private _impl_TerminalExpr
 	{
 	public:
 		static_assert(Num::is_tensor_v<V>);
+		static_assert(!Num::is_structured_v<V> || Num::is_entrywise_v<V>, "LowRank stores factors, not entries, expand it with Num::ToDense to use it in an expression");
 		using value_t = std::decay_t<V>;
 
 	private:
@@ -41,6 +198,7 @@ namespace Et {
 		template <int I, typename T>
 		constexpr auto Eval(T& tuple) -> auto&
 		{
+			ET_PROFILE_SCOPE(Forward, std::decay_t<decltype(*this)>, I, sizeof(value_t));
 			std::get<I>(tuple).SetLocalGrads(this);
 			return _value;
 		}
@@ -58,6 +216,7 @@ namespace Et {
 	{
 	public:
 		static_assert(Num::is_tensor_v<V>);
+		static_assert(!Num::is_structured_v<V> || Num::is_entrywise_v<V>, "LowRank stores factors, not entries, expand it with Num::ToDense to use it in an expression");
 		using value_t = std::decay_t<V>;
 
 	private:
@@ -75,6 +234,7 @@ namespace Et {
 		template <int I, typename T>
 		constexpr auto Eval(T& tuple) -> auto&
 		{
+			ET_PROFILE_SCOPE(Forward, std::decay_t<decltype(*this)>, I, sizeof(value_t));
 			std::get<I>(tuple).SetLocalGrads(this);
 			return _value;
 		}
@@ -92,6 +252,7 @@ namespace Et {
 	{
 	public:
 		static_assert(Num::is_tensor_v<V>);
+		static_assert(!Num::is_structured_v<V> || Num::is_entrywise_v<V>, "LowRank stores factors, not entries, expand it with Num::ToDense to use it in an expression");
 		using value_t = std::decay_t<V>;
 
 	private:
@@ -108,6 +269,7 @@ namespace Et {
 		template <int I, typename T>
 		constexpr auto Eval(T& tuple) -> auto&
 		{
+			ET_PROFILE_SCOPE(Forward, std::decay_t<decltype(*this)>, I, sizeof(value_t));
 			std::get<I>(tuple).SetLocalGrads(this);
 			return _value;
 		}
@@ -116,6 +278,11 @@ namespace Et {
 		{
 			_value += delta;
 		}
+
+		constexpr auto Assign(value_t const& value)
+		{
+			_value = value;
+		}
 	};
 
 	VariableExpr(int const&)->VariableExpr<ScalarD>;
@@ -146,6 +313,26 @@ namespace Et {
 		constexpr AddExpr(E1&& first_expr, E2&& second_expr)
 			: _first_expr{ std::forward<E1>(first_expr) }, _second_expr{ std::forward<E2>(second_expr) } {}
 
+		constexpr auto FirstExpr() const -> first_expr_t const&
+		{
+			return _first_expr;
+		}
+
+		constexpr auto FirstExpr() -> first_expr_t&
+		{
+			return _first_expr;
+		}
+
+		constexpr auto SecondExpr() const -> second_expr_t const&
+		{
+			return _second_expr;
+		}
+
+		constexpr auto SecondExpr() -> second_expr_t&
+		{
+			return _second_expr;
+		}
+
 		constexpr auto operator()() const -> auto
 		{
 			return _first_expr() + _second_expr();
@@ -154,8 +341,8 @@ namespace Et {
 		template <int I, typename T>
 		constexpr auto Eval(T& tuple) -> auto
 		{
-			first_value_t first_value = _first_expr.template Eval<std::tuple_element_t<I, T>::child_one_v>(tuple);
-			second_value_t second_value = _second_expr.template Eval<std::tuple_element_t<I, T>::child_two_v>(tuple);
+			ET_PROFILE_SCOPE(Forward, std::decay_t<decltype(*this)>, I, sizeof(first_value_t) + sizeof(second_value_t) + sizeof(value_t) + sizeof(first_local_grad_t) + sizeof(second_local_grad_t));
+			auto const [first_value, second_value] = _impl_EvalChildren<std::tuple_element_t<I, T>::child_one_v, std::tuple_element_t<I, T>::child_two_v>(_first_expr, _second_expr, tuple);
 			std::get<I>(tuple).SetLocalGrads(this, first_local_grad_t(1.0), second_local_grad_t(1.0));
 			return first_value + second_value;
 		}
@@ -185,6 +372,26 @@ namespace Et {
 		constexpr MultiplyExpr(E1&& first_expr, E2&& second_expr)
 			: _first_expr{ std::forward<E1>(first_expr) }, _second_expr{ std::forward<E2>(second_expr) } {}
 
+		constexpr auto FirstExpr() const -> first_expr_t const&
+		{
+			return _first_expr;
+		}
+
+		constexpr auto FirstExpr() -> first_expr_t&
+		{
+			return _first_expr;
+		}
+
+		constexpr auto SecondExpr() const -> second_expr_t const&
+		{
+			return _second_expr;
+		}
+
+		constexpr auto SecondExpr() -> second_expr_t&
+		{
+			return _second_expr;
+		}
+
 		constexpr auto operator()() const -> auto
 		{
 			return _first_expr() * _second_expr();
@@ -193,8 +400,8 @@ namespace Et {
 		template <int I, typename T>
 		constexpr auto Eval(T& tuple) -> auto
 		{
-			first_value_t first_value = _first_expr.template Eval<std::tuple_element_t<I, T>::child_one_v>(tuple);
-			second_value_t second_value = _second_expr.template Eval<std::tuple_element_t<I, T>::child_two_v>(tuple);
+			ET_PROFILE_SCOPE(Forward, std::decay_t<decltype(*this)>, I, sizeof(first_value_t) + sizeof(second_value_t) + sizeof(value_t) + sizeof(first_local_grad_t) + sizeof(second_local_grad_t));
+			auto const [first_value, second_value] = _impl_EvalChildren<std::tuple_element_t<I, T>::child_one_v, std::tuple_element_t<I, T>::child_two_v>(_first_expr, _second_expr, tuple);
 			std::get<I>(tuple).SetLocalGrads(this, second_value, first_value);
 			return first_value * second_value;
 		}
@@ -224,6 +431,26 @@ namespace Et {
 		constexpr SubtractExpr(E1&& first_expr, E2&& second_expr)
 			: _first_expr{ std::forward<E1>(first_expr) }, _second_expr{ std::forward<E2>(second_expr) } {}
 
+		constexpr auto FirstExpr() const -> first_expr_t const&
+		{
+			return _first_expr;
+		}
+
+		constexpr auto FirstExpr() -> first_expr_t&
+		{
+			return _first_expr;
+		}
+
+		constexpr auto SecondExpr() const -> second_expr_t const&
+		{
+			return _second_expr;
+		}
+
+		constexpr auto SecondExpr() -> second_expr_t&
+		{
+			return _second_expr;
+		}
+
 		constexpr auto operator()() const -> auto
 		{
 			return _first_expr() - _second_expr();
@@ -232,8 +459,8 @@ namespace Et {
 		template <int I, typename T>
 		constexpr auto Eval(T& tuple) -> auto
 		{
-			first_value_t first_value = _first_expr.template Eval<std::tuple_element_t<I, T>::child_one_v>(tuple);
-			second_value_t second_value = _second_expr.template Eval<std::tuple_element_t<I, T>::child_two_v>(tuple);
+			ET_PROFILE_SCOPE(Forward, std::decay_t<decltype(*this)>, I, sizeof(first_value_t) + sizeof(second_value_t) + sizeof(value_t) + sizeof(first_local_grad_t) + sizeof(second_local_grad_t));
+			auto const [first_value, second_value] = _impl_EvalChildren<std::tuple_element_t<I, T>::child_one_v, std::tuple_element_t<I, T>::child_two_v>(_first_expr, _second_expr, tuple);
 			std::get<I>(tuple).SetLocalGrads(this, first_local_grad_t(1.0), second_local_grad_t(-1.0));
 			return first_value - second_value;
 		}
@@ -253,6 +480,7 @@ namespace Et {
 		using second_value_t = std::decay_t<decltype(std::declval<E2>()())>;
 		using first_local_grad_t = first_value_t;
 		using second_local_grad_t = second_value_t;
+		static_assert(!Num::is_structured_v<first_value_t> && !Num::is_structured_v<second_value_t>, "Division does not preserve structure, structured operands are limited to +, -, *, sin and tan");
 		using value_t = std::decay_t<decltype(std::declval<E1>()() / std::declval<E2>()())>;
 
 	private:
@@ -263,6 +491,26 @@ namespace Et {
 		constexpr DivideExpr(E1&& first_expr, E2&& second_expr)
 			: _first_expr{ std::forward<E1>(first_expr) }, _second_expr{ std::forward<E2>(second_expr) } {}
 
+		constexpr auto FirstExpr() const -> first_expr_t const&
+		{
+			return _first_expr;
+		}
+
+		constexpr auto FirstExpr() -> first_expr_t&
+		{
+			return _first_expr;
+		}
+
+		constexpr auto SecondExpr() const -> second_expr_t const&
+		{
+			return _second_expr;
+		}
+
+		constexpr auto SecondExpr() -> second_expr_t&
+		{
+			return _second_expr;
+		}
+
 		constexpr auto operator()() const -> auto
 		{
 			return _first_expr() / _second_expr();
@@ -271,8 +519,8 @@ namespace Et {
 		template <int I, typename T>
 		constexpr auto Eval(T& tuple) -> auto
 		{
-			first_value_t first_value = _first_expr.template Eval<std::tuple_element_t<I, T>::child_one_v>(tuple);
-			second_value_t second_value = _second_expr.template Eval<std::tuple_element_t<I, T>::child_two_v>(tuple);
+			ET_PROFILE_SCOPE(Forward, std::decay_t<decltype(*this)>, I, sizeof(first_value_t) + sizeof(second_value_t) + sizeof(value_t) + sizeof(first_local_grad_t) + sizeof(second_local_grad_t));
+			auto const [first_value, second_value] = _impl_EvalChildren<std::tuple_element_t<I, T>::child_one_v, std::tuple_element_t<I, T>::child_two_v>(_first_expr, _second_expr, tuple);
 			auto second_value_inverse = second_value.Inverse();
 			std::get<I>(tuple).SetLocalGrads(this, second_value_inverse, -first_value * second_value_inverse * second_value_inverse);
 			return first_value / second_value;
@@ -293,6 +541,7 @@ namespace Et {
 		using second_value_t = std::decay_t<decltype(std::declval<E2>()())>;
 		using first_local_grad_t = first_value_t;
 		using second_local_grad_t = second_value_t;
+		static_assert(!Num::is_structured_v<first_value_t> && !Num::is_structured_v<second_value_t>, "pow does not preserve structure, structured operands are limited to +, -, *, sin and tan");
 		using value_t = std::decay_t<decltype(Num::pow(std::declval<E1>()(), std::declval<E2>()()))>;
 
 	private:
@@ -303,6 +552,26 @@ namespace Et {
 		constexpr PowerExpr(E1&& first_expr, E2&& second_expr)
 			: _first_expr{ std::forward<E1>(first_expr) }, _second_expr{ std::forward<E2>(second_expr) } {}
 
+		constexpr auto FirstExpr() const -> first_expr_t const&
+		{
+			return _first_expr;
+		}
+
+		constexpr auto FirstExpr() -> first_expr_t&
+		{
+			return _first_expr;
+		}
+
+		constexpr auto SecondExpr() const -> second_expr_t const&
+		{
+			return _second_expr;
+		}
+
+		constexpr auto SecondExpr() -> second_expr_t&
+		{
+			return _second_expr;
+		}
+
 		constexpr auto operator()() const -> auto
 		{
 			return Num::pow(_first_expr(), _second_expr());
@@ -311,8 +580,8 @@ namespace Et {
 		template <int I, typename T>
 		constexpr auto Eval(T& tuple) -> auto
 		{
-			first_value_t first_value = _first_expr.template Eval<std::tuple_element_t<I, T>::child_one_v>(tuple);
-			second_value_t second_value = _second_expr.template Eval<std::tuple_element_t<I, T>::child_two_v>(tuple);
+			ET_PROFILE_SCOPE(Forward, std::decay_t<decltype(*this)>, I, sizeof(first_value_t) + sizeof(second_value_t) + sizeof(value_t) + sizeof(first_local_grad_t) + sizeof(second_local_grad_t));
+			auto const [first_value, second_value] = _impl_EvalChildren<std::tuple_element_t<I, T>::child_one_v, std::tuple_element_t<I, T>::child_two_v>(_first_expr, _second_expr, tuple);
 			value_t value = Num::pow(first_value, second_value);
 			std::get<I>(tuple).SetLocalGrads(this, second_value * value * first_value.Inverse(), value * Num::log(first_value));
 			return value;
@@ -339,6 +608,16 @@ namespace Et {
 		constexpr NegateExpr(E1&& first_expr)
 			: _first_expr{ std::forward<E1>(first_expr) } {}
 
+		constexpr auto FirstExpr() const -> first_expr_t const&
+		{
+			return _first_expr;
+		}
+
+		constexpr auto FirstExpr() -> first_expr_t&
+		{
+			return _first_expr;
+		}
+
 		constexpr auto operator()() const -> auto
 		{
 			return -_first_expr();
@@ -347,6 +626,7 @@ namespace Et {
 		template <int I, typename T>
 		constexpr auto Eval(T& tuple) -> auto
 		{
+			ET_PROFILE_SCOPE(Forward, std::decay_t<decltype(*this)>, I, sizeof(first_value_t) + sizeof(value_t) + sizeof(first_local_grad_t));
 			first_value_t first_value = _first_expr.template Eval<std::tuple_element_t<I, T>::child_one_v>(tuple);
 			std::get<I>(tuple).SetLocalGrads(this, first_local_grad_t(-1.0));
 			return -first_value;
@@ -364,6 +644,7 @@ namespace Et {
 		using first_expr_t = std::decay_t<E1>;
 		using first_value_t = std::decay_t<decltype(std::declval<E1>()())>;
 		using first_local_grad_t = first_value_t;
+		static_assert(!Num::is_structured_v<first_value_t>, "log does not preserve structure, structured operands are limited to +, -, *, sin and tan");
 		using value_t = std::decay_t<decltype(Num::log(std::declval<E1>()()))>;
 
 	private:
@@ -373,6 +654,16 @@ namespace Et {
 		constexpr LogExpr(E1&& first_expr)
 			: _first_expr{ std::forward<E1>(first_expr) } {}
 
+		constexpr auto FirstExpr() const -> first_expr_t const&
+		{
+			return _first_expr;
+		}
+
+		constexpr auto FirstExpr() -> first_expr_t&
+		{
+			return _first_expr;
+		}
+
 		constexpr auto operator()() const -> auto
 		{
 			return Num::log(_first_expr());
@@ -381,6 +672,7 @@ namespace Et {
 		template <int I, typename T>
 		constexpr auto Eval(T& tuple) -> auto
 		{
+			ET_PROFILE_SCOPE(Forward, std::decay_t<decltype(*this)>, I, sizeof(first_value_t) + sizeof(value_t) + sizeof(first_local_grad_t));
 			first_value_t first_value = _first_expr.template Eval<std::tuple_element_t<I, T>::child_one_v>(tuple);
 			std::get<I>(tuple).SetLocalGrads(this, first_value.Inverse());
 			return Num::log(first_value);
@@ -407,6 +699,16 @@ namespace Et {
 		constexpr SinExpr(E1&& first_expr)
 			: _first_expr{ std::forward<E1>(first_expr) } {}
 
+		constexpr auto FirstExpr() const -> first_expr_t const&
+		{
+			return _first_expr;
+		}
+
+		constexpr auto FirstExpr() -> first_expr_t&
+		{
+			return _first_expr;
+		}
+
 		constexpr auto operator()() const -> auto
 		{
 			return Num::sin(_first_expr());
@@ -415,8 +717,9 @@ namespace Et {
 		template <int I, typename T>
 		constexpr auto Eval(T& tuple) -> auto
 		{
+			ET_PROFILE_SCOPE(Forward, std::decay_t<decltype(*this)>, I, sizeof(first_value_t) + sizeof(value_t) + sizeof(first_local_grad_t));
 			first_value_t first_value = _first_expr.template Eval<std::tuple_element_t<I, T>::child_one_v>(tuple);
-			std::get<I>(tuple).SetLocalGrads(this, Num::cos(first_value));
+			std::get<I>(tuple).SetLocalGrads(this, _impl_LocalCos(first_value));
 			return Num::sin(first_value);
 		}
 	};
@@ -432,6 +735,7 @@ namespace Et {
 		using first_expr_t = std::decay_t<E1>;
 		using first_value_t = std::decay_t<decltype(std::declval<E1>()())>;
 		using first_local_grad_t = first_value_t;
+		static_assert(!Num::is_structured_v<first_value_t>, "cos does not preserve structure, structured operands are limited to +, -, *, sin and tan");
 		using value_t = std::decay_t<decltype(Num::cos(std::declval<E1>()()))>;
 
 	private:
@@ -441,6 +745,16 @@ namespace Et {
 		constexpr CosExpr(E1&& first_expr)
 			: _first_expr{ std::forward<E1>(first_expr) } {}
 
+		constexpr auto FirstExpr() const -> first_expr_t const&
+		{
+			return _first_expr;
+		}
+
+		constexpr auto FirstExpr() -> first_expr_t&
+		{
+			return _first_expr;
+		}
+
 		constexpr auto operator()() const -> auto
 		{
 			return Num::cos(_first_expr());
@@ -449,6 +763,7 @@ namespace Et {
 		template <int I, typename T>
 		constexpr auto Eval(T& tuple) -> auto
 		{
+			ET_PROFILE_SCOPE(Forward, std::decay_t<decltype(*this)>, I, sizeof(first_value_t) + sizeof(value_t) + sizeof(first_local_grad_t));
 			first_value_t first_value = _first_expr.template Eval<std::tuple_element_t<I, T>::child_one_v>(tuple);
 			std::get<I>(tuple).SetLocalGrads(this, -Num::sin(first_value));
 			return Num::cos(first_value);
@@ -475,6 +790,16 @@ namespace Et {
 		constexpr TanExpr(E1&& first_expr)
 			: _first_expr{ std::forward<E1>(first_expr) } {}
 
+		constexpr auto FirstExpr() const -> first_expr_t const&
+		{
+			return _first_expr;
+		}
+
+		constexpr auto FirstExpr() -> first_expr_t&
+		{
+			return _first_expr;
+		}
+
 		constexpr auto operator()() const -> auto
 		{
 			return Num::tan(_first_expr());
@@ -483,9 +808,9 @@ namespace Et {
 		template <int I, typename T>
 		constexpr auto Eval(T& tuple) -> auto
 		{
+			ET_PROFILE_SCOPE(Forward, std::decay_t<decltype(*this)>, I, sizeof(first_value_t) + sizeof(value_t) + sizeof(first_local_grad_t));
 			first_value_t first_value = _first_expr.template Eval<std::tuple_element_t<I, T>::child_one_v>(tuple);
-			auto sec_value = Num::sec(first_value);
-			std::get<I>(tuple).SetLocalGrads(this, sec_value * sec_value);
+			std::get<I>(tuple).SetLocalGrads(this, _impl_LocalSecSquared(first_value));
 			return Num::tan(first_value);
 		}
 	};
@@ -553,6 +878,60 @@ namespace Et {
 		return { std::forward<E1>(first_expr) };
 	}
 
+	template <typename V>
+	class GradSlot
+	{
+	private:
+		V _value;
+		bool _clean;
+
+	public:
+		constexpr GradSlot() : _value{ Num::zero_v<V> }, _clean{ true } {}
+
+		constexpr auto Add(V const& addition) -> void
+		{
+			if (_clean)
+			{
+				_value = addition;
+				_clean = false;
+			}
+			else
+			{
+				_value += addition;
+			}
+		}
+
+		constexpr auto Add(Num::One) -> void
+		{
+			Add(Num::identity_v<V>);
+		}
+
+		constexpr auto Reset() -> void
+		{
+			_clean = true;
+		}
+
+		constexpr auto IsZero() const -> bool
+		{
+			return _clean;
+		}
+
+		constexpr auto Materialize() -> V&
+		{
+			if (_clean)
+			{
+				_value = Num::zero_v<V>;
+				_clean = false;
+			}
+			return _value;
+		}
+
+		constexpr auto Value() const -> V const&
+		{
+			return _value;
+		}
+	};
+
 	struct _impl_BinaryNode {};
 	struct _impl_UnaryNode {};
 	struct _impl_UntrainableNode {};
@@ -576,9 +955,14 @@ namespace Et {
 		constexpr BinaryNode() : _expr{ nullptr }, _gradient{ Num::zero_v<typename E::value_t> },
 			_first_local_grad{ Num::zero_v<typename E::first_local_grad_t> }, _second_local_grad{ Num::zero_v<typename E::second_local_grad_t> } {}
 
-		constexpr auto AddMyGrad(typename E::value_t const& addition) -> void
+		constexpr auto AddMyGrad(typename E::value_t const& gradient) -> void
+		{
+			_gradient = gradient;
+		}
+
+		constexpr auto AddMyGrad(Num::One) -> void
 		{
-			_gradient += addition;
+			_gradient = Num::identity_v<typename E::value_t>;
 		}
 
 		constexpr auto SetLocalGrads(E* const expr, typename E::first_local_grad_t first_local_grad, typename E::second_local_grad_t second_local_grad) -> void
@@ -588,17 +972,26 @@ namespace Et {
 			_second_local_grad = second_local_grad;
 		}
 
-		template <typename T>
-		constexpr auto SetChildGrads(T& tuple) const -> void
+		template <typename T, typename G>
+		constexpr auto SetChildGrads(T& tuple, G const& gradient) const -> void
 		{
-			std::get<I1>(tuple).AddMyGrad(_gradient * _first_local_grad);
-			std::get<I2>(tuple).AddMyGrad(_gradient * _second_local_grad);
+			if constexpr (has_trainable_v<typename E::first_expr_t>)
+			{
+				std::get<I1>(tuple).AddMyGrad(gradient * _first_local_grad);
+			}
+			if constexpr (has_trainable_v<typename E::second_expr_t>)
+			{
+				std::get<I2>(tuple).AddMyGrad(gradient * _second_local_grad);
+			}
 		}
 
-		constexpr auto ResetGrad() -> void
+		template <typename T>
+		constexpr auto SetChildGrads(T& tuple) const -> void
 		{
-			_gradient = Num::zero_v<typename E::value_t>;
+			SetChildGrads(tuple, _gradient);
 		}
+
+		constexpr auto ResetGrad() -> void {}
 	};
 
 	template <typename E, int I1>
@@ -617,9 +1010,14 @@ namespace Et {
 		constexpr UnaryNode() : _expr{ nullptr }, _gradient{ Num::zero_v<typename E::value_t> }, 
 			_first_local_grad{ Num::zero_v<typename E::first_local_grad_t> } {}
 
-		constexpr auto AddMyGrad(typename E::value_t const& addition) -> void
+		constexpr auto AddMyGrad(typename E::value_t const& gradient) -> void
+		{
+			_gradient = gradient;
+		}
+
+		constexpr auto AddMyGrad(Num::One) -> void
 		{
-			_gradient += addition;
+			_gradient = Num::identity_v<typename E::value_t>;
 		}
 
 		constexpr auto SetLocalGrads(E* const expr, typename E::first_local_grad_t first_local_grad) -> void
@@ -628,16 +1026,22 @@ namespace Et {
 			_first_local_grad = first_local_grad;
 		}
 
-		template <typename T>
-		constexpr auto SetChildGrads(T& tuple) const -> void
+		template <typename T, typename G>
+		constexpr auto SetChildGrads(T& tuple, G const& gradient) const -> void
 		{
-			std::get<I1>(tuple).AddMyGrad(_gradient * _first_local_grad);
+			if constexpr (has_trainable_v<typename E::first_expr_t>)
+			{
+				std::get<I1>(tuple).AddMyGrad(gradient * _first_local_grad);
+			}
 		}
 
-		constexpr auto ResetGrad() -> void
+		template <typename T>
+		constexpr auto SetChildGrads(T& tuple) const -> void
 		{
-			_gradient = Num::zero_v<typename E::value_t>;
+			SetChildGrads(tuple, _gradient);
 		}
+
+		constexpr auto ResetGrad() -> void {}
 	};
 
 	template <typename E, typename = void>
@@ -648,25 +1052,19 @@ namespace Et {
 
 	private:
 		E* _expr;
-		typename E::value_t _gradient;
 
 	public:
-		constexpr TerminalNode() : _expr{ nullptr }, _gradient{ Num::zero_v<typename E::value_t> } {}
+		constexpr TerminalNode() : _expr{ nullptr } {}
 
 		constexpr auto SetLocalGrads(E* const expr) -> void
 		{
 			_expr = expr;
 		}
 
-		constexpr auto AddMyGrad(typename E::value_t const& addition) -> void
-		{
-			_gradient += addition;
-		}
+		template <typename G>
+		constexpr auto AddMyGrad(G const&) -> void {}
 
-		constexpr auto ResetGrad() -> void
-		{
-			_gradient = Num::zero_v<typename E::value_t>;
-		}
+		constexpr auto ResetGrad() -> void {}
 	};
 
 	template <typename E>
@@ -677,29 +1075,43 @@ namespace Et {
 
 	private:
 		E* _expr;
-		typename E::value_t _gradient;
+		GradSlot<typename E::value_t> _gradient;
 
 	public:
-		constexpr TerminalNode() : _expr{ nullptr }, _gradient{ Num::zero_v<typename E::value_t> } {}
+		constexpr TerminalNode() : _expr{ nullptr }, _gradient{} {}
 
 		constexpr auto SetLocalGrads(E* const expr) -> void
 		{
 			_expr = expr;
 		}
 
-		constexpr auto AddMyGrad(typename E::value_t const& addition)
+		template <typename G>
+		constexpr auto AddMyGrad(G const& addition)
 		{
-			_gradient += addition;
+			_gradient.Add(addition);
 		}
 
 		constexpr auto UpdateVariable(double learning_rate) const -> void
 		{
-			_expr->AddDelta(learning_rate * _gradient);
+			if (!_gradient.IsZero())
+			{
+				_expr->AddDelta(learning_rate * _gradient.Value());
+			}
+		}
+
+		constexpr auto Gradient() -> typename E::value_t&
+		{
+			return _gradient.Materialize();
+		}
+
+		constexpr auto Gradient() const -> typename E::value_t
+		{
+			return _gradient.IsZero() ? Num::zero_v<typename E::value_t> : _gradient.Value();
 		}
 		
 		constexpr auto ResetGrad() -> void
 		{
-			_gradient = Num::zero_v<typename E::value_t>;
+			_gradient.Reset();
 		}
 	};
 
@@ -772,6 +1184,26 @@ namespace Et {
 	using dfs_final_tuple_t = _impl_dfs_final_tuple_t<E, dfs_tuple_size_v<E>>;
 
 
+	template <typename N>
+	constexpr auto _impl_node_trainable_size() -> size_t
+	{
+		if constexpr (std::is_base_of_v<_impl_TrainableNode, N>)
+		{
+			using value_t = typename N::expr_t::type::value_t;
+			return sizeof(value_t) / sizeof(typename value_t::num_type);
+		}
+		else
+		{
+			return 0;
+		}
+	}
+
+	template <typename T, size_t... Is>
+	constexpr auto _impl_trainable_size(std::index_sequence<Is...>) -> size_t
+	{
+		return (_impl_node_trainable_size<std::tuple_element_t<Is, T>>() + ... + 0);
+	}
+
 	template <typename V>
 	struct H
 	{
@@ -789,63 +1221,259 @@ namespace Et {
 	{
 	private:
 		static_assert(is_expr_v<E>);
-		using tuple_t = typename dfs_final_tuple_t<E>;
+		using tuple_t = dfs_final_tuple_t<E>;
 		using result_t = typename E::value_t;
 
 		tuple_t _tuple;
 		E& _expr;
 		result_t _result;
+		size_t _min_fork_bytes;
 
 		template <typename... Vs>
 		constexpr auto _impl_FeedPlaceholders(H<Vs>&& ... hs) -> void
 		{
+			ET_TRACE_SCOPE("FeedPlaceholders");
 			((hs._placeholder.FeedValue(hs._value)), ...);
 		}
 
+		constexpr auto _impl_SeedRoot() -> void
+		{
+			using node_t = typename std::tuple_element_t<dfs_tuple_size_v<E> - 1, tuple_t>;
+			if constexpr (!std::is_base_of_v<_impl_UnaryNode, node_t> && !std::is_base_of_v<_impl_BinaryNode, node_t>)
+			{
+				std::get<dfs_tuple_size_v<E> - 1>(_tuple).AddMyGrad(Num::One{});
+			}
+		}
+
 		template <int I>
-		constexpr auto _impl_BackwardPass(double learning_rate) -> void
+		constexpr auto _impl_SetChildGrads() -> void
+		{
+			if constexpr (I == dfs_tuple_size_v<E> - 1)
+			{
+				std::get<I>(_tuple).SetChildGrads(_tuple, Num::One{});
+			}
+			else
+			{
+				std::get<I>(_tuple).SetChildGrads(_tuple);
+			}
+		}
+
+		template <int I>
+		constexpr auto _impl_PropagateGrads() -> void
 		{
 			using node_t = typename std::tuple_element_t<I, tuple_t>;
 
-			if constexpr (std::is_base_of_v<_impl_TrainableNode, node_t>)
+			if constexpr ((std::is_base_of_v<_impl_UnaryNode, node_t> || std::is_base_of_v<_impl_BinaryNode, node_t>) && has_trainable_v<typename node_t::expr_t::type>)
 			{
-				std::get<I>(_tuple).UpdateVariable(learning_rate);
+				{
+					ET_PROFILE_SCOPE(Backward, typename node_t::expr_t::type, I, sizeof(node_t));
+					_impl_SetChildGrads<I>();
+				}
+
+				if constexpr (std::is_base_of_v<_impl_BinaryNode, node_t>)
+				{
+					constexpr size_t first_cost = subtree_cost_v<typename std::tuple_element_t<node_t::child_one_v, tuple_t>::expr_t::type>;
+					constexpr size_t second_cost = subtree_cost_v<typename std::tuple_element_t<node_t::child_two_v, tuple_t>::expr_t::type>;
+					if constexpr (first_cost > 0 && second_cost > 0)
+					{
+						if (ParallelScope::ShouldFork(first_cost, second_cost))
+						{
+							ParallelScope::Fork(
+								[this]() { _impl_PropagateGrads<node_t::child_one_v>(); },
+								[this]() { _impl_PropagateGrads<node_t::child_two_v>(); });
+							return;
+						}
+					}
+					_impl_PropagateGrads<node_t::child_two_v>();
+					_impl_PropagateGrads<node_t::child_one_v>();
+				}
+				else
+				{
+					_impl_PropagateGrads<node_t::child_one_v>();
+				}
 			}
-			else if constexpr (std::is_base_of_v<_impl_UnaryNode, node_t> || std::is_base_of_v<_impl_BinaryNode, node_t>)
+		}
+
+		template <int I>
+		constexpr auto _impl_UpdateVariables(double learning_rate) -> void
+		{
+			using node_t = typename std::tuple_element_t<I, tuple_t>;
+
+			if constexpr (!std::is_base_of_v<_impl_UnaryNode, node_t> && !std::is_base_of_v<_impl_BinaryNode, node_t>)
 			{
-				std::get<I>(_tuple).SetChildGrads(_tuple);
+				ET_PROFILE_SCOPE(Backward, typename node_t::expr_t::type, I, sizeof(node_t));
+				if constexpr (std::is_base_of_v<_impl_TrainableNode, node_t>)
+				{
+					std::get<I>(_tuple).UpdateVariable(learning_rate);
+				}
+				std::get<I>(_tuple).ResetGrad();
+			}
+
+			if constexpr (I > 0)
+			{
+				_impl_UpdateVariables<I - 1>(learning_rate);
 			}
+		}
 
-			std::get<I>(_tuple).ResetGrad();
+		template <int I>
+		constexpr auto _impl_ResetGradients() -> void
+		{
+			using node_t = typename std::tuple_element_t<I, tuple_t>;
+
+			if constexpr (!std::is_base_of_v<_impl_UnaryNode, node_t> && !std::is_base_of_v<_impl_BinaryNode, node_t>)
+			{
+				std::get<I>(_tuple).ResetGrad();
+			}
 
 			if constexpr (I > 0)
 			{
-				_impl_BackwardPass<I - 1>(learning_rate);
+				_impl_ResetGradients<I - 1>();
+			}
+		}
+
+		template <int I, bool Export, typename N>
+		constexpr auto _impl_CopyGradients(N* values) -> void
+		{
+			using node_t = typename std::tuple_element_t<I, tuple_t>;
+
+			if constexpr (std::is_base_of_v<_impl_TrainableNode, node_t>)
+			{
+				using value_t = typename node_t::expr_t::type::value_t;
+				static_assert(std::is_same_v<std::remove_const_t<N>, typename value_t::num_type>);
+				constexpr size_t count = sizeof(value_t) / sizeof(typename value_t::num_type);
+				auto* gradient = reinterpret_cast<typename value_t::num_type*>(&std::get<I>(_tuple).Gradient());
+				for (size_t i = 0; i < count; i++)
+				{
+					if constexpr (Export)
+					{
+						values[i] = gradient[i];
+					}
+					else
+					{
+						gradient[i] = values[i];
+					}
+				}
+				values += count;
+			}
+
+			if constexpr (I + 1 < dfs_tuple_size_v<E>)
+			{
+				_impl_CopyGradients<I + 1, Export>(values);
 			}
 		}
 
+		constexpr auto _impl_Step(double learning_rate) -> void
+		{
+			_impl_SeedRoot();
+			{
+				ET_TRACE_SCOPE("Backward");
+				_impl_PropagateGrads<dfs_tuple_size_v<E> - 1>();
+			}
+			{
+				ET_TRACE_SCOPE("Update");
+				_impl_UpdateVariables<dfs_tuple_size_v<E> - 1>(learning_rate);
+			}
+		}
+
+		auto _impl_ParallelStep(ThreadPool& pool, double learning_rate) -> void
+		{
+			ParallelScope scope{ &pool, _min_fork_bytes };
+			_impl_Step(learning_rate);
+		}
+
 	public:
-		constexpr GradientDescentOptimizer(E& expr) : _expr{ expr } {}
+		constexpr GradientDescentOptimizer(E& expr) : _expr{ expr }, _min_fork_bytes{ size_t{ 1 } << 14 } {}
 
 		template <typename... Vs>
 		constexpr auto ForwardPass(H<Vs>&& ... hs) -> GradientDescentOptimizer &
 		{
-			_impl_FeedPlaceholders(std::forward<H<Vs>...>(hs...));
+			ET_TRACE_ITERATION();
+			ET_TRACE_SCOPE("ForwardPass");
+			ET_PERF_SCOPE("ForwardPass", sizeof(_tuple));
+			_impl_FeedPlaceholders(std::forward<H<Vs>>(hs)...);
 			_result = _expr.template Eval<dfs_tuple_size_v<E> -1>(_tuple);
 			return *this;
 		}
 
 		constexpr auto Minimize(double learning_rate) -> GradientDescentOptimizer &
 		{
-			std::get<dfs_tuple_size_v<E>-1>(_tuple).AddMyGrad(Num::identity_v<typename E::value_t>);
-			_impl_BackwardPass<dfs_tuple_size_v<E> - 1>(-learning_rate);
+			ET_TRACE_SCOPE("Minimize");
+			ET_PERF_SCOPE("Minimize", sizeof(_tuple));
+			_impl_Step(-learning_rate);
 			return *this;
 		}
 
 		constexpr auto Maximize(double learning_rate) -> GradientDescentOptimizer &
 		{
-			std::get<dfs_tuple_size_v<E>-1>(_tuple).AddMyGrad(Num::identity_v<typename E::value_t>);
-			_impl_BackwardPass<dfs_tuple_size_v<E> - 1>(learning_rate);
+			ET_TRACE_SCOPE("Maximize");
+			ET_PERF_SCOPE("Maximize", sizeof(_tuple));
+			_impl_Step(learning_rate);
+			return *this;
+		}
+
+		template <typename... Vs>
+		auto ParallelForwardPass(ThreadPool& pool, H<Vs>&& ... hs) -> GradientDescentOptimizer &
+		{
+			ParallelScope scope{ &pool, _min_fork_bytes };
+			return ForwardPass(std::forward<H<Vs>>(hs)...);
+		}
+
+		auto ParallelMinimize(ThreadPool& pool, double learning_rate) -> GradientDescentOptimizer &
+		{
+			ET_TRACE_SCOPE("Minimize");
+			ET_PERF_SCOPE("Minimize", sizeof(_tuple));
+			_impl_ParallelStep(pool, -learning_rate);
+			return *this;
+		}
+
+		auto ParallelMaximize(ThreadPool& pool, double learning_rate) -> GradientDescentOptimizer &
+		{
+			ET_TRACE_SCOPE("Maximize");
+			ET_PERF_SCOPE("Maximize", sizeof(_tuple));
+			_impl_ParallelStep(pool, learning_rate);
+			return *this;
+		}
+
+		constexpr static size_t gradient_size_v = _impl_trainable_size<tuple_t>(std::make_index_sequence<dfs_tuple_size_v<E>>{});
+
+		constexpr auto Backward() -> GradientDescentOptimizer &
+		{
+			ET_TRACE_SCOPE("Backward");
+			_impl_SeedRoot();
+			_impl_PropagateGrads<dfs_tuple_size_v<E> - 1>();
+			return *this;
+		}
+
+		template <typename N>
+		constexpr auto ExportGradients(N* values) -> GradientDescentOptimizer &
+		{
+			_impl_CopyGradients<0, true>(values);
+			return *this;
+		}
+
+		template <typename N>
+		constexpr auto ImportGradients(N const* values) -> GradientDescentOptimizer &
+		{
+			_impl_CopyGradients<0, false>(values);
+			return *this;
+		}
+
+		constexpr auto ResetGradients() -> GradientDescentOptimizer &
+		{
+			_impl_ResetGradients<dfs_tuple_size_v<E> - 1>();
+			return *this;
+		}
+
+		constexpr auto ApplyGradients(double learning_rate) -> GradientDescentOptimizer &
+		{
+			ET_TRACE_SCOPE("ApplyGradients");
+			_impl_UpdateVariables<dfs_tuple_size_v<E> - 1>(-learning_rate);
+			return *this;
+		}
+
+		auto SetMinForkBytes(size_t min_fork_bytes) -> GradientDescentOptimizer &
+		{
+			_min_fork_bytes = min_fork_bytes;
 			return *this;
 		}
 
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "et_autodiff.h"
+#include "type_name.h"
+
+namespace Et {
+
+	template <typename E, template <typename> typename T>
+	struct _impl_is_terminal_of : std::false_type {};
+
+	template <typename V, template <typename> typename T>
+	struct _impl_is_terminal_of<T<V>, T> : std::true_type {};
+
+	template <typename E>
+	constexpr bool is_constant_v = _impl_is_terminal_of<std::decay_t<E>, ConstantExpr>::value;
+
+	template <typename E>
+	constexpr bool is_placeholder_v = _impl_is_terminal_of<std::decay_t<E>, PlaceholderExpr>::value;
+
+	template <typename E>
+	constexpr bool is_variable_v = _impl_is_terminal_of<std::decay_t<E>, VariableExpr>::value;
+
+	template <typename E>
+	constexpr bool is_unary_v = std::is_base_of_v<_impl_UnaryExpr, std::decay_t<E>>;
+
+	template <typename E>
+	constexpr bool is_binary_v = std::is_base_of_v<_impl_BinaryExpr, std::decay_t<E>>;
+
+	template <typename E>
+	constexpr auto _impl_graph_depth() -> size_t
+	{
+		if constexpr (is_binary_v<E>)
+		{
+			return 1 + std::max(_impl_graph_depth<typename E::first_expr_t>(), _impl_graph_depth<typename E::second_expr_t>());
+		}
+		else if constexpr (is_unary_v<E>)
+		{
+			return 1 + _impl_graph_depth<typename E::first_expr_t>();
+		}
+		else
+		{
+			return 1;
+		}
+	}
+
+	template <typename E>
+	constexpr auto _impl_local_grad_bytes() -> size_t
+	{
+		if constexpr (is_binary_v<E>)
+		{
+			return sizeof(typename E::first_local_grad_t) + sizeof(typename E::second_local_grad_t);
+		}
+		else if constexpr (is_unary_v<E>)
+		{
+			return sizeof(typename E::first_local_grad_t);
+		}
+		else
+		{
+			return 0;
+		}
+	}
+
+	template <typename E>
+	constexpr auto _impl_gradient_bytes() -> size_t
+	{
+		if constexpr (is_binary_v<E> || is_unary_v<E>)
+		{
+			return sizeof(typename E::value_t);
+		}
+		else if constexpr (is_variable_v<E>)
+		{
+			return sizeof(GradSlot<typename E::value_t>);
+		}
+		else
+		{
+			return 0;
+		}
+	}
+
+	struct GraphStats
+	{
+		size_t nodes;
+		size_t constants;
+		size_t placeholders;
+		size_t variables;
+		size_t unary;
+		size_t binary;
+		size_t depth;
+		size_t gradient_bytes;
+		size_t local_grad_bytes;
+		size_t storage_bytes;
+	};
+
+	template <typename E, size_t... Is>
+	constexpr auto _impl_graph_stats(std::index_sequence<Is...>) -> GraphStats
+	{
+		using tuple_t = dfs_tuple_t<E>;
+		return GraphStats{
+			sizeof...(Is),
+			(size_t{ is_constant_v<std::tuple_element_t<Is, tuple_t>> } + ... + 0),
+			(size_t{ is_placeholder_v<std::tuple_element_t<Is, tuple_t>> } + ... + 0),
+			(size_t{ is_variable_v<std::tuple_element_t<Is, tuple_t>> } + ... + 0),
+			(size_t{ is_unary_v<std::tuple_element_t<Is, tuple_t>> } + ... + 0),
+			(size_t{ is_binary_v<std::tuple_element_t<Is, tuple_t>> } + ... + 0),
+			_impl_graph_depth<E>(),
+			(_impl_gradient_bytes<std::tuple_element_t<Is, tuple_t>>() + ... + 0),
+			(_impl_local_grad_bytes<std::tuple_element_t<Is, tuple_t>>() + ... + 0),
+			sizeof(dfs_final_tuple_t<E>) };
+	}
+
+	template <typename E>
+	constexpr GraphStats graph_stats_v = _impl_graph_stats<std::decay_t<E>>(std::make_index_sequence<dfs_tuple_size_v<std::decay_t<E>>>{});
+
+	template <typename E>
+	auto _impl_CollectVariables(E const& expr, std::vector<void const*>& variables) -> void
+	{
+		if constexpr (is_binary_v<E>)
+		{
+			_impl_CollectVariables(expr.FirstExpr(), variables);
+			_impl_CollectVariables(expr.SecondExpr(), variables);
+		}
+		else if constexpr (is_unary_v<E>)
+		{
+			_impl_CollectVariables(expr.FirstExpr(), variables);
+		}
+		else if constexpr (is_variable_v<E>)
+		{
+			if (std::find(variables.begin(), variables.end(), &expr) == variables.end())
+			{
+				variables.push_back(&expr);
+			}
+		}
+	}
+
+	template <typename E>
+	auto UniqueVariableCount(E const& expr) -> size_t
+	{
+		std::vector<void const*> variables;
+		_impl_CollectVariables(expr, variables);
+		return variables.size();
+	}
+
+	template <typename E>
+	constexpr auto _impl_node_kind() -> char const*
+	{
+		if constexpr (is_constant_v<E>) return "constant";
+		else if constexpr (is_placeholder_v<E>) return "placeholder";
+		else if constexpr (is_variable_v<E>) return "variable";
+		else if constexpr (is_unary_v<E>) return "unary";
+		else return "binary";
+	}
+
+	template <typename E, size_t... Is>
+	auto _impl_PrintNodes(std::ostream& stream, std::index_sequence<Is...>) -> void
+	{
+		using tuple_t = dfs_final_tuple_t<E>;
+		([&]()
+		{
+			using node_t = std::tuple_element_t<Is, tuple_t>;
+			using expr_t = typename node_t::expr_t::type;
+			std::string children;
+			if constexpr (is_binary_v<expr_t>)
+			{
+				children = "<- " + std::to_string(node_t::child_one_v) + ", " + std::to_string(node_t::child_two_v);
+			}
+			else if constexpr (is_unary_v<expr_t>)
+			{
+				children = "<- " + std::to_string(node_t::child_one_v);
+			}
+			stream << "  #" << std::left << std::setw(5) << Is << std::setw(13) << _impl_node_kind<expr_t>() << std::setw(12) << children
+				<< std::right << std::setw(6) << sizeof(node_t) << " bytes  " << short_type_name(type_name<expr_t>()) << '\n';
+		}(), ...);
+	}
+
+	template <typename E>
+	auto PrintGraph(std::ostream& stream, E const& expr, bool layout = true) -> void
+	{
+		using expr_t = std::decay_t<E>;
+		constexpr GraphStats stats = graph_stats_v<expr_t>;
+		auto const flags = stream.flags();
+		stream << "graph: " << stats.nodes << " nodes (" << stats.constants << " constants, " << stats.placeholders << " placeholders, "
+			<< stats.variables << " variables [" << UniqueVariableCount(expr) << " unique], " << stats.unary << " unary, " << stats.binary << " binary), depth " << stats.depth << '\n'
+			<< "storage: " << stats.storage_bytes << " bytes (gradients " << stats.gradient_bytes << ", local gradients " << stats.local_grad_bytes << ")\n";
+		if (layout)
+		{
+			_impl_PrintNodes<expr_t>(stream, std::make_index_sequence<stats.nodes>{});
+		}
+		stream.flags(flags);
+	}
+}
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Et {
+
+	enum class Access { Normal, Sequential, Random, WillNeed, DontNeed };
+
+	class MappedFile
+	{
+	private:
+		void* _data;
+		size_t _size;
+		bool _writable;
+#if defined(_WIN32)
+		HANDLE _file;
+		HANDLE _mapping;
+#endif
+
+		auto _impl_Close() -> void
+		{
+#if defined(_WIN32)
+			if (_data != nullptr)
+			{
+				UnmapViewOfFile(_data);
+			}
+			if (_mapping != nullptr)
+			{
+				CloseHandle(_mapping);
+			}
+			if (_file != INVALID_HANDLE_VALUE)
+			{
+				CloseHandle(_file);
+			}
+			_mapping = nullptr;
+			_file = INVALID_HANDLE_VALUE;
+#else
+			if (_data != nullptr)
+			{
+				munmap(_data, _size);
+			}
+#endif
+			_data = nullptr;
+			_size = 0;
+			_writable = false;
+		}
+
+	public:
+		MappedFile() : _data{ nullptr }, _size{ 0 }, _writable{ false }
+#if defined(_WIN32)
+			, _file{ INVALID_HANDLE_VALUE }, _mapping{ nullptr }
+#endif
+		{}
+
+		MappedFile(std::string const& path, Access access = Access::Normal) : MappedFile()
+		{
+#if defined(_WIN32)
+			_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+			LARGE_INTEGER size{};
+			if (_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(_file, &size))
+			{
+				_impl_Close();
+				throw std::runtime_error{ "cannot open " + path };
+			}
+			_size = static_cast<size_t>(size.QuadPart);
+			if (_size > 0)
+			{
+				_mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+				_data = _mapping != nullptr ? MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+				if (_data == nullptr)
+				{
+					_impl_Close();
+					throw std::runtime_error{ "cannot map " + path };
+				}
+			}
+#else
+			int const descriptor = open(path.c_str(), O_RDONLY);
+			struct stat status{};
+			if (descriptor < 0 || fstat(descriptor, &status) != 0)
+			{
+				if (descriptor >= 0)
+				{
+					close(descriptor);
+				}
+				throw std::runtime_error{ "cannot open " + path };
+			}
+			_size = static_cast<size_t>(status.st_size);
+			if (_size > 0)
+			{
+				int flags = MAP_PRIVATE;
+#if defined(MAP_POPULATE)
+				flags |= access == Access::WillNeed ? MAP_POPULATE : 0;
+#endif
+				_data = mmap(nullptr, _size, PROT_READ, flags, descriptor, 0);
+				if (_data == MAP_FAILED)
+				{
+					_data = nullptr;
+					_size = 0;
+					close(descriptor);
+					throw std::runtime_error{ "cannot map " + path };
+				}
+			}
+			close(descriptor);
+#endif
+			Advise(0, _size, access);
+		}
+
+		MappedFile(std::string const& path, size_t size) : MappedFile()
+		{
+			_size = size;
+			_writable = true;
+#if defined(_WIN32)
+			_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+			LARGE_INTEGER end{};
+			end.QuadPart = static_cast<LONGLONG>(size);
+			if (_file == INVALID_HANDLE_VALUE || !SetFilePointerEx(_file, end, nullptr, FILE_BEGIN) || !SetEndOfFile(_file))
+			{
+				_impl_Close();
+				throw std::runtime_error{ "cannot open " + path + " for writing" };
+			}
+			if (_size > 0)
+			{
+				_mapping = CreateFileMappingA(_file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+				_data = _mapping != nullptr ? MapViewOfFile(_mapping, FILE_MAP_WRITE, 0, 0, 0) : nullptr;
+				if (_data == nullptr)
+				{
+					_impl_Close();
+					throw std::runtime_error{ "cannot map " + path };
+				}
+			}
+#else
+			int const descriptor = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+			if (descriptor < 0 || ftruncate(descriptor, static_cast<off_t>(size)) != 0)
+			{
+				if (descriptor >= 0)
+				{
+					close(descriptor);
+				}
+				_size = 0;
+				throw std::runtime_error{ "cannot open " + path + " for writing" };
+			}
+			if (_size > 0)
+			{
+				_data = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+				if (_data == MAP_FAILED)
+				{
+					_data = nullptr;
+					_size = 0;
+					close(descriptor);
+					throw std::runtime_error{ "cannot map " + path };
+				}
+			}
+			close(descriptor);
+#endif
+		}
+
+		MappedFile(MappedFile const&) = delete;
+		auto operator=(MappedFile const&) -> MappedFile & = delete;
+
+		MappedFile(MappedFile&& other) noexcept : MappedFile()
+		{
+			*this = std::move(other);
+		}
+
+		auto operator=(MappedFile&& other) noexcept -> MappedFile &
+		{
+			if (this != &other)
+			{
+				_impl_Close();
+				std::swap(_data, other._data);
+				std::swap(_size, other._size);
+				std::swap(_writable, other._writable);
+#if defined(_WIN32)
+				std::swap(_file, other._file);
+				std::swap(_mapping, other._mapping);
+#endif
+			}
+			return *this;
+		}
+
+		~MappedFile()
+		{
+			_impl_Close();
+		}
+
+		auto Data() const -> unsigned char const*
+		{
+			return static_cast<unsigned char const*>(_data);
+		}
+
+		auto Size() const -> size_t
+		{
+			return _size;
+		}
+
+		auto MutableData() -> unsigned char*
+		{
+			if (!_writable)
+			{
+				throw std::logic_error{ "mapped file was opened read-only" };
+			}
+			return static_cast<unsigned char*>(_data);
+		}
+
+		auto Advise(size_t offset, size_t length, Access access) const -> void
+		{
+#if !defined(_WIN32)
+			if (_data == nullptr || offset >= _size)
+			{
+				return;
+			}
+			size_t const page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			size_t const begin = offset / page * page;
+			size_t const end = offset + std::min(length, _size - offset);
+			int advice = MADV_NORMAL;
+			switch (access)
+			{
+			case Access::Normal: advice = MADV_NORMAL; break;
+			case Access::Sequential: advice = MADV_SEQUENTIAL; break;
+			case Access::Random: advice = MADV_RANDOM; break;
+			case Access::WillNeed: advice = MADV_WILLNEED; break;
+			case Access::DontNeed: advice = MADV_DONTNEED; break;
+			}
+			madvise(static_cast<char*>(_data) + begin, end - begin, advice);
+#endif
+		}
+
+		auto Flush(size_t offset, size_t length, bool wait = false) const -> void
+		{
+			if (_data == nullptr || !_writable || offset >= _size)
+			{
+				return;
+			}
+#if defined(_WIN32)
+			FlushViewOfFile(static_cast<char*>(_data) + offset, std::min(_size - offset, length));
+#else
+			size_t const page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+			size_t const begin = offset / page * page;
+			size_t const end = offset + std::min(length, _size - offset);
+			msync(static_cast<char*>(_data) + begin, end - begin, wait ? MS_SYNC : MS_ASYNC);
+#endif
+		}
+	};
+}
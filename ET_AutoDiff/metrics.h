@@ -0,0 +1,296 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Et {
+
+	namespace Metrics {
+
+		enum class Encoding { Csv, Binary };
+
+		struct Sample
+		{
+			uint64_t iteration;
+			uint32_t metric;
+			uint32_t _padding;
+			double value;
+		};
+
+		constexpr char binary_magic_v[4] = { 'E', 'T', 'M', 'S' };
+		constexpr uint32_t binary_version_v = 1;
+
+		class Sink
+		{
+		private:
+			std::vector<Sample> _ring;
+			uint64_t _mask;
+			alignas(64) std::atomic<uint64_t> _head;
+			uint64_t _cached_tail;
+			alignas(64) std::atomic<uint64_t> _tail;
+			uint64_t _dropped;
+			std::atomic<bool> _running;
+
+			std::unique_ptr<std::ofstream> _file;
+			std::ostream& _stream;
+			Encoding _encoding;
+			std::vector<std::string> _names;
+
+			std::mutex _mutex;
+			std::condition_variable _wake;
+			bool _stopping;
+			bool _started;
+			std::chrono::milliseconds _interval;
+			std::thread _drain;
+
+			static auto _impl_RoundUp(size_t capacity) -> size_t
+			{
+				size_t size = 1;
+				while (size < capacity)
+				{
+					size <<= 1;
+				}
+				return size;
+			}
+
+			auto _impl_WriteHeader(std::string& buffer) -> void
+			{
+				if (_encoding == Encoding::Csv)
+				{
+					buffer += "metric,iteration,value\n";
+					return;
+				}
+				auto append = [&buffer](void const* data, size_t size) { buffer.append(static_cast<char const*>(data), size); };
+				uint32_t const n_names = static_cast<uint32_t>(_names.size());
+				append(binary_magic_v, sizeof(binary_magic_v));
+				append(&binary_version_v, sizeof(binary_version_v));
+				append(&n_names, sizeof(n_names));
+				for (auto const& name : _names)
+				{
+					uint32_t const length = static_cast<uint32_t>(name.size());
+					append(&length, sizeof(length));
+					append(name.data(), name.size());
+				}
+			}
+
+			auto _impl_Encode(Sample const& sample, std::string& buffer) const -> void
+			{
+				if (_encoding == Encoding::Binary)
+				{
+					buffer.append(reinterpret_cast<char const*>(&sample), sizeof(Sample));
+					return;
+				}
+				char line[64];
+				int const length = std::snprintf(line, sizeof(line), ",%llu,%.17g\n", static_cast<unsigned long long>(sample.iteration), sample.value);
+				buffer += sample.metric < _names.size() ? _names[sample.metric] : std::to_string(sample.metric);
+				buffer.append(line, static_cast<size_t>(length));
+			}
+
+			auto _impl_DrainOnce(std::string& buffer) -> bool
+			{
+				uint64_t const head = _head.load(std::memory_order_acquire);
+				uint64_t tail = _tail.load(std::memory_order_relaxed);
+				if (head == tail && buffer.empty())
+				{
+					return false;
+				}
+				for (; tail != head; tail++)
+				{
+					_impl_Encode(_ring[tail & _mask], buffer);
+				}
+				_tail.store(tail, std::memory_order_release);
+				_stream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+				_stream.flush();
+				buffer.clear();
+				return true;
+			}
+
+			auto _impl_DrainLoop(bool write_header) -> void
+			{
+				std::string buffer;
+				buffer.reserve(1 << 16);
+				if (write_header)
+				{
+					_impl_WriteHeader(buffer);
+				}
+				while (true)
+				{
+					bool const stopping = [this]()
+					{
+						std::unique_lock<std::mutex> lock{ _mutex };
+						_wake.wait_for(lock, _interval);
+						return _stopping;
+					}();
+					while (_impl_DrainOnce(buffer)) {}
+					if (stopping)
+					{
+						return;
+					}
+				}
+			}
+
+			auto _impl_MakeRoom(uint64_t head) -> bool
+			{
+				_cached_tail = _tail.load(std::memory_order_acquire);
+				while (head - _cached_tail > _mask)
+				{
+					if (!_running.load(std::memory_order_acquire))
+					{
+						return false;
+					}
+					std::this_thread::yield();
+					_cached_tail = _tail.load(std::memory_order_acquire);
+				}
+				return true;
+			}
+
+		public:
+			Sink(std::ostream& stream, Encoding encoding = Encoding::Csv, size_t capacity = size_t{ 1 } << 16, std::chrono::milliseconds interval = std::chrono::milliseconds(10))
+				: _ring(_impl_RoundUp(capacity)), _mask{ _ring.size() - 1 }, _head{ 0 }, _cached_tail{ 0 }, _tail{ 0 }, _dropped{ 0 }, _running{ false },
+				_stream{ stream }, _encoding{ encoding }, _stopping{ false }, _started{ false }, _interval{ interval } {}
+
+			Sink(std::string const& path, Encoding encoding = Encoding::Binary, size_t capacity = size_t{ 1 } << 16, std::chrono::milliseconds interval = std::chrono::milliseconds(10))
+				: _ring(_impl_RoundUp(capacity)), _mask{ _ring.size() - 1 }, _head{ 0 }, _cached_tail{ 0 }, _tail{ 0 }, _dropped{ 0 }, _running{ false },
+				_file{ std::make_unique<std::ofstream>(path, std::ios::binary) }, _stream{ *_file }, _encoding{ encoding }, _stopping{ false }, _started{ false }, _interval{ interval }
+			{
+				if (!*_file)
+				{
+					throw std::runtime_error{ "cannot open metrics file " + path };
+				}
+			}
+
+			Sink(Sink const&) = delete;
+			auto operator=(Sink const&) -> Sink & = delete;
+
+			// Samples recorded while no drain thread was running are written out here instead of being lost
+			~Sink()
+			{
+				Stop();
+				std::string buffer;
+				if (!_started)
+				{
+					_impl_WriteHeader(buffer);
+				}
+				_impl_DrainOnce(buffer);
+			}
+
+			auto Register(std::string name) -> uint32_t
+			{
+				if (_started)
+				{
+					throw std::logic_error{ "metrics must be registered before the first Start" };
+				}
+				_names.push_back(std::move(name));
+				return static_cast<uint32_t>(_names.size() - 1);
+			}
+
+			auto Start() -> void
+			{
+				if (!_drain.joinable())
+				{
+					bool const write_header = !_started;
+					_started = true;
+					_stopping = false;
+					_running.store(true, std::memory_order_release);
+					_drain = std::thread{ [this, write_header]() { _impl_DrainLoop(write_header); } };
+				}
+			}
+
+			auto Stop() -> void
+			{
+				if (!_drain.joinable())
+				{
+					return;
+				}
+				{
+					std::lock_guard<std::mutex> lock{ _mutex };
+					_stopping = true;
+				}
+				_wake.notify_one();
+				_drain.join();
+				_running.store(false, std::memory_order_release);
+			}
+
+			auto Record(uint32_t metric, uint64_t iteration, double value) -> void
+			{
+				uint64_t const head = _head.load(std::memory_order_relaxed);
+				if (head - _cached_tail > _mask && !_impl_MakeRoom(head))
+				{
+					_dropped++;
+					return;
+				}
+				Sample& sample = _ring[head & _mask];
+				sample.iteration = iteration;
+				sample.metric = metric;
+				sample.value = value;
+				_head.store(head + 1, std::memory_order_release);
+			}
+
+			auto Recorded() const -> uint64_t
+			{
+				return _head.load(std::memory_order_relaxed);
+			}
+
+			auto Dropped() const -> uint64_t
+			{
+				return _dropped;
+			}
+		};
+
+		struct Log
+		{
+			std::vector<std::string> names;
+			std::vector<Sample> samples;
+		};
+
+		inline auto ReadBinary(std::istream& stream) -> Log
+		{
+			auto read = [&stream](void* data, size_t size)
+			{
+				if (!stream.read(static_cast<char*>(data), static_cast<std::streamsize>(size)))
+				{
+					throw std::runtime_error{ "truncated metrics log" };
+				}
+			};
+
+			char magic[4];
+			uint32_t version = 0, n_names = 0;
+			read(magic, sizeof(magic));
+			read(&version, sizeof(version));
+			if (std::memcmp(magic, binary_magic_v, sizeof(magic)) != 0 || version != binary_version_v)
+			{
+				throw std::runtime_error{ "not a metrics log" };
+			}
+			read(&n_names, sizeof(n_names));
+
+			Log log;
+			for (uint32_t i = 0; i < n_names; i++)
+			{
+				uint32_t length = 0;
+				read(&length, sizeof(length));
+				std::string name(length, '\0');
+				read(name.data(), length);
+				log.names.push_back(std::move(name));
+			}
+			Sample sample;
+			while (stream.read(reinterpret_cast<char*>(&sample), sizeof(Sample)))
+			{
+				log.samples.push_back(sample);
+			}
+			return log;
+		}
+	}
+}
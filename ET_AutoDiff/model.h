@@ -0,0 +1,408 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "graph_stats.h"
+#include "mapped_file.h"
+#include "runtime_expr.h"
+
+namespace Et {
+
+	namespace Runtime {
+
+		class ModelError : public std::runtime_error
+		{
+		public:
+			using std::runtime_error::runtime_error;
+		};
+
+		constexpr char model_magic_v[4] = { 'E', 'T', 'M', 'D' };
+		constexpr uint32_t model_version_v = 1;
+		constexpr uint32_t model_max_rank_v = 4;
+
+		struct ModelHeader
+		{
+			char magic[4];
+			uint32_t version;
+			uint32_t n_variables;
+			uint32_t n_placeholders;
+			uint32_t n_constants;
+			uint32_t n_instructions;
+			uint32_t n_registers;
+			uint32_t result_register;
+			uint64_t n_values;
+			uint64_t names_offset;
+			uint64_t names_bytes;
+			uint64_t shapes_offset;
+			uint64_t values_offset;
+			uint64_t constants_offset;
+			uint64_t code_offset;
+			uint64_t file_bytes;
+		};
+
+		struct ModelShape
+		{
+			uint32_t rank;
+			uint32_t dims[model_max_rank_v];
+		};
+
+		struct ModelInstruction
+		{
+			uint8_t op;
+			uint8_t flags;
+			uint16_t reserved;
+			uint32_t target;
+			uint32_t first;
+			uint32_t second;
+		};
+
+		static_assert(sizeof(ModelHeader) == 96 && sizeof(ModelShape) == 20 && sizeof(ModelInstruction) == 16);
+
+		struct Model
+		{
+			Program program;
+			std::vector<double> variables;
+		};
+
+		inline auto _impl_FitsBefore(uint64_t offset, uint64_t element_bytes, uint64_t count, uint64_t limit) -> bool
+		{
+			return offset <= limit && count <= (limit - offset) / element_bytes;
+		}
+
+		inline auto _impl_IsLittleEndian() -> bool
+		{
+			uint16_t const probe = 1;
+			unsigned char first_byte = 0;
+			std::memcpy(&first_byte, &probe, 1);
+			return first_byte == 1;
+		}
+
+		inline auto _impl_AlignTo8(uint64_t offset) -> uint64_t
+		{
+			return (offset + 7) & ~uint64_t{ 7 };
+		}
+
+		inline auto SaveModel(std::string const& path, Program const& program, std::vector<double> const& variables) -> void
+		{
+			if (!_impl_IsLittleEndian())
+			{
+				throw ModelError{ "model files are little-endian only" };
+			}
+			if (variables.size() != program.Variables().size())
+			{
+				throw ModelError{ "expected one value per program variable" };
+			}
+
+			std::string names;
+			for (auto const& name : program.Variables())
+			{
+				names += name + '\0';
+			}
+			for (auto const& name : program.Placeholders())
+			{
+				names += name + '\0';
+			}
+
+			ModelHeader header{};
+			std::memcpy(header.magic, model_magic_v, sizeof(header.magic));
+			header.version = model_version_v;
+			header.n_variables = static_cast<uint32_t>(program.Variables().size());
+			header.n_placeholders = static_cast<uint32_t>(program.Placeholders().size());
+			header.n_constants = static_cast<uint32_t>(program.Constants().size());
+			header.n_instructions = static_cast<uint32_t>(program.Code().size());
+			header.n_registers = program.RegisterCount();
+			header.result_register = program.ResultRegister();
+			header.n_values = variables.size();
+			header.names_offset = sizeof(ModelHeader);
+			header.names_bytes = names.size();
+			header.shapes_offset = _impl_AlignTo8(header.names_offset + header.names_bytes);
+			header.values_offset = _impl_AlignTo8(header.shapes_offset + sizeof(ModelShape) * header.n_variables);
+			header.constants_offset = header.values_offset + sizeof(double) * header.n_values;
+			header.code_offset = header.constants_offset + sizeof(double) * header.n_constants;
+			header.file_bytes = header.code_offset + sizeof(ModelInstruction) * header.n_instructions;
+
+			std::vector<unsigned char> buffer(header.file_bytes, 0);
+			std::memcpy(buffer.data(), &header, sizeof(header));
+			std::memcpy(buffer.data() + header.names_offset, names.data(), names.size());
+			for (uint32_t i = 0; i < header.n_variables; i++)
+			{
+				ModelShape const shape{ 0, { 0, 0, 0, 0 } };
+				std::memcpy(buffer.data() + header.shapes_offset + i * sizeof(ModelShape), &shape, sizeof(shape));
+			}
+			std::memcpy(buffer.data() + header.values_offset, variables.data(), sizeof(double) * header.n_values);
+			std::memcpy(buffer.data() + header.constants_offset, program.Constants().data(), sizeof(double) * header.n_constants);
+			for (uint32_t i = 0; i < header.n_instructions; i++)
+			{
+				auto const& instruction = program.Code()[i];
+				ModelInstruction const encoded{ static_cast<uint8_t>(instruction.op),
+					static_cast<uint8_t>((instruction.first_needs_grad ? 1 : 0) | (instruction.second_needs_grad ? 2 : 0)), 0,
+					instruction.target, instruction.first, instruction.second };
+				std::memcpy(buffer.data() + header.code_offset + i * sizeof(ModelInstruction), &encoded, sizeof(encoded));
+			}
+
+			std::ofstream stream{ path, std::ios::binary | std::ios::trunc };
+			stream.write(reinterpret_cast<char const*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+			if (!stream)
+			{
+				throw ModelError{ "cannot write " + path };
+			}
+		}
+
+		struct ExprName
+		{
+			std::string name;
+			void const* expr;
+			bool variable;
+
+			template <typename V>
+			ExprName(std::string name, VariableExpr<V> const& expr) : name{ std::move(name) }, expr{ &expr }, variable{ true } {}
+
+			template <typename V>
+			ExprName(std::string name, PlaceholderExpr<V> const& expr) : name{ std::move(name) }, expr{ &expr }, variable{ false } {}
+		};
+
+		template <typename E, template <typename, typename> typename T>
+		struct _impl_is_binary_of : std::false_type {};
+
+		template <typename E1, typename E2, template <typename, typename> typename T>
+		struct _impl_is_binary_of<T<E1, E2>, T> : std::true_type {};
+
+		template <typename E, template <typename> typename T>
+		struct _impl_is_unary_of : std::false_type {};
+
+		template <typename E1, template <typename> typename T>
+		struct _impl_is_unary_of<T<E1>, T> : std::true_type {};
+
+		template <typename E>
+		constexpr auto _impl_ExprOpCode() -> OpCode
+		{
+			if constexpr (_impl_is_binary_of<E, AddExpr>::value) return OpCode::Add;
+			else if constexpr (_impl_is_binary_of<E, SubtractExpr>::value) return OpCode::Subtract;
+			else if constexpr (_impl_is_binary_of<E, MultiplyExpr>::value) return OpCode::Multiply;
+			else if constexpr (_impl_is_binary_of<E, DivideExpr>::value) return OpCode::Divide;
+			else if constexpr (_impl_is_binary_of<E, PowerExpr>::value) return OpCode::Power;
+			else if constexpr (_impl_is_unary_of<E, NegateExpr>::value) return OpCode::Negate;
+			else if constexpr (_impl_is_unary_of<E, LogExpr>::value) return OpCode::Log;
+			else if constexpr (_impl_is_unary_of<E, SinExpr>::value) return OpCode::Sin;
+			else if constexpr (_impl_is_unary_of<E, CosExpr>::value) return OpCode::Cos;
+			else
+			{
+				static_assert(_impl_is_unary_of<E, TanExpr>::value, "expression has no runtime opcode");
+				return OpCode::Tan;
+			}
+		}
+
+		class _impl_ExprLowering
+		{
+		private:
+			std::vector<ExprName> const& _variables;
+			std::vector<ExprName> const& _placeholders;
+			Graph _graph;
+			std::vector<double> _values;
+			std::vector<bool> _variable_used;
+			std::vector<bool> _placeholder_used;
+
+			static auto _impl_Names(std::vector<ExprName> const& named) -> std::vector<std::string>
+			{
+				std::vector<std::string> names;
+				for (auto const& entry : named)
+				{
+					names.push_back(entry.name);
+				}
+				return names;
+			}
+
+			auto _impl_Index(void const* expr, bool variable) const -> uint32_t
+			{
+				auto const& named = variable ? _variables : _placeholders;
+				for (uint32_t i = 0; i < named.size(); i++)
+				{
+					if (named[i].expr == expr)
+					{
+						return i;
+					}
+				}
+				throw ModelError{ std::string{ variable ? "a variable" : "a placeholder" } + " of the expression has no name" };
+			}
+
+			template <typename E>
+			auto _impl_Node(E const& expr) -> uint32_t
+			{
+				if constexpr (is_binary_v<E>)
+				{
+					uint32_t const first = _impl_Node(expr.FirstExpr());
+					uint32_t const second = _impl_Node(expr.SecondExpr());
+					return _graph.Binary(_impl_ExprOpCode<E>(), first, second);
+				}
+				else if constexpr (is_unary_v<E>)
+				{
+					return _graph.Unary(_impl_ExprOpCode<E>(), _impl_Node(expr.FirstExpr()));
+				}
+				else
+				{
+					static_assert(std::is_same_v<typename E::value_t, Num::Scalar<double>>, "model files hold scalar double expressions");
+					if constexpr (is_constant_v<E>)
+					{
+						return _graph.Constant(expr().GetValue());
+					}
+					else if constexpr (is_variable_v<E>)
+					{
+						uint32_t const index = _impl_Index(&expr, true);
+						_values[index] = expr().GetValue();
+						_variable_used[index] = true;
+						return _graph.Variable(index);
+					}
+					else
+					{
+						uint32_t const index = _impl_Index(&expr, false);
+						_placeholder_used[index] = true;
+						return _graph.Placeholder(index);
+					}
+				}
+			}
+
+			auto _impl_CheckUsed(std::vector<ExprName> const& named, std::vector<bool> const& used, bool variable) const -> void
+			{
+				for (size_t i = 0; i < named.size(); i++)
+				{
+					if (named[i].variable != variable)
+					{
+						throw ModelError{ named[i].name + (variable ? " is not a variable" : " is not a placeholder") };
+					}
+					if (!used[i])
+					{
+						throw ModelError{ named[i].name + " is not part of the expression" };
+					}
+					for (size_t j = 0; j < i; j++)
+					{
+						if (named[j].name == named[i].name || named[j].expr == named[i].expr)
+						{
+							throw ModelError{ named[i].name + " is named twice" };
+						}
+					}
+				}
+			}
+
+		public:
+			_impl_ExprLowering(std::vector<ExprName> const& variables, std::vector<ExprName> const& placeholders)
+				: _variables{ variables }, _placeholders{ placeholders }, _graph{ _impl_Names(variables), _impl_Names(placeholders) },
+				_values(variables.size(), 0.0), _variable_used(variables.size(), false), _placeholder_used(placeholders.size(), false) {}
+
+			template <typename E>
+			auto Run(E const& expr) -> Model
+			{
+				_graph.SetRoot(_impl_Node(expr));
+				_impl_CheckUsed(_variables, _variable_used, true);
+				_impl_CheckUsed(_placeholders, _placeholder_used, false);
+				return { Lower(_graph), std::move(_values) };
+			}
+		};
+
+		template <typename E, typename = std::enable_if_t<is_expr_v<E>>>
+		auto LowerModel(E const& expr, std::vector<ExprName> const& variables, std::vector<ExprName> const& placeholders = {}) -> Model
+		{
+			return _impl_ExprLowering{ variables, placeholders }.Run(expr);
+		}
+
+		template <typename E, typename = std::enable_if_t<is_expr_v<E>>>
+		auto SaveModel(std::string const& path, E const& expr, std::vector<ExprName> const& variables, std::vector<ExprName> const& placeholders = {}) -> void
+		{
+			auto const model = LowerModel(expr, variables, placeholders);
+			SaveModel(path, model.program, model.variables);
+		}
+
+		inline auto LoadModel(std::string const& path) -> Model
+		{
+			// The whole file is decoded right away, so prefault it in one pass instead of page by page
+			MappedFile const file{ path, Access::WillNeed };
+			unsigned char const* data = file.Data();
+
+			ModelHeader header{};
+			if (file.Size() < sizeof(header))
+			{
+				throw ModelError{ path + " is not a model file" };
+			}
+			std::memcpy(&header, data, sizeof(header));
+			if (std::memcmp(header.magic, model_magic_v, sizeof(header.magic)) != 0 || !_impl_IsLittleEndian())
+			{
+				throw ModelError{ path + " is not a model file" };
+			}
+			if (header.version != model_version_v)
+			{
+				throw ModelError{ path + " has unsupported model version " + std::to_string(header.version) };
+			}
+
+			uint64_t const n_inputs = uint64_t{ header.n_constants } + header.n_variables + header.n_placeholders;
+			bool const consistent = header.file_bytes == file.Size()
+				&& header.names_offset >= sizeof(header)
+				&& header.shapes_offset <= header.file_bytes && header.values_offset <= header.file_bytes
+				&& header.constants_offset <= header.file_bytes && header.code_offset <= header.file_bytes
+				&& _impl_FitsBefore(header.names_offset, 1, header.names_bytes, header.shapes_offset)
+				&& _impl_FitsBefore(header.shapes_offset, sizeof(ModelShape), header.n_variables, header.values_offset)
+				&& _impl_FitsBefore(header.values_offset, sizeof(double), header.n_values, header.constants_offset)
+				&& _impl_FitsBefore(header.constants_offset, sizeof(double), header.n_constants, header.code_offset)
+				&& _impl_FitsBefore(header.code_offset, sizeof(ModelInstruction), header.n_instructions, header.file_bytes)
+				&& header.n_values == header.n_variables
+				&& header.n_registers == n_inputs + header.n_instructions
+				&& header.result_register < header.n_registers;
+			if (!consistent)
+			{
+				throw ModelError{ path + " is truncated or corrupt" };
+			}
+
+			std::vector<std::string> names;
+			char const* cursor = reinterpret_cast<char const*>(data + header.names_offset);
+			char const* names_end = cursor + header.names_bytes;
+			while (cursor < names_end && names.size() < uint64_t{ header.n_variables } + header.n_placeholders)
+			{
+				size_t const length = static_cast<size_t>(std::find(cursor, names_end, '\0') - cursor);
+				names.emplace_back(cursor, length);
+				cursor += length + 1;
+			}
+			if (names.size() != uint64_t{ header.n_variables } + header.n_placeholders)
+			{
+				throw ModelError{ path + " has a malformed name table" };
+			}
+			for (uint32_t i = 0; i < header.n_variables; i++)
+			{
+				ModelShape shape{};
+				std::memcpy(&shape, data + header.shapes_offset + i * sizeof(ModelShape), sizeof(shape));
+				if (shape.rank != 0 || shape.dims[0] != 0 || shape.dims[1] != 0 || shape.dims[2] != 0 || shape.dims[3] != 0)
+				{
+					throw ModelError{ path + " has a tensor-valued variable " + names[i] + ", only scalar variables are supported" };
+				}
+			}
+			std::vector<std::string> variables(names.begin(), names.begin() + header.n_variables);
+			std::vector<std::string> placeholders(names.begin() + header.n_variables, names.end());
+
+			std::vector<double> values(header.n_values);
+			std::memcpy(values.data(), data + header.values_offset, sizeof(double) * header.n_values);
+			std::vector<double> constants(header.n_constants);
+			std::memcpy(constants.data(), data + header.constants_offset, sizeof(double) * header.n_constants);
+
+			std::vector<Instruction> code(header.n_instructions);
+			for (uint32_t i = 0; i < header.n_instructions; i++)
+			{
+				ModelInstruction encoded{};
+				std::memcpy(&encoded, data + header.code_offset + i * sizeof(ModelInstruction), sizeof(encoded));
+				auto const op = static_cast<OpCode>(encoded.op);
+				bool const known_op = IsBinary(op) || (IsUnary(op) && encoded.op <= static_cast<uint8_t>(OpCode::Tan));
+				if (!known_op || encoded.target != n_inputs + i || encoded.first >= encoded.target
+					|| (IsBinary(op) ? encoded.second >= encoded.target : encoded.second != 0))
+				{
+					throw ModelError{ path + " has an invalid instruction at " + std::to_string(i) };
+				}
+				code[i] = { op, (encoded.flags & 1) != 0, (encoded.flags & 2) != 0, encoded.target, encoded.first, encoded.second };
+			}
+
+			return { Program{ std::move(variables), std::move(placeholders), std::move(constants), std::move(code), header.n_registers, header.result_register },
+				std::move(values) };
+		}
+	}
+}
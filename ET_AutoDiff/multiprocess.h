@@ -0,0 +1,400 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace Et {
+
+	namespace MultiProcess {
+
+		// ReduceScatter: each rank sums its own chunk across every shared slot, then all ranks copy the combined result.
+		// Tree: pairwise sums into rank 0's slot over log2(workers) barrier rounds.
+		enum class Reduction { ReduceScatter, Tree };
+
+		struct Options
+		{
+			size_t workers = 2;
+			Reduction reduction = Reduction::ReduceScatter;
+			bool numa_affinity = true;
+			// How often a worker waiting in Barrier re-checks whether a peer has left; Run also wakes waiters when a worker exits
+			int barrier_poll_ms = 100;
+		};
+
+		class PeerLost : public std::runtime_error
+		{
+		public:
+			PeerLost() : std::runtime_error{ "a peer worker left before reaching the barrier" } {}
+		};
+
+		struct WorkerStatus
+		{
+			pid_t pid;
+			bool exited;
+			int exit_code;
+			int signal;
+			double report;
+		};
+
+		constexpr size_t cache_line_v = 64;
+
+		inline auto _impl_Align(size_t bytes) -> size_t
+		{
+			return (bytes + cache_line_v - 1) / cache_line_v * cache_line_v;
+		}
+
+		inline auto _impl_Futex(std::atomic<uint32_t>* address, int op, uint32_t value, timespec const* timeout) -> long
+		{
+			return syscall(SYS_futex, reinterpret_cast<uint32_t*>(address), op, value, timeout, nullptr, 0);
+		}
+
+		struct _impl_Header
+		{
+			alignas(cache_line_v) std::atomic<uint32_t> arrived;
+			alignas(cache_line_v) std::atomic<uint32_t> generation;
+			alignas(cache_line_v) std::atomic<uint32_t> aborted;
+			alignas(cache_line_v) std::atomic<uint32_t> departed;
+		};
+
+		inline auto NumaNodeCpus() -> std::vector<std::vector<int>>
+		{
+			std::vector<std::vector<int>> nodes;
+			for (int node = 0;; node++)
+			{
+				std::ifstream stream{ "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist" };
+				if (!stream)
+				{
+					break;
+				}
+				std::vector<int> cpus;
+				std::string range;
+				while (std::getline(stream, range, ','))
+				{
+					int first = 0, last = 0;
+					char dash = 0;
+					std::istringstream parser{ range };
+					parser >> first;
+					last = parser >> dash >> last ? last : first;
+					for (int cpu = first; cpu <= last; cpu++)
+					{
+						cpus.push_back(cpu);
+					}
+				}
+				if (!cpus.empty())
+				{
+					nodes.push_back(std::move(cpus));
+				}
+			}
+			return nodes;
+		}
+
+		class WorkerContext
+		{
+		private:
+			_impl_Header* _header;
+			double* _slots;
+			double* _result;
+			double* _reports;
+			size_t _rank;
+			size_t _size;
+			size_t _n_values;
+			size_t _slot_stride;
+			Options const& _options;
+
+			auto _impl_Slot(size_t rank) const -> double*
+			{
+				return _slots + rank * _slot_stride;
+			}
+
+		public:
+			WorkerContext(_impl_Header* header, double* slots, double* result, double* reports, size_t rank, size_t n_values, size_t slot_stride, Options const& options)
+				: _header{ header }, _slots{ slots }, _result{ result }, _reports{ reports }, _rank{ rank }, _size{ options.workers },
+				_n_values{ n_values }, _slot_stride{ slot_stride }, _options{ options } {}
+
+			auto Rank() const -> size_t
+			{
+				return _rank;
+			}
+
+			auto Size() const -> size_t
+			{
+				return _size;
+			}
+
+			auto Barrier() -> void
+			{
+				uint32_t const generation = _header->generation.load(std::memory_order_acquire);
+				if (_header->arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == _size)
+				{
+					_header->arrived.store(0, std::memory_order_relaxed);
+					_header->generation.fetch_add(1, std::memory_order_acq_rel);
+					_impl_Futex(&_header->generation, FUTEX_WAKE, INT_MAX, nullptr);
+					return;
+				}
+				timespec const timeout{ _options.barrier_poll_ms / 1000, (_options.barrier_poll_ms % 1000) * 1000000L };
+				while (_header->generation.load(std::memory_order_acquire) == generation)
+				{
+					bool const stranded = _header->aborted.load(std::memory_order_acquire) != 0 || _header->departed.load(std::memory_order_acquire) != 0;
+					if (stranded && _header->generation.load(std::memory_order_acquire) == generation)
+					{
+						throw PeerLost{};
+					}
+					_impl_Futex(&_header->generation, FUTEX_WAIT, generation, &timeout);
+				}
+			}
+
+			auto Capacity() const -> size_t
+			{
+				return _n_values;
+			}
+
+			auto AllReduce(double* values, size_t count) -> void
+			{
+				if (count > _n_values)
+				{
+					throw std::length_error{ "AllReduce of " + std::to_string(count) + " values exceeds the shared segment capacity of " + std::to_string(_n_values) };
+				}
+				double* const own = _impl_Slot(_rank);
+				std::copy(values, values + count, own);
+				Barrier();
+
+				if (_options.reduction == Reduction::Tree)
+				{
+					for (size_t stride = 1; stride < _size; stride *= 2)
+					{
+						if (_rank % (2 * stride) == 0 && _rank + stride < _size)
+						{
+							double const* const other = _impl_Slot(_rank + stride);
+							for (size_t i = 0; i < count; i++)
+							{
+								own[i] += other[i];
+							}
+						}
+						Barrier();
+					}
+					double const* const sum = _impl_Slot(0);
+					double const scale = 1.0 / static_cast<double>(_size);
+					for (size_t i = 0; i < count; i++)
+					{
+						values[i] = sum[i] * scale;
+					}
+				}
+				else
+				{
+					size_t const chunk = (count + _size - 1) / _size;
+					size_t const begin = std::min(count, _rank * chunk);
+					size_t const end = std::min(count, begin + chunk);
+					double const scale = 1.0 / static_cast<double>(_size);
+					for (size_t i = begin; i < end; i++)
+					{
+						double sum = 0.0;
+						for (size_t rank = 0; rank < _size; rank++)
+						{
+							sum += _impl_Slot(rank)[i];
+						}
+						_result[i] = sum * scale;
+					}
+					Barrier();
+					std::copy(_result, _result + count, values);
+				}
+				Barrier();
+			}
+
+			auto Report(double value) -> void
+			{
+				_reports[_rank] = value;
+			}
+		};
+
+		class Trainer
+		{
+		private:
+			Options _options;
+			size_t _n_values;
+			size_t _slot_stride;
+			size_t _bytes;
+			void* _memory;
+
+			auto _impl_Shared() const -> _impl_Header*
+			{
+				return static_cast<_impl_Header*>(_memory);
+			}
+
+			auto _impl_Slots() const -> double*
+			{
+				return reinterpret_cast<double*>(static_cast<char*>(_memory) + _impl_Align(sizeof(_impl_Header)));
+			}
+
+			auto _impl_Result() const -> double*
+			{
+				return _impl_Slots() + _options.workers * _slot_stride;
+			}
+
+			auto _impl_Reports() const -> double*
+			{
+				return _impl_Result() + _slot_stride;
+			}
+
+			auto _impl_Pin(size_t rank) const -> void
+			{
+				auto const nodes = NumaNodeCpus();
+				if (nodes.empty())
+				{
+					return;
+				}
+				auto const& cpus = nodes[rank % nodes.size()];
+				cpu_set_t set;
+				CPU_ZERO(&set);
+				for (int cpu : cpus)
+				{
+					CPU_SET(cpu, &set);
+				}
+				sched_setaffinity(0, sizeof(set), &set);
+			}
+
+		public:
+			Trainer(size_t capacity, Options options = {}) : _options{ options }, _n_values{ capacity },
+				_slot_stride{ _impl_Align(std::max<size_t>(capacity, 1) * sizeof(double)) / sizeof(double) }, _memory{ nullptr }
+			{
+				_options.workers = std::max<size_t>(_options.workers, 1);
+				_bytes = _impl_Align(sizeof(_impl_Header)) + (_options.workers + 1) * _slot_stride * sizeof(double) + _impl_Align(_options.workers * sizeof(double));
+
+				std::string const name = "/et_autodiff_" + std::to_string(getpid()) + "_" + std::to_string(reinterpret_cast<uintptr_t>(this));
+				int const fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+				if (fd < 0)
+				{
+					throw std::runtime_error{ "shm_open failed: " + std::string{ std::strerror(errno) } };
+				}
+				shm_unlink(name.c_str());
+				if (ftruncate(fd, static_cast<off_t>(_bytes)) != 0)
+				{
+					close(fd);
+					throw std::runtime_error{ "ftruncate failed: " + std::string{ std::strerror(errno) } };
+				}
+				_memory = mmap(nullptr, _bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+				close(fd);
+				if (_memory == MAP_FAILED)
+				{
+					_memory = nullptr;
+					throw std::runtime_error{ "mmap failed: " + std::string{ std::strerror(errno) } };
+				}
+				new (_memory) _impl_Header{};
+			}
+
+			Trainer(Trainer const&) = delete;
+			auto operator=(Trainer const&) -> Trainer & = delete;
+
+			~Trainer()
+			{
+				if (_memory)
+				{
+					munmap(_memory, _bytes);
+				}
+			}
+
+			// Forks one process per worker, so call it before the parent starts any threads: only the forking thread
+			// survives in the children, and a lock held by another thread at that moment stays locked for good
+			template <typename F>
+			auto Run(F&& worker) -> std::vector<WorkerStatus>
+			{
+				_impl_Shared()->arrived.store(0);
+				_impl_Shared()->aborted.store(0);
+				_impl_Shared()->departed.store(0);
+				std::fill(_impl_Reports(), _impl_Reports() + _options.workers, 0.0);
+
+				std::fflush(nullptr);
+				std::vector<WorkerStatus> statuses;
+				for (size_t rank = 0; rank < _options.workers; rank++)
+				{
+					pid_t const pid = fork();
+					if (pid == 0)
+					{
+						if (_options.numa_affinity)
+						{
+							_impl_Pin(rank);
+						}
+						std::fill(_impl_Slots() + rank * _slot_stride, _impl_Slots() + (rank + 1) * _slot_stride, 0.0);
+						WorkerContext context{ _impl_Shared(), _impl_Slots(), _impl_Result(), _impl_Reports(), rank, _n_values, _slot_stride, _options };
+						int code = 0;
+						try
+						{
+							worker(context);
+						}
+						catch (PeerLost const&)
+						{
+							code = 3;
+						}
+						catch (...)
+						{
+							code = 2;
+						}
+						std::fflush(nullptr);
+						_exit(code);
+					}
+					if (pid < 0)
+					{
+						_impl_Shared()->aborted.store(1, std::memory_order_release);
+						break;
+					}
+					statuses.push_back({ pid, false, 0, 0, 0.0 });
+				}
+
+				std::vector<bool> done(statuses.size(), false);
+				size_t remaining = statuses.size();
+				while (remaining > 0)
+				{
+					bool changed = false;
+					for (size_t rank = 0; rank < statuses.size(); rank++)
+					{
+						auto& status = statuses[rank];
+						int code = 0;
+						if (done[rank] || waitpid(status.pid, &code, WNOHANG) != status.pid)
+						{
+							continue;
+						}
+						done[rank] = true;
+						status.exited = WIFEXITED(code);
+						status.exit_code = status.exited ? WEXITSTATUS(code) : -1;
+						status.signal = WIFSIGNALED(code) ? WTERMSIG(code) : 0;
+						status.report = _impl_Reports()[rank];
+						if (!status.exited || status.exit_code != 0)
+						{
+							_impl_Shared()->aborted.store(1, std::memory_order_release);
+						}
+						_impl_Shared()->departed.fetch_add(1, std::memory_order_acq_rel);
+						_impl_Futex(&_impl_Shared()->generation, FUTEX_WAKE, INT_MAX, nullptr);
+						changed = true;
+						remaining--;
+					}
+					if (!changed)
+					{
+						usleep(1000);
+					}
+				}
+				return statuses;
+			}
+		};
+	}
+}
+
+#endif
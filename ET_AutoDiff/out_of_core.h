@@ -0,0 +1,279 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include "mapped_file.h"
+#include "tensor.h"
+#include "virtual_tensor.h"
+
+namespace TTest
+{
+	template <typename V, size_t... Ds>
+	class MappedTensor
+	{
+	public:
+		constexpr static size_t n_dims_v = sizeof...(Ds);
+		constexpr static size_t n_elems_v = total_size_v<Ds...>;
+		constexpr static size_t n_bytes_v = n_elems_v * sizeof(V);
+
+	private:
+		Et::MappedFile _file;
+
+		template <size_t D, size_t... Rest, typename T, typename... Ts>
+		constexpr static auto _impl_Offset(T index, Ts... indices) -> size_t
+		{
+			if constexpr (sizeof...(Ts) > 0)
+			{
+				return static_cast<size_t>(index) + D * _impl_Offset<Rest...>(indices...);
+			}
+			else
+			{
+				return static_cast<size_t>(index);
+			}
+		}
+
+		MappedTensor(Et::MappedFile file, std::string const& path) : _file{ std::move(file) }
+		{
+			if (_file.Size() != n_bytes_v)
+			{
+				throw std::runtime_error{ "mapped tensor file " + path + " holds " + std::to_string(_file.Size()) + " bytes, expected " + std::to_string(n_bytes_v) };
+			}
+			_file.Advise(0, n_bytes_v, Et::Access::Sequential);
+		}
+
+	public:
+		static auto Create(std::string const& path) -> MappedTensor
+		{
+			return MappedTensor{ Et::MappedFile{ path, n_bytes_v }, path };
+		}
+
+		static auto Open(std::string const& path) -> MappedTensor
+		{
+			return MappedTensor{ Et::MappedFile{ path, Et::Access::Sequential }, path };
+		}
+
+		template <typename... Is>
+		auto operator()(Is... indices) -> V&
+		{
+			static_assert(sizeof...(Is) == n_dims_v);
+			return cbegin()[_impl_Offset<Ds...>(indices...)];
+		}
+
+		template <typename... Is>
+		auto operator()(Is... indices) const -> V const&
+		{
+			static_assert(sizeof...(Is) == n_dims_v);
+			return cbegin()[_impl_Offset<Ds...>(indices...)];
+		}
+
+		auto cbegin() -> V*
+		{
+			return reinterpret_cast<V*>(_file.MutableData());
+		}
+
+		auto cend() -> V*
+		{
+			return cbegin() + n_elems_v;
+		}
+
+		auto cbegin() const -> V const*
+		{
+			return reinterpret_cast<V const*>(_file.Data());
+		}
+
+		auto cend() const -> V const*
+		{
+			return cbegin() + n_elems_v;
+		}
+
+		auto Advise(size_t first, size_t count, Et::Access access) const -> void
+		{
+			_file.Advise(first * sizeof(V), count * sizeof(V), access);
+		}
+
+		auto Flush(size_t first, size_t count, bool wait = false) const -> void
+		{
+			_file.Flush(first * sizeof(V), count * sizeof(V), wait);
+		}
+	};
+
+	struct StreamOptions
+	{
+		size_t tile_bytes = size_t{ 4 } << 20;
+		size_t prefetch_tiles = 2;
+		size_t memory_bytes = size_t{ 256 } << 20;
+	};
+
+	struct StreamStats
+	{
+		size_t tiles;
+		size_t bytes;
+		double seconds;
+		size_t matmul_passes;
+	};
+
+	class TileStream
+	{
+	private:
+		StreamOptions _options;
+		StreamStats _stats;
+
+		template <typename T>
+		auto _impl_Prefetch(T const& tensor, size_t first, size_t tile, size_t end) const -> void
+		{
+			if constexpr (!is_virtual_tensor_v<T>)
+			{
+				size_t const begin = std::min(end, first + tile);
+				tensor.Advise(begin, std::min(end, begin + _options.prefetch_tiles * tile) - begin, Et::Access::WillNeed);
+			}
+		}
+
+		template <typename T>
+		auto _impl_Release(T const& tensor, size_t first, size_t count) const -> void
+		{
+			if constexpr (!is_virtual_tensor_v<T>)
+			{
+				tensor.Advise(first, count, Et::Access::DontNeed);
+			}
+		}
+
+		template <typename T>
+		auto _impl_Retire(T& tensor, size_t first, size_t count) const -> void
+		{
+			tensor.Flush(first, count);
+			tensor.Advise(first, count, Et::Access::DontNeed);
+		}
+
+		template <typename F>
+		auto _impl_Timed(size_t bytes, F&& body)
+		{
+			auto const begin = std::chrono::steady_clock::now();
+			auto finish = [&]()
+			{
+				_stats.bytes += bytes;
+				_stats.seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			};
+			if constexpr (std::is_void_v<decltype(body())>)
+			{
+				body();
+				finish();
+			}
+			else
+			{
+				auto result = body();
+				finish();
+				return result;
+			}
+		}
+
+	public:
+		TileStream(StreamOptions options = {}) : _options{ options }, _stats{ 0, 0, 0.0, 0 } {}
+
+		auto Stats() const -> StreamStats const&
+		{
+			return _stats;
+		}
+
+		template <typename F, typename R, typename... Ts>
+		auto Transform(R& result, F&& function, Ts const&... inputs) -> void
+		{
+			using value_t = std::decay_t<decltype(*result.cbegin())>;
+			constexpr size_t n_elems = std::decay_t<R>::n_elems_v;
+			static_assert(((std::decay_t<Ts>::n_elems_v == n_elems) && ...), "tiled transform needs tensors of equal size");
+			constexpr size_t widest = std::max({ sizeof(value_t), sizeof(*inputs.cbegin())... });
+			size_t const tile = std::max<size_t>(_options.tile_bytes / widest, 1);
+
+			_impl_Timed((sizeof(value_t) + ... + (is_virtual_tensor_v<Ts> ? 0 : sizeof(*inputs.cbegin()))) * n_elems, [&]()
+			{
+				for (size_t first = 0; first < n_elems; first += tile)
+				{
+					size_t const count = std::min(tile, n_elems - first);
+					(_impl_Prefetch(inputs, first, tile, n_elems), ...);
+					value_t* out = result.cbegin() + first;
+					for (size_t i = 0; i < count; i++)
+					{
+						out[i] = function(inputs.cbegin()[first + i]...);
+					}
+					(_impl_Release(inputs, first, count), ...);
+					_impl_Retire(result, first, count);
+					_stats.tiles++;
+				}
+			});
+		}
+
+		template <typename T>
+		auto Sum(T const& tensor)
+		{
+			using value_t = std::decay_t<decltype(*tensor.cbegin())>;
+			constexpr size_t n_elems = std::decay_t<T>::n_elems_v;
+			size_t const tile = std::max<size_t>(_options.tile_bytes / sizeof(value_t), 1);
+
+			return _impl_Timed(sizeof(value_t) * n_elems, [&]()
+			{
+				value_t total{ 0 };
+				for (size_t first = 0; first < n_elems; first += tile)
+				{
+					size_t const count = std::min(tile, n_elems - first);
+					_impl_Prefetch(tensor, first, tile, n_elems);
+					value_t partial{ 0 };
+					for (value_t const* it = tensor.cbegin() + first; it != tensor.cbegin() + first + count; it++)
+					{
+						partial += *it;
+					}
+					total += partial;
+					_impl_Release(tensor, first, count);
+					_stats.tiles++;
+				}
+				return total;
+			});
+		}
+
+		template <typename V1, typename V2, typename V3, size_t M, size_t K, size_t N>
+		auto Matmul(MappedTensor<V1, M, K> const& first, MappedTensor<V2, K, N> const& second, MappedTensor<V3, M, N>& result) -> void
+		{
+			size_t const panel_columns = std::max<size_t>(_options.tile_bytes / (sizeof(V1) * M), 1);
+			size_t const panel_bytes = sizeof(V1) * M * panel_columns * (1 + _options.prefetch_tiles);
+			size_t const block_bytes = _options.memory_bytes > panel_bytes ? _options.memory_bytes - panel_bytes : 0;
+			size_t const result_columns = std::min(N, std::max<size_t>(block_bytes / (sizeof(V3) * M + sizeof(V2) * K), 1));
+			size_t const passes = (N + result_columns - 1) / result_columns;
+			_stats.matmul_passes += passes;
+
+			_impl_Timed(sizeof(V1) * M * K * passes + sizeof(V2) * K * N + sizeof(V3) * M * N, [&]()
+			{
+				V1 const* a = first.cbegin();
+				V2 const* b = second.cbegin();
+				for (size_t j0 = 0; j0 < N; j0 += result_columns)
+				{
+					size_t const j1 = std::min(N, j0 + result_columns);
+					V3* c = result.cbegin();
+					std::fill(c + j0 * M, c + j1 * M, V3{ 0 });
+					for (size_t p0 = 0; p0 < K; p0 += panel_columns)
+					{
+						size_t const p1 = std::min(K, p0 + panel_columns);
+						_impl_Prefetch(first, p0 * M, (p1 - p0) * M, M * K);
+						for (size_t j = j0; j < j1; j++)
+						{
+							V3* c_column = c + j * M;
+							for (size_t p = p0; p < p1; p++)
+							{
+								V1 const* a_column = a + p * M;
+								V3 const factor = b[p + j * K];
+								for (size_t i = 0; i < M; i++)
+								{
+									c_column[i] += a_column[i] * factor;
+								}
+							}
+						}
+						_impl_Release(first, p0 * M, (p1 - p0) * M);
+						_stats.tiles++;
+					}
+					_impl_Retire(result, j0 * M, (j1 - j0) * M);
+				}
+			});
+		}
+	};
+}
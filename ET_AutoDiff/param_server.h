@@ -0,0 +1,698 @@
+#pragma once
+
+#if defined(__unix__) || defined(__APPLE__)
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "variable_binding.h"
+
+namespace Et {
+
+	namespace ParamServer {
+
+		enum class MessageType : uint16_t { Pull = 1, Parameters, Push, Ack, Shutdown };
+
+		enum class Compression : uint16_t { None, Fp16, TopK };
+
+		struct FrameHeader
+		{
+			uint32_t magic;
+			uint16_t type;
+			uint16_t compression;
+			uint64_t version;
+			uint32_t count;
+			uint32_t bytes;
+		};
+
+		constexpr uint32_t frame_magic_v = 0x50535445;
+
+		struct ServerOptions
+		{
+			double learning_rate = 0.01;
+			uint64_t max_staleness = UINT64_MAX;
+			size_t expected_workers = 0;
+		};
+
+		struct ServerStats
+		{
+			uint64_t pulls;
+			uint64_t pushes;
+			uint64_t rejected;
+			uint64_t bytes_received;
+		};
+
+		struct ClientOptions
+		{
+			Compression compression = Compression::None;
+			size_t top_k = 0;
+			size_t push_batch = 1;
+		};
+
+		struct TopKEntry
+		{
+			uint32_t index;
+			float value;
+		};
+
+		inline auto ToHalf(float value) -> uint16_t
+		{
+			uint32_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			uint16_t const sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+			uint32_t const raw_exponent = (bits >> 23) & 0xff;
+			uint32_t mantissa = bits & 0x7fffff;
+			if (raw_exponent == 0xff)
+			{
+				return sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0);
+			}
+			int const exponent = static_cast<int>(raw_exponent) - 127 + 15;
+			if (exponent >= 31)
+			{
+				return sign | 0x7c00;
+			}
+			if (exponent <= 0)
+			{
+				if (exponent < -10)
+				{
+					return sign;
+				}
+				mantissa |= 0x800000;
+				int const shift = 14 - exponent;
+				uint32_t half = mantissa >> shift;
+				half += (mantissa >> (shift - 1)) & 1;
+				return sign | static_cast<uint16_t>(half);
+			}
+			uint32_t const half = (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+			return sign | static_cast<uint16_t>(half + ((mantissa >> 12) & 1));
+		}
+
+		inline auto FromHalf(uint16_t half) -> float
+		{
+			uint32_t const sign = static_cast<uint32_t>(half & 0x8000) << 16;
+			uint32_t exponent = (half >> 10) & 0x1f;
+			uint32_t mantissa = half & 0x3ff;
+			uint32_t bits;
+			if (exponent == 0x1f)
+			{
+				bits = sign | 0x7f800000 | (mantissa << 13);
+			}
+			else if (exponent == 0)
+			{
+				if (mantissa == 0)
+				{
+					bits = sign;
+				}
+				else
+				{
+					exponent = 1;
+					while ((mantissa & 0x400) == 0)
+					{
+						mantissa <<= 1;
+						exponent--;
+					}
+					bits = sign | ((exponent + 127 - 15) << 23) | ((mantissa & 0x3ff) << 13);
+				}
+			}
+			else
+			{
+				bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+			}
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+
+#if defined(MSG_NOSIGNAL)
+		constexpr int send_flags_v = MSG_NOSIGNAL;
+#else
+		constexpr int send_flags_v = 0;
+#endif
+
+		inline auto _impl_NoSigPipe([[maybe_unused]] int fd) -> void
+		{
+#if defined(SO_NOSIGPIPE)
+			int const enable = 1;
+			setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+		}
+
+		inline auto _impl_WriteFrame(int fd, FrameHeader const& header, void const* payload) -> bool
+		{
+			iovec parts[2] = { { const_cast<FrameHeader*>(&header), sizeof(header) }, { const_cast<void*>(payload), header.bytes } };
+			int n_parts = header.bytes > 0 ? 2 : 1;
+			iovec* part = parts;
+			while (n_parts > 0)
+			{
+				msghdr message{};
+				message.msg_iov = part;
+				message.msg_iovlen = n_parts;
+				ssize_t const written = sendmsg(fd, &message, send_flags_v);
+				if (written < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					if (errno == EPIPE || errno == ECONNRESET)
+					{
+						return false;
+					}
+					throw std::runtime_error{ "parameter server write failed: " + std::string{ std::strerror(errno) } };
+				}
+				size_t remaining = static_cast<size_t>(written);
+				while (n_parts > 0 && remaining >= part->iov_len)
+				{
+					remaining -= part->iov_len;
+					part++;
+					n_parts--;
+				}
+				if (n_parts > 0)
+				{
+					part->iov_base = static_cast<char*>(part->iov_base) + remaining;
+					part->iov_len -= remaining;
+				}
+			}
+			return true;
+		}
+
+		inline auto _impl_ReadAll(int fd, void* data, size_t size) -> bool
+		{
+			char* cursor = static_cast<char*>(data);
+			while (size > 0)
+			{
+				ssize_t const received = read(fd, cursor, size);
+				if (received == 0)
+				{
+					return false;
+				}
+				if (received < 0)
+				{
+					if (errno == EINTR)
+					{
+						continue;
+					}
+					return false;
+				}
+				cursor += received;
+				size -= static_cast<size_t>(received);
+			}
+			return true;
+		}
+
+
+		inline auto _impl_Address(std::string const& path) -> sockaddr_un
+		{
+			sockaddr_un address{};
+			address.sun_family = AF_UNIX;
+			if (path.size() >= sizeof(address.sun_path))
+			{
+				throw std::invalid_argument{ "socket path too long: " + path };
+			}
+			std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+			return address;
+		}
+
+		using Binding = VariableBinding;
+
+		class Server
+		{
+		private:
+			struct _impl_Connection
+			{
+				int fd;
+				std::vector<char> inbox;
+				size_t received;
+				std::vector<char> outbox;
+				size_t sent;
+			};
+
+			std::string _path;
+			std::vector<double> _parameters;
+			ServerOptions _options;
+			uint64_t _version;
+			int _listener;
+			std::vector<double> _dense;
+
+			constexpr static size_t receive_chunk_v = size_t{ 1 } << 16;
+
+			auto _impl_Decode(FrameHeader const& header, char const* payload) -> bool
+			{
+				size_t const n = _parameters.size();
+				std::fill(_dense.begin(), _dense.end(), 0.0);
+				switch (static_cast<Compression>(header.compression))
+				{
+				case Compression::None:
+					if (header.count != n || header.bytes != n * sizeof(double)) return false;
+					std::memcpy(_dense.data(), payload, header.bytes);
+					return true;
+				case Compression::Fp16:
+					if (header.count != n || header.bytes != n * sizeof(uint16_t)) return false;
+					for (size_t i = 0; i < n; i++)
+					{
+						uint16_t half;
+						std::memcpy(&half, payload + i * sizeof(half), sizeof(half));
+						_dense[i] = FromHalf(half);
+					}
+					return true;
+				case Compression::TopK:
+					if (header.bytes != header.count * sizeof(TopKEntry)) return false;
+					for (size_t i = 0; i < header.count; i++)
+					{
+						TopKEntry entry;
+						std::memcpy(&entry, payload + i * sizeof(entry), sizeof(entry));
+						if (entry.index >= n) return false;
+						_dense[entry.index] += entry.value;
+					}
+					return true;
+				}
+				return false;
+			}
+
+			// Sockets are non-blocking: whatever the peer's socket buffer does not take now is kept in its outbox
+			static auto _impl_Reply(_impl_Connection& connection, FrameHeader const& header, void const* payload) -> bool
+			{
+				size_t written = 0;
+				if (connection.sent == connection.outbox.size())
+				{
+					iovec parts[2] = { { const_cast<FrameHeader*>(&header), sizeof(header) }, { const_cast<void*>(payload), header.bytes } };
+					msghdr message{};
+					message.msg_iov = parts;
+					message.msg_iovlen = header.bytes > 0 ? 2 : 1;
+					ssize_t result;
+					do
+					{
+						result = sendmsg(connection.fd, &message, send_flags_v);
+					} while (result < 0 && errno == EINTR);
+					if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+					{
+						return false;
+					}
+					written = static_cast<size_t>(std::max<ssize_t>(result, 0));
+				}
+				char const* const head = reinterpret_cast<char const*>(&header);
+				if (written < sizeof(header))
+				{
+					connection.outbox.insert(connection.outbox.end(), head + written, head + sizeof(header));
+					written = sizeof(header);
+				}
+				if (written - sizeof(header) < header.bytes)
+				{
+					char const* const body = static_cast<char const*>(payload);
+					connection.outbox.insert(connection.outbox.end(), body + (written - sizeof(header)), body + header.bytes);
+				}
+				return true;
+			}
+
+			static auto _impl_Flush(_impl_Connection& connection) -> bool
+			{
+				while (connection.sent < connection.outbox.size())
+				{
+					ssize_t const written = send(connection.fd, connection.outbox.data() + connection.sent, connection.outbox.size() - connection.sent, send_flags_v);
+					if (written < 0)
+					{
+						if (errno == EINTR)
+						{
+							continue;
+						}
+						return errno == EAGAIN || errno == EWOULDBLOCK;
+					}
+					connection.sent += static_cast<size_t>(written);
+				}
+				connection.outbox.clear();
+				connection.sent = 0;
+				return true;
+			}
+
+			auto _impl_Handle(_impl_Connection& connection, FrameHeader const& header, char const* payload, ServerStats& stats, bool& shutdown) -> bool
+			{
+				stats.bytes_received += sizeof(header) + header.bytes;
+				switch (static_cast<MessageType>(header.type))
+				{
+				case MessageType::Pull:
+				{
+					stats.pulls++;
+					FrameHeader const reply{ frame_magic_v, static_cast<uint16_t>(MessageType::Parameters), 0, _version,
+						static_cast<uint32_t>(_parameters.size()), static_cast<uint32_t>(_parameters.size() * sizeof(double)) };
+					return _impl_Reply(connection, reply, _parameters.data());
+				}
+				case MessageType::Push:
+				{
+					bool const fresh = _version - std::min(header.version, _version) <= _options.max_staleness;
+					bool const accepted = fresh && _impl_Decode(header, payload);
+					if (accepted)
+					{
+						for (size_t i = 0; i < _parameters.size(); i++)
+						{
+							_parameters[i] -= _options.learning_rate * _dense[i];
+						}
+						_version++;
+						stats.pushes++;
+					}
+					else
+					{
+						stats.rejected++;
+					}
+					FrameHeader const reply{ frame_magic_v, static_cast<uint16_t>(MessageType::Ack), accepted ? uint16_t{ 1 } : uint16_t{ 0 }, _version, 0, 0 };
+					return _impl_Reply(connection, reply, nullptr);
+				}
+				case MessageType::Shutdown:
+					shutdown = true;
+					return true;
+				default:
+					return true;
+				}
+			}
+
+			// Handles buffered frames until the replies a peer has not read yet reach receive_chunk_v, so a peer
+			// that pushes without reading its Acks stalls only itself and the outbox stays bounded
+			auto _impl_Process(_impl_Connection& connection, ServerStats& stats, bool& shutdown) -> bool
+			{
+				size_t const max_bytes = _parameters.size() * sizeof(double);
+				size_t consumed = 0;
+				FrameHeader header;
+				while (connection.received - consumed >= sizeof(header))
+				{
+					if (connection.outbox.size() - connection.sent >= receive_chunk_v)
+					{
+						if (!_impl_Flush(connection))
+						{
+							return false;
+						}
+						if (!connection.outbox.empty())
+						{
+							break;
+						}
+					}
+					std::memcpy(&header, connection.inbox.data() + consumed, sizeof(header));
+					if (header.magic != frame_magic_v || header.bytes > max_bytes)
+					{
+						return false;
+					}
+					if (connection.received - consumed - sizeof(header) < header.bytes)
+					{
+						break;
+					}
+					char const* const body = connection.inbox.data() + consumed + sizeof(header);
+					consumed += sizeof(header) + header.bytes;
+					if (!_impl_Handle(connection, header, body, stats, shutdown))
+					{
+						return false;
+					}
+				}
+				std::copy(connection.inbox.begin() + static_cast<std::ptrdiff_t>(consumed), connection.inbox.begin() + static_cast<std::ptrdiff_t>(connection.received), connection.inbox.begin());
+				connection.received -= consumed;
+				return _impl_Flush(connection);
+			}
+
+			auto _impl_Receive(_impl_Connection& connection, ServerStats& stats, bool& shutdown) -> bool
+			{
+				ssize_t const received = read(connection.fd, connection.inbox.data() + connection.received, connection.inbox.size() - connection.received);
+				if (received < 0)
+				{
+					return errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK;
+				}
+				if (received == 0)
+				{
+					return false;
+				}
+				connection.received += static_cast<size_t>(received);
+				return _impl_Process(connection, stats, shutdown);
+			}
+
+		public:
+			Server(std::string path, std::vector<double> parameters, ServerOptions options = {})
+				: _path{ std::move(path) }, _parameters{ std::move(parameters) }, _options{ options }, _version{ 0 }, _listener{ -1 }, _dense(_parameters.size())
+			{
+				sockaddr_un const address = _impl_Address(_path);
+				unlink(_path.c_str());
+				_listener = socket(AF_UNIX, SOCK_STREAM, 0);
+				if (_listener < 0 || bind(_listener, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0 || listen(_listener, 64) != 0)
+				{
+					std::string const error = std::strerror(errno);
+					if (_listener >= 0)
+					{
+						close(_listener);
+					}
+					throw std::runtime_error{ "cannot listen on " + _path + ": " + error };
+				}
+			}
+
+			Server(Server const&) = delete;
+			auto operator=(Server const&) -> Server & = delete;
+
+			~Server()
+			{
+				if (_listener >= 0)
+				{
+					close(_listener);
+					unlink(_path.c_str());
+				}
+			}
+
+			auto Parameters() const -> std::vector<double> const&
+			{
+				return _parameters;
+			}
+
+			auto Version() const -> uint64_t
+			{
+				return _version;
+			}
+
+			auto Serve() -> ServerStats
+			{
+				ServerStats stats{ 0, 0, 0, 0 };
+				std::vector<pollfd> fds{ { _listener, POLLIN, 0 } };
+				std::vector<_impl_Connection> connections(1);
+				size_t const inbox_bytes = std::max(receive_chunk_v, sizeof(FrameHeader) + _parameters.size() * sizeof(double));
+				bool shutdown = false;
+				size_t served = 0;
+
+				while (!shutdown && !(_options.expected_workers > 0 && served >= _options.expected_workers && fds.size() == 1))
+				{
+					if (poll(fds.data(), static_cast<nfds_t>(fds.size()), -1) < 0)
+					{
+						if (errno == EINTR)
+						{
+							continue;
+						}
+						throw std::runtime_error{ "poll failed: " + std::string{ std::strerror(errno) } };
+					}
+					for (size_t i = fds.size(); i-- > 1;)
+					{
+						short const events = fds[i].revents;
+						if (events == 0)
+						{
+							continue;
+						}
+						auto& connection = connections[i];
+						bool open = (events & (POLLERR | POLLNVAL)) == 0;
+						if (open && (events & POLLOUT) != 0)
+						{
+							open = _impl_Flush(connection) && (!connection.outbox.empty() || _impl_Process(connection, stats, shutdown));
+						}
+						else if (open && (events & POLLIN) != 0)
+						{
+							open = _impl_Receive(connection, stats, shutdown);
+						}
+						else
+						{
+							open = false;
+						}
+						if (open)
+						{
+							fds[i].events = connection.outbox.empty() ? POLLIN : POLLOUT;
+							continue;
+						}
+						close(fds[i].fd);
+						fds.erase(fds.begin() + static_cast<std::ptrdiff_t>(i));
+						connections.erase(connections.begin() + static_cast<std::ptrdiff_t>(i));
+					}
+					if ((fds[0].revents & POLLIN) != 0)
+					{
+						int const client = accept(_listener, nullptr, nullptr);
+						if (client >= 0)
+						{
+							_impl_NoSigPipe(client);
+							fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+							fds.push_back({ client, POLLIN, 0 });
+							connections.push_back({ client, std::vector<char>(inbox_bytes), 0, {}, 0 });
+							served++;
+						}
+					}
+				}
+				for (size_t i = 1; i < fds.size(); i++)
+				{
+					close(fds[i].fd);
+				}
+				return stats;
+			}
+		};
+
+		class Client
+		{
+		private:
+			int _fd;
+			ClientOptions _options;
+			std::vector<double> _batch;
+			std::vector<double> _residual;
+			std::vector<char> _encoded;
+			std::vector<uint32_t> _order;
+			size_t _batched;
+			uint64_t _batch_version;
+			uint64_t _bytes_sent;
+
+			auto _impl_Send(double const* gradients, size_t count, uint64_t version) -> bool
+			{
+				FrameHeader header{ frame_magic_v, static_cast<uint16_t>(MessageType::Push), static_cast<uint16_t>(_options.compression), version, static_cast<uint32_t>(count), 0 };
+				void const* payload = gradients;
+				if (_options.compression == Compression::None)
+				{
+					header.bytes = static_cast<uint32_t>(count * sizeof(double));
+				}
+				else if (_options.compression == Compression::Fp16)
+				{
+					_encoded.resize(count * sizeof(uint16_t));
+					for (size_t i = 0; i < count; i++)
+					{
+						uint16_t const half = ToHalf(static_cast<float>(gradients[i]));
+						std::memcpy(_encoded.data() + i * sizeof(half), &half, sizeof(half));
+					}
+					header.bytes = static_cast<uint32_t>(_encoded.size());
+					payload = _encoded.data();
+				}
+				else
+				{
+					_residual.resize(count, 0.0);
+					for (size_t i = 0; i < count; i++)
+					{
+						_residual[i] += gradients[i];
+					}
+					size_t const k = std::min(count, std::max<size_t>(_options.top_k, 1));
+					_order.resize(count);
+					std::iota(_order.begin(), _order.end(), 0u);
+					std::nth_element(_order.begin(), _order.begin() + static_cast<std::ptrdiff_t>(k - 1), _order.end(),
+						[this](uint32_t a, uint32_t b) { return std::abs(_residual[a]) > std::abs(_residual[b]); });
+					_encoded.resize(k * sizeof(TopKEntry));
+					for (size_t i = 0; i < k; i++)
+					{
+						TopKEntry const entry{ _order[i], static_cast<float>(_residual[_order[i]]) };
+						_residual[_order[i]] -= entry.value;
+						std::memcpy(_encoded.data() + i * sizeof(entry), &entry, sizeof(entry));
+					}
+					header.count = static_cast<uint32_t>(k);
+					header.bytes = static_cast<uint32_t>(_encoded.size());
+					payload = _encoded.data();
+				}
+
+				_bytes_sent += sizeof(header) + header.bytes;
+				FrameHeader reply;
+				if (!_impl_WriteFrame(_fd, header, payload) || !_impl_ReadAll(_fd, &reply, sizeof(reply)) || reply.magic != frame_magic_v
+					|| reply.type != static_cast<uint16_t>(MessageType::Ack))
+				{
+					throw std::runtime_error{ "parameter server closed the connection" };
+				}
+				return reply.compression != 0;
+			}
+
+		public:
+			Client(std::string const& path, ClientOptions options = {}) : _fd{ socket(AF_UNIX, SOCK_STREAM, 0) }, _options{ options },
+				_batched{ 0 }, _batch_version{ 0 }, _bytes_sent{ 0 }
+			{
+				sockaddr_un const address = _impl_Address(path);
+				if (_fd < 0 || connect(_fd, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0)
+				{
+					std::string const error = std::strerror(errno);
+					if (_fd >= 0)
+					{
+						close(_fd);
+					}
+					throw std::runtime_error{ "cannot connect to " + path + ": " + error };
+				}
+				_impl_NoSigPipe(_fd);
+			}
+
+			Client(Client const&) = delete;
+			auto operator=(Client const&) -> Client & = delete;
+
+			~Client()
+			{
+				close(_fd);
+			}
+
+			auto Pull(double* parameters, size_t count) -> uint64_t
+			{
+				FrameHeader const request{ frame_magic_v, static_cast<uint16_t>(MessageType::Pull), 0, 0, 0, 0 };
+				if (!_impl_WriteFrame(_fd, request, nullptr))
+				{
+					throw std::runtime_error{ "parameter server closed the connection" };
+				}
+				FrameHeader reply;
+				if (!_impl_ReadAll(_fd, &reply, sizeof(reply)) || reply.magic != frame_magic_v || reply.type != static_cast<uint16_t>(MessageType::Parameters) || reply.count != count
+					|| reply.bytes != count * sizeof(double))
+				{
+					throw std::runtime_error{ "unexpected reply to parameter pull" };
+				}
+				if (!_impl_ReadAll(_fd, parameters, reply.bytes))
+				{
+					throw std::runtime_error{ "parameter server closed the connection" };
+				}
+				return reply.version;
+			}
+
+			auto Push(double const* gradients, size_t count, uint64_t version) -> bool
+			{
+				if (_options.push_batch <= 1)
+				{
+					return _impl_Send(gradients, count, version);
+				}
+				if (_batched == 0)
+				{
+					_batch.assign(count, 0.0);
+					_batch_version = version;
+				}
+				for (size_t i = 0; i < count; i++)
+				{
+					_batch[i] += gradients[i];
+				}
+				return ++_batched < _options.push_batch || Flush();
+			}
+
+			auto Flush() -> bool
+			{
+				if (_batched == 0)
+				{
+					return true;
+				}
+				_batched = 0;
+				return _impl_Send(_batch.data(), _batch.size(), _batch_version);
+			}
+
+			auto Shutdown() -> void
+			{
+				FrameHeader const request{ frame_magic_v, static_cast<uint16_t>(MessageType::Shutdown), 0, 0, 0, 0 };
+				_impl_WriteFrame(_fd, request, nullptr);
+			}
+
+			auto BytesSent() const -> uint64_t
+			{
+				return _bytes_sent;
+			}
+		};
+	}
+}
+
+#endif
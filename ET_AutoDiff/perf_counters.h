@@ -0,0 +1,390 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+#if defined(ET_PERF_COUNTERS)
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace Et {
+
+	namespace Perf {
+
+		enum Counter : size_t
+		{
+			Cycles,
+			Instructions,
+			Branches,
+			BranchMisses,
+			L1DAccesses,
+			L1DMisses,
+			LLCAccesses,
+			LLCMisses,
+			CounterCount
+		};
+
+		struct Sample
+		{
+			std::array<uint64_t, CounterCount> counters{};
+			std::array<bool, CounterCount> valid{};
+			uint64_t nanoseconds = 0;
+		};
+
+		class CounterSet
+		{
+		private:
+			constexpr static size_t group_size_v = 4;
+
+			std::array<int, CounterCount> _descriptors;
+
+#if defined(__linux__)
+			static auto _impl_Open(uint32_t type, uint64_t config, int group) -> int
+			{
+				perf_event_attr attributes;
+				std::memset(&attributes, 0, sizeof(attributes));
+				attributes.size = sizeof(attributes);
+				attributes.type = type;
+				attributes.config = config;
+				attributes.disabled = group < 0 ? 1 : 0;
+				attributes.exclude_kernel = 1;
+				attributes.exclude_hv = 1;
+				attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+				return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, group, 0));
+			}
+
+			static constexpr auto _impl_CacheConfig(uint64_t cache, uint64_t result) -> uint64_t
+			{
+				return cache | (uint64_t{ PERF_COUNT_HW_CACHE_OP_READ } << 8) | (result << 16);
+			}
+#endif
+
+		public:
+			CounterSet()
+			{
+				_descriptors.fill(-1);
+#if defined(__linux__)
+				std::array<std::pair<uint32_t, uint64_t>, CounterCount> const events{ {
+					{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+					{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+					{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS },
+					{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+					{ PERF_TYPE_HW_CACHE, _impl_CacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_ACCESS) },
+					{ PERF_TYPE_HW_CACHE, _impl_CacheConfig(PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+					{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES },
+					{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES } } };
+
+				for (size_t leader = 0; leader < CounterCount; leader += group_size_v)
+				{
+					int const group = _impl_Open(events[leader].first, events[leader].second, -1);
+					if (group < 0)
+					{
+						continue;
+					}
+					_descriptors[leader] = group;
+					for (size_t i = leader + 1; i < leader + group_size_v; i++)
+					{
+						_descriptors[i] = _impl_Open(events[i].first, events[i].second, group);
+					}
+					ioctl(group, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+					ioctl(group, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+				}
+#endif
+			}
+
+			CounterSet(CounterSet const&) = delete;
+			auto operator=(CounterSet const&) -> CounterSet & = delete;
+
+			~CounterSet()
+			{
+#if defined(__linux__)
+				for (int descriptor : _descriptors)
+				{
+					if (descriptor >= 0)
+					{
+						close(descriptor);
+					}
+				}
+#endif
+			}
+
+			auto Hardware() const -> bool
+			{
+				return _descriptors[Cycles] >= 0;
+			}
+
+			auto Read() const -> Sample
+			{
+				Sample sample;
+#if defined(__linux__)
+				for (size_t leader = 0; leader < CounterCount; leader += group_size_v)
+				{
+					if (_descriptors[leader] < 0)
+					{
+						continue;
+					}
+					uint64_t buffer[3 + group_size_v] = {};
+					if (read(_descriptors[leader], buffer, sizeof(buffer)) <= 0 || buffer[2] == 0)
+					{
+						continue;
+					}
+					double const scale = static_cast<double>(buffer[1]) / static_cast<double>(buffer[2]);
+					size_t slot = 0;
+					for (size_t i = leader; i < leader + group_size_v && slot < buffer[0]; i++)
+					{
+						if (_descriptors[i] >= 0)
+						{
+							sample.counters[i] = static_cast<uint64_t>(static_cast<double>(buffer[3 + slot++]) * scale);
+							sample.valid[i] = true;
+						}
+					}
+				}
+#endif
+				sample.nanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+					std::chrono::steady_clock::now().time_since_epoch()).count());
+				return sample;
+			}
+
+			static auto Local() -> CounterSet&
+			{
+				thread_local CounterSet counters;
+				return counters;
+			}
+		};
+
+		struct RegionStats
+		{
+			uint64_t calls = 0;
+			uint64_t bytes = 0;
+			Sample total;
+		};
+
+		class ThreadRegion
+		{
+		private:
+			std::atomic<uint64_t> _calls;
+			std::atomic<uint64_t> _bytes;
+			std::atomic<uint64_t> _nanoseconds;
+			std::array<std::atomic<uint64_t>, CounterCount> _counters;
+			std::array<std::atomic<bool>, CounterCount> _valid;
+
+			static auto _impl_Bump(std::atomic<uint64_t>& value, uint64_t amount) -> void
+			{
+				value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+			}
+
+		public:
+			ThreadRegion()
+			{
+				Reset();
+			}
+
+			auto Record(uint64_t bytes, Sample const& begin, Sample const& end) -> void
+			{
+				_impl_Bump(_calls, 1);
+				_impl_Bump(_bytes, bytes);
+				_impl_Bump(_nanoseconds, end.nanoseconds - begin.nanoseconds);
+				for (size_t i = 0; i < CounterCount; i++)
+				{
+					bool const valid = begin.valid[i] && end.valid[i];
+					if (!valid)
+					{
+						_valid[i].store(false, std::memory_order_relaxed);
+					}
+					_impl_Bump(_counters[i], valid && end.counters[i] > begin.counters[i] ? end.counters[i] - begin.counters[i] : 0);
+				}
+			}
+
+			auto MergeInto(RegionStats& stats) const -> void
+			{
+				stats.calls += _calls.load(std::memory_order_relaxed);
+				stats.bytes += _bytes.load(std::memory_order_relaxed);
+				stats.total.nanoseconds += _nanoseconds.load(std::memory_order_relaxed);
+				for (size_t i = 0; i < CounterCount; i++)
+				{
+					stats.total.counters[i] += _counters[i].load(std::memory_order_relaxed);
+					stats.total.valid[i] = stats.total.valid[i] && _valid[i].load(std::memory_order_relaxed);
+				}
+			}
+
+			auto Reset() -> void
+			{
+				_calls.store(0, std::memory_order_relaxed);
+				_bytes.store(0, std::memory_order_relaxed);
+				_nanoseconds.store(0, std::memory_order_relaxed);
+				for (size_t i = 0; i < CounterCount; i++)
+				{
+					_counters[i].store(0, std::memory_order_relaxed);
+					_valid[i].store(true, std::memory_order_relaxed);
+				}
+			}
+		};
+
+		class Regions
+		{
+		private:
+			std::mutex _mutex;
+			std::map<std::string, std::vector<std::unique_ptr<ThreadRegion>>> _regions;
+
+		public:
+			static auto Instance() -> Regions&
+			{
+				static Regions regions;
+				return regions;
+			}
+
+			auto Register(char const* name) -> ThreadRegion&
+			{
+				std::lock_guard<std::mutex> lock{ _mutex };
+				auto& threads = _regions[name];
+				threads.push_back(std::make_unique<ThreadRegion>());
+				return *threads.back();
+			}
+
+			auto Snapshot() -> std::vector<std::pair<std::string, RegionStats>>
+			{
+				std::lock_guard<std::mutex> lock{ _mutex };
+				std::vector<std::pair<std::string, RegionStats>> regions;
+				for (auto const& [name, threads] : _regions)
+				{
+					RegionStats stats;
+					stats.total.valid.fill(true);
+					for (auto const& thread : threads)
+					{
+						thread->MergeInto(stats);
+					}
+					regions.emplace_back(name, stats);
+				}
+				return regions;
+			}
+
+			auto Reset() -> void
+			{
+				std::lock_guard<std::mutex> lock{ _mutex };
+				for (auto& region : _regions)
+				{
+					for (auto& thread : region.second)
+					{
+						thread->Reset();
+					}
+				}
+			}
+		};
+
+		inline auto Region(char const* name) -> ThreadRegion&
+		{
+			thread_local std::unordered_map<char const*, ThreadRegion*> regions;
+			auto& region = regions[name];
+			if (region == nullptr)
+			{
+				region = &Regions::Instance().Register(name);
+			}
+			return *region;
+		}
+
+		class Scope
+		{
+		private:
+			ThreadRegion& _region;
+			uint64_t _bytes;
+			Sample _begin;
+
+		public:
+			Scope(char const* name, uint64_t bytes) : _region{ Region(name) }, _bytes{ bytes }, _begin{ CounterSet::Local().Read() } {}
+
+			Scope(Scope const&) = delete;
+			auto operator=(Scope const&) -> Scope & = delete;
+
+			~Scope()
+			{
+				_region.Record(_bytes, _begin, CounterSet::Local().Read());
+			}
+		};
+
+		inline auto Report(std::ostream& stream) -> void
+		{
+			auto regions = Regions::Instance().Snapshot();
+			std::sort(regions.begin(), regions.end(), [](auto const& first, auto const& second)
+			{
+				return first.second.total.nanoseconds > second.second.total.nanoseconds;
+			});
+
+			auto const flags = stream.flags();
+			auto const precision = stream.precision();
+			auto ratio = [&](RegionStats const& region, Counter numerator, Counter denominator, double factor) -> std::string
+			{
+				auto const& total = region.total;
+				if (!total.valid[numerator] || !total.valid[denominator] || total.counters[denominator] == 0)
+				{
+					return "n/a";
+				}
+				std::string text = std::to_string(factor * static_cast<double>(total.counters[numerator]) / static_cast<double>(total.counters[denominator]));
+				return text.substr(0, text.find('.') + 3);
+			};
+
+			stream << "hardware counters: " << (CounterSet::Local().Hardware() ? "perf_event_open" : "unavailable, timers only") << '\n';
+			stream << std::left << std::setw(24) << "region" << std::setw(12) << "calls" << std::setw(14) << "ns/call"
+				<< std::setw(8) << "IPC" << std::setw(10) << "L1D%" << std::setw(10) << "LLC%" << std::setw(10) << "branch%" << "GB/s" << '\n';
+			for (auto const& [name, region] : regions)
+			{
+				if (region.calls == 0)
+				{
+					continue;
+				}
+				double const seconds = static_cast<double>(region.total.nanoseconds) * 1e-9;
+				stream << std::left << std::setw(24) << name << std::setw(12) << region.calls
+					<< std::setw(14) << std::fixed << std::setprecision(1) << static_cast<double>(region.total.nanoseconds) / static_cast<double>(region.calls)
+					<< std::setw(8) << ratio(region, Instructions, Cycles, 1.0)
+					<< std::setw(10) << ratio(region, L1DMisses, L1DAccesses, 100.0)
+					<< std::setw(10) << ratio(region, LLCMisses, LLCAccesses, 100.0)
+					<< std::setw(10) << ratio(region, BranchMisses, Branches, 100.0)
+					<< std::setprecision(2) << (seconds > 0.0 ? static_cast<double>(region.bytes) / seconds * 1e-9 : 0.0) << '\n';
+			}
+			stream.flags(flags);
+			stream.precision(precision);
+		}
+
+		inline auto Reset() -> void
+		{
+			Regions::Instance().Reset();
+		}
+	}
+}
+
+#define ET_PERF_IMPL_CONCAT(a, b) a##b
+#define ET_PERF_IMPL_NAME(a, b) ET_PERF_IMPL_CONCAT(a, b)
+#define ET_PERF_SCOPE(name, bytes) ::Et::Perf::Scope ET_PERF_IMPL_NAME(_et_perf_scope_, __LINE__){ name, bytes }
+
+#else
+
+namespace Et {
+
+	namespace Perf {
+
+		inline auto Report(std::ostream&) -> void {}
+
+		inline auto Reset() -> void {}
+	}
+}
+
+#define ET_PERF_SCOPE(name, bytes)
+
+#endif
@@ -0,0 +1,390 @@
+#pragma once
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "thread_pool.h"
+#include "trace.h"
+
+namespace Et {
+
+	namespace Pipeline {
+
+		class Runner;
+
+		class Task
+		{
+		public:
+			struct promise_type
+			{
+				Runner* runner = nullptr;
+				std::exception_ptr error;
+
+				auto get_return_object() -> Task
+				{
+					return Task{ std::coroutine_handle<promise_type>::from_promise(*this) };
+				}
+
+				auto initial_suspend() noexcept -> std::suspend_always
+				{
+					return {};
+				}
+
+				struct _impl_FinalAwaiter
+				{
+					auto await_ready() noexcept -> bool
+					{
+						return false;
+					}
+
+					auto await_suspend(std::coroutine_handle<promise_type> handle) noexcept -> void;
+
+					auto await_resume() noexcept -> void {}
+				};
+
+				auto final_suspend() noexcept -> _impl_FinalAwaiter
+				{
+					return {};
+				}
+
+				auto return_void() -> void {}
+
+				auto unhandled_exception() -> void
+				{
+					error = std::current_exception();
+				}
+			};
+
+		private:
+			friend class Runner;
+
+			std::coroutine_handle<promise_type> _handle;
+
+			explicit Task(std::coroutine_handle<promise_type> handle) : _handle{ handle } {}
+
+		public:
+			Task(Task&& other) noexcept : _handle{ std::exchange(other._handle, nullptr) } {}
+
+			Task(Task const&) = delete;
+			auto operator=(Task const&) -> Task & = delete;
+			auto operator=(Task&&) -> Task & = delete;
+
+			~Task()
+			{
+				if (_handle)
+				{
+					_handle.destroy();
+				}
+			}
+		};
+
+		inline auto _impl_Resume(ThreadPool& pool, std::coroutine_handle<> handle) -> void
+		{
+			pool.Submit([handle]() { handle.resume(); });
+		}
+
+		class Runner
+		{
+		private:
+			ThreadPool& _pool;
+			std::atomic<size_t> _outstanding;
+			std::mutex _mutex;
+			std::condition_variable _done;
+			std::exception_ptr _error;
+			std::vector<std::function<void()>> _cancellations;
+
+			friend struct Task::promise_type::_impl_FinalAwaiter;
+
+			auto _impl_Finished(std::exception_ptr error) -> void
+			{
+				std::vector<std::function<void()>> cancellations;
+				{
+					std::lock_guard<std::mutex> lock{ _mutex };
+					if (error && !_error)
+					{
+						_error = error;
+						cancellations.swap(_cancellations);
+					}
+				}
+				for (auto const& cancel : cancellations)
+				{
+					cancel();
+				}
+				std::lock_guard<std::mutex> lock{ _mutex };
+				if (_outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					_done.notify_all();
+				}
+			}
+
+			auto _impl_Join() -> void
+			{
+				while (true)
+				{
+					if (_outstanding.load(std::memory_order_acquire) == 0)
+					{
+						std::lock_guard<std::mutex> lock{ _mutex };
+						return;
+					}
+					if (_pool.TryRunOne())
+					{
+						continue;
+					}
+					std::unique_lock<std::mutex> lock{ _mutex };
+					_done.wait_for(lock, std::chrono::milliseconds(1), [this]() { return _outstanding.load(std::memory_order_acquire) == 0; });
+				}
+			}
+
+		public:
+			Runner(ThreadPool& pool) : _pool{ pool }, _outstanding{ 0 } {}
+
+			Runner(Runner const&) = delete;
+			auto operator=(Runner const&) -> Runner & = delete;
+
+			~Runner()
+			{
+				_impl_Join();
+			}
+
+			auto Pool() -> ThreadPool&
+			{
+				return _pool;
+			}
+
+			template <typename C>
+			auto CloseOnError(C& channel) -> void
+			{
+				std::lock_guard<std::mutex> lock{ _mutex };
+				if (_error)
+				{
+					channel.Close();
+					return;
+				}
+				_cancellations.push_back([&channel]() { channel.Close(); });
+			}
+
+			auto Spawn(Task task) -> void
+			{
+				auto const handle = std::exchange(task._handle, nullptr);
+				handle.promise().runner = this;
+				_outstanding.fetch_add(1, std::memory_order_relaxed);
+				_impl_Resume(_pool, handle);
+			}
+
+			auto Wait() -> void
+			{
+				_impl_Join();
+				std::lock_guard<std::mutex> lock{ _mutex };
+				if (_error)
+				{
+					std::rethrow_exception(std::exchange(_error, nullptr));
+				}
+			}
+		};
+
+		inline auto Task::promise_type::_impl_FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept -> void
+		{
+			Runner* const runner = handle.promise().runner;
+			std::exception_ptr error = std::move(handle.promise().error);
+			handle.destroy();
+			runner->_impl_Finished(std::move(error));
+		}
+
+		inline auto Yield(ThreadPool& pool)
+		{
+			struct _impl_YieldAwaiter
+			{
+				ThreadPool& pool;
+
+				auto await_ready() noexcept -> bool
+				{
+					return false;
+				}
+
+				auto await_suspend(std::coroutine_handle<> handle) -> void
+				{
+					_impl_Resume(pool, handle);
+				}
+
+				auto await_resume() noexcept -> void {}
+			};
+			return _impl_YieldAwaiter{ pool };
+		}
+
+		template <typename T>
+		class Channel
+		{
+		private:
+			struct _impl_SendAwaiter
+			{
+				Channel& channel;
+				T value;
+				bool sent;
+				std::coroutine_handle<> handle;
+				Trace::WaitSpan wait;
+
+				auto await_ready() noexcept -> bool
+				{
+					return false;
+				}
+
+				auto await_suspend(std::coroutine_handle<> awaiting) -> bool
+				{
+					handle = awaiting;
+					return channel._impl_Send(*this);
+				}
+
+				auto await_resume() noexcept -> bool
+				{
+					wait.End();
+					return sent;
+				}
+			};
+
+			struct _impl_ReceiveAwaiter
+			{
+				Channel& channel;
+				std::optional<T> value;
+				std::coroutine_handle<> handle;
+				Trace::WaitSpan wait;
+
+				auto await_ready() noexcept -> bool
+				{
+					return false;
+				}
+
+				auto await_suspend(std::coroutine_handle<> awaiting) -> bool
+				{
+					handle = awaiting;
+					return channel._impl_Receive(*this);
+				}
+
+				auto await_resume() -> std::optional<T>
+				{
+					wait.End();
+					return std::move(value);
+				}
+			};
+
+			ThreadPool& _pool;
+			size_t _capacity;
+			std::mutex _mutex;
+			std::deque<T> _items;
+			std::deque<_impl_SendAwaiter*> _senders;
+			std::deque<_impl_ReceiveAwaiter*> _receivers;
+			bool _closed;
+
+			auto _impl_Send(_impl_SendAwaiter& sender) -> bool
+			{
+				std::unique_lock<std::mutex> lock{ _mutex };
+				sender.sent = !_closed;
+				if (_closed)
+				{
+					return false;
+				}
+				if (!_receivers.empty())
+				{
+					auto* const receiver = _receivers.front();
+					_receivers.pop_front();
+					receiver->value.emplace(std::move(sender.value));
+					lock.unlock();
+					_impl_Resume(_pool, receiver->handle);
+					return false;
+				}
+				if (_items.size() < _capacity)
+				{
+					_items.push_back(std::move(sender.value));
+					return false;
+				}
+				sender.wait.Begin("Channel::Send");
+				_senders.push_back(&sender);
+				return true;
+			}
+
+			auto _impl_Receive(_impl_ReceiveAwaiter& receiver) -> bool
+			{
+				std::unique_lock<std::mutex> lock{ _mutex };
+				_impl_SendAwaiter* sender = nullptr;
+				if (!_senders.empty())
+				{
+					sender = _senders.front();
+					_senders.pop_front();
+				}
+				if (!_items.empty())
+				{
+					receiver.value.emplace(std::move(_items.front()));
+					_items.pop_front();
+					if (sender)
+					{
+						_items.push_back(std::move(sender->value));
+					}
+				}
+				else if (sender)
+				{
+					receiver.value.emplace(std::move(sender->value));
+				}
+				else if (!_closed)
+				{
+					receiver.wait.Begin("Channel::Receive");
+					_receivers.push_back(&receiver);
+					return true;
+				}
+				lock.unlock();
+				if (sender)
+				{
+					_impl_Resume(_pool, sender->handle);
+				}
+				return false;
+			}
+
+		public:
+			Channel(ThreadPool& pool, size_t capacity = 1) : _pool{ pool }, _capacity{ capacity }, _closed{ false } {}
+
+			Channel(Channel const&) = delete;
+			auto operator=(Channel const&) -> Channel & = delete;
+
+			auto Send(T value) -> _impl_SendAwaiter
+			{
+				return _impl_SendAwaiter{ *this, std::move(value), false, nullptr, {} };
+			}
+
+			auto Receive() -> _impl_ReceiveAwaiter
+			{
+				return _impl_ReceiveAwaiter{ *this, std::nullopt, nullptr, {} };
+			}
+
+			auto Close() -> void
+			{
+				std::deque<_impl_SendAwaiter*> senders;
+				std::deque<_impl_ReceiveAwaiter*> receivers;
+				{
+					std::lock_guard<std::mutex> lock{ _mutex };
+					_closed = true;
+					senders.swap(_senders);
+					receivers.swap(_receivers);
+				}
+				for (auto* sender : senders)
+				{
+					sender->sent = false;
+					_impl_Resume(_pool, sender->handle);
+				}
+				for (auto* receiver : receivers)
+				{
+					_impl_Resume(_pool, receiver->handle);
+				}
+			}
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <ostream>
+
+#if defined(ET_PROFILE)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "type_name.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace Et {
+
+	namespace Profile {
+
+		enum class Phase
+		{
+			Forward,
+			Backward
+		};
+
+		struct Record
+		{
+			Phase phase;
+			int index;
+			std::string name;
+			uint64_t calls;
+			uint64_t self_cycles;
+			uint64_t total_cycles;
+			uint64_t bytes;
+		};
+
+		struct Counters
+		{
+			std::atomic<uint64_t> calls{ 0 };
+			std::atomic<uint64_t> self_cycles{ 0 };
+			std::atomic<uint64_t> total_cycles{ 0 };
+			std::atomic<uint64_t> bytes{ 0 };
+		};
+
+		inline auto Ticks() -> uint64_t
+		{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+			return __rdtsc();
+#else
+			return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+		}
+
+		class Registry
+		{
+		private:
+			struct _impl_Entry
+			{
+				Phase phase;
+				int index;
+				std::string name;
+				Counters counters;
+			};
+
+			std::mutex _mutex;
+			std::vector<std::unique_ptr<_impl_Entry>> _entries;
+
+		public:
+			static auto Instance() -> Registry&
+			{
+				static Registry registry;
+				return registry;
+			}
+
+			auto Register(Phase phase, int index, std::string name) -> Counters&
+			{
+				std::lock_guard<std::mutex> lock{ _mutex };
+				_entries.push_back(std::make_unique<_impl_Entry>());
+				_entries.back()->phase = phase;
+				_entries.back()->index = index;
+				_entries.back()->name = std::move(name);
+				return _entries.back()->counters;
+			}
+
+			auto Snapshot() -> std::vector<Record>
+			{
+				std::lock_guard<std::mutex> lock{ _mutex };
+				std::vector<Record> records;
+				for (auto const& entry : _entries)
+				{
+					Counters const& counters = entry->counters;
+					uint64_t const calls = counters.calls.load(std::memory_order_relaxed);
+					if (calls > 0)
+					{
+						records.push_back({ entry->phase, entry->index, entry->name, calls, counters.self_cycles.load(std::memory_order_relaxed),
+							counters.total_cycles.load(std::memory_order_relaxed), counters.bytes.load(std::memory_order_relaxed) });
+					}
+				}
+				return records;
+			}
+
+			auto Reset() -> void
+			{
+				std::lock_guard<std::mutex> lock{ _mutex };
+				for (auto& entry : _entries)
+				{
+					entry->counters.calls.store(0, std::memory_order_relaxed);
+					entry->counters.self_cycles.store(0, std::memory_order_relaxed);
+					entry->counters.total_cycles.store(0, std::memory_order_relaxed);
+					entry->counters.bytes.store(0, std::memory_order_relaxed);
+				}
+			}
+		};
+
+		template <Phase P, typename E, int I>
+		auto Slot() -> Counters&
+		{
+			static Counters& counters = Registry::Instance().Register(P, I, short_type_name(type_name<E>()));
+			return counters;
+		}
+
+		class Scope
+		{
+		private:
+			Counters& _counters;
+			uint64_t _bytes;
+			uint64_t _child_cycles;
+			Scope* _parent;
+			uint64_t _start;
+
+			inline static thread_local Scope* _current = nullptr;
+
+		public:
+			Scope(Counters& counters, uint64_t bytes) : _counters{ counters }, _bytes{ bytes }, _child_cycles{ 0 }, _parent{ _current }
+			{
+				_current = this;
+				_start = Ticks();
+			}
+
+			Scope(Scope const&) = delete;
+			auto operator=(Scope const&) -> Scope & = delete;
+
+			~Scope()
+			{
+				uint64_t const elapsed = Ticks() - _start;
+				_counters.calls.fetch_add(1, std::memory_order_relaxed);
+				_counters.total_cycles.fetch_add(elapsed, std::memory_order_relaxed);
+				_counters.self_cycles.fetch_add(elapsed > _child_cycles ? elapsed - _child_cycles : 0, std::memory_order_relaxed);
+				_counters.bytes.fetch_add(_bytes, std::memory_order_relaxed);
+				if (_parent != nullptr)
+				{
+					_parent->_child_cycles += elapsed;
+				}
+				_current = _parent;
+			}
+		};
+
+		inline auto Report(std::ostream& stream, size_t top = 20) -> void
+		{
+			auto records = Registry::Instance().Snapshot();
+			std::sort(records.begin(), records.end(), [](Record const& first, Record const& second) { return first.self_cycles > second.self_cycles; });
+
+			uint64_t total = 0;
+			for (auto const& record : records)
+			{
+				total += record.self_cycles;
+			}
+
+			auto const flags = stream.flags();
+			auto const precision = stream.precision();
+
+			stream << std::left << std::setw(10) << "phase" << std::setw(6) << "node" << std::setw(12) << "calls"
+				<< std::setw(16) << "self cycles" << std::setw(8) << "share" << std::setw(12) << "cyc/call" << std::setw(12) << "bytes/call" << "expression" << '\n';
+
+			for (size_t i = 0; i < records.size() && i < top; i++)
+			{
+				auto const& record = records[i];
+				stream << std::left << std::setw(10) << (record.phase == Phase::Forward ? "forward" : "backward")
+					<< std::setw(6) << record.index << std::setw(12) << record.calls << std::setw(16) << record.self_cycles
+					<< std::setw(8) << std::fixed << std::setprecision(1) << (total > 0 ? 100.0 * record.self_cycles / total : 0.0)
+					<< std::setw(12) << record.self_cycles / record.calls << std::setw(12) << record.bytes / record.calls
+					<< record.name << '\n';
+				stream.unsetf(std::ios::fixed);
+			}
+
+			stream.flags(flags);
+			stream.precision(precision);
+		}
+
+		inline auto Reset() -> void
+		{
+			Registry::Instance().Reset();
+		}
+	}
+}
+
+#define ET_PROFILE_IMPL_CONCAT(a, b) a##b
+#define ET_PROFILE_IMPL_NAME(a, b) ET_PROFILE_IMPL_CONCAT(a, b)
+#define ET_PROFILE_SCOPE(phase, type, index, bytes) \
+	::Et::Profile::Scope ET_PROFILE_IMPL_NAME(_et_profile_scope_, __LINE__){ ::Et::Profile::Slot<::Et::Profile::Phase::phase, type, index>(), bytes }
+
+#else
+
+namespace Et {
+
+	namespace Profile {
+
+		inline auto Report(std::ostream&, size_t = 20) -> void {}
+
+		inline auto Reset() -> void {}
+	}
+}
+
+#define ET_PROFILE_SCOPE(phase, type, index, bytes)
+
+#endif
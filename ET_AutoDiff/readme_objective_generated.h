@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cmath>
+
+// Generated by Et::Runtime::EmitCpp.
+// x: x1, x2
+// p: p
+inline double ReadmeObjective([[maybe_unused]] double const* x, [[maybe_unused]] double const* p)
+{
+	double const t5 = x[0] * x[0];
+	double const t6 = x[1] * x[1];
+	double const t7 = t5 + t6;
+	double const t8 = x[0] * 4.0000000000000000;
+	double const t9 = t7 + t8;
+	double const t10 = x[1] * 2.0000000000000000;
+	double const t11 = t9 + t10;
+	double const t12 = p[0] + t11;
+	return t12;
+}
+
+// x: x1, x2
+// p: p
+inline double ReadmeObjective_gradient([[maybe_unused]] double const* x, [[maybe_unused]] double const* p, double* grad)
+{
+	double const t5 = x[0] * x[0];
+	double const t6 = x[1] * x[1];
+	double const t7 = t5 + t6;
+	double const t8 = x[0] * 4.0000000000000000;
+	double const t9 = t7 + t8;
+	double const t10 = x[1] * 2.0000000000000000;
+	double const t11 = t9 + t10;
+	double const t12 = p[0] + t11;
+	double g12 = 1.0;
+	double g11 = g12;
+	double g9 = g11;
+	double g10 = g11;
+	double g3 = g10 * 2.0000000000000000;
+	double g7 = g9;
+	double g8 = g9;
+	double g2 = g8 * 4.0000000000000000;
+	double g5 = g7;
+	double g6 = g7;
+	g3 += g6 * x[1];
+	g3 += g6 * x[1];
+	g2 += g5 * x[0];
+	g2 += g5 * x[0];
+	grad[0] = g2;
+	grad[1] = g3;
+	return t12;
+}
@@ -0,0 +1,746 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace Et {
+
+	namespace Runtime {
+
+		enum class OpCode : uint8_t
+		{
+			Constant,
+			Variable,
+			Placeholder,
+			Add,
+			Subtract,
+			Multiply,
+			Divide,
+			Power,
+			Negate,
+			Log,
+			Sin,
+			Cos,
+			Tan
+		};
+
+		constexpr auto IsBinary(OpCode op) -> bool
+		{
+			return op >= OpCode::Add && op <= OpCode::Power;
+		}
+
+		constexpr auto IsUnary(OpCode op) -> bool
+		{
+			return op >= OpCode::Negate;
+		}
+
+		constexpr auto OpName(OpCode op) -> char const*
+		{
+			constexpr char const* names[] = { "const", "var", "hold", "add", "sub", "mul", "div", "pow", "neg", "log", "sin", "cos", "tan" };
+			return names[static_cast<size_t>(op)];
+		}
+
+		class ParseError : public std::runtime_error
+		{
+		private:
+			size_t _position;
+
+		public:
+			ParseError(std::string const& message, size_t position)
+				: std::runtime_error{ message + " at position " + std::to_string(position) }, _position{ position } {}
+
+			auto Position() const -> size_t
+			{
+				return _position;
+			}
+		};
+
+		struct Node
+		{
+			OpCode op;
+			uint32_t first;
+			uint32_t second;
+			double value;
+		};
+
+		class Graph
+		{
+		private:
+			using key_t = std::tuple<OpCode, uint32_t, uint32_t, uint64_t>;
+
+			std::vector<Node> _nodes;
+			std::map<key_t, uint32_t> _unique;
+			std::vector<std::string> _variables;
+			std::vector<std::string> _placeholders;
+			uint32_t _root;
+
+			auto _impl_Intern(Node const& node) -> uint32_t
+			{
+				uint64_t bits = 0;
+				std::memcpy(&bits, &node.value, sizeof(bits));
+				key_t key{ node.op, node.first, node.second, bits };
+
+				auto it = _unique.find(key);
+				if (it != _unique.end())
+				{
+					return it->second;
+				}
+				_nodes.push_back(node);
+				uint32_t const index = static_cast<uint32_t>(_nodes.size() - 1);
+				_unique.emplace(key, index);
+				return index;
+			}
+
+			auto _impl_IsConstant(uint32_t index, double value) const -> bool
+			{
+				return _nodes[index].op == OpCode::Constant && _nodes[index].value == value;
+			}
+
+		public:
+			Graph(std::vector<std::string> variables = {}, std::vector<std::string> placeholders = {})
+				: _variables{ std::move(variables) }, _placeholders{ std::move(placeholders) }, _root{ 0 }
+			{
+				for (uint32_t i = 0; i < _variables.size(); i++)
+				{
+					_impl_Intern({ OpCode::Variable, i, 0, 0.0 });
+				}
+				for (uint32_t i = 0; i < _placeholders.size(); i++)
+				{
+					_impl_Intern({ OpCode::Placeholder, i, 0, 0.0 });
+				}
+			}
+
+			auto Nodes() const -> std::vector<Node> const&
+			{
+				return _nodes;
+			}
+
+			auto Variables() const -> std::vector<std::string> const&
+			{
+				return _variables;
+			}
+
+			auto Placeholders() const -> std::vector<std::string> const&
+			{
+				return _placeholders;
+			}
+
+			auto Root() const -> uint32_t
+			{
+				return _root;
+			}
+
+			auto SetRoot(uint32_t root) -> void
+			{
+				_root = root;
+			}
+
+			auto Constant(double value) -> uint32_t
+			{
+				return _impl_Intern({ OpCode::Constant, 0, 0, value });
+			}
+
+			auto Variable(uint32_t index) -> uint32_t
+			{
+				return _impl_Intern({ OpCode::Variable, index, 0, 0.0 });
+			}
+
+			auto Placeholder(uint32_t index) -> uint32_t
+			{
+				return _impl_Intern({ OpCode::Placeholder, index, 0, 0.0 });
+			}
+
+			auto Unary(OpCode op, uint32_t first) -> uint32_t
+			{
+				Node const& node = _nodes[first];
+				if (node.op == OpCode::Constant)
+				{
+					double const x = node.value;
+					switch (op)
+					{
+					case OpCode::Negate: return Constant(-x);
+					case OpCode::Log: return Constant(std::log(x));
+					case OpCode::Sin: return Constant(std::sin(x));
+					case OpCode::Cos: return Constant(std::cos(x));
+					default: return Constant(std::tan(x));
+					}
+				}
+				if (op == OpCode::Negate && node.op == OpCode::Negate)
+				{
+					return node.first;
+				}
+				return _impl_Intern({ op, first, 0, 0.0 });
+			}
+
+			auto Binary(OpCode op, uint32_t first, uint32_t second) -> uint32_t
+			{
+				if (_nodes[first].op == OpCode::Constant && _nodes[second].op == OpCode::Constant)
+				{
+					double const x = _nodes[first].value;
+					double const y = _nodes[second].value;
+					switch (op)
+					{
+					case OpCode::Add: return Constant(x + y);
+					case OpCode::Subtract: return Constant(x - y);
+					case OpCode::Multiply: return Constant(x * y);
+					case OpCode::Divide: return Constant(x / y);
+					default: return Constant(std::pow(x, y));
+					}
+				}
+
+				switch (op)
+				{
+				case OpCode::Add:
+					if (_impl_IsConstant(first, 0.0)) return second;
+					if (_impl_IsConstant(second, 0.0)) return first;
+					break;
+				case OpCode::Subtract:
+					if (_impl_IsConstant(second, 0.0)) return first;
+					if (_impl_IsConstant(first, 0.0)) return Unary(OpCode::Negate, second);
+					if (first == second) return Constant(0.0);
+					break;
+				case OpCode::Multiply:
+					if (_impl_IsConstant(first, 1.0)) return second;
+					if (_impl_IsConstant(second, 1.0)) return first;
+					break;
+				case OpCode::Divide:
+					if (_impl_IsConstant(second, 1.0)) return first;
+					break;
+				default:
+					if (_impl_IsConstant(second, 1.0)) return first;
+					if (_impl_IsConstant(second, 0.0)) return Constant(1.0);
+					if (_impl_IsConstant(second, 2.0)) return Binary(OpCode::Multiply, first, first);
+					break;
+				}
+
+				if ((op == OpCode::Add || op == OpCode::Multiply) && second < first)
+				{
+					std::swap(first, second);
+				}
+				return _impl_Intern({ op, first, second, 0.0 });
+			}
+		};
+
+		class _impl_Parser
+		{
+		private:
+			std::string const& _text;
+			Graph& _graph;
+			size_t _position;
+
+			auto _impl_SkipSpaces() -> void
+			{
+				while (_position < _text.size() && std::isspace(static_cast<unsigned char>(_text[_position])))
+				{
+					_position++;
+				}
+			}
+
+			auto _impl_Accept(char token) -> bool
+			{
+				_impl_SkipSpaces();
+				if (_position < _text.size() && _text[_position] == token)
+				{
+					_position++;
+					return true;
+				}
+				return false;
+			}
+
+			auto _impl_Expect(char token) -> void
+			{
+				if (!_impl_Accept(token))
+				{
+					throw ParseError{ std::string{ "expected '" } + token + "'", _position };
+				}
+			}
+
+			auto _impl_Lookup(std::vector<std::string> const& names, std::string const& name) -> int64_t
+			{
+				for (size_t i = 0; i < names.size(); i++)
+				{
+					if (names[i] == name)
+					{
+						return static_cast<int64_t>(i);
+					}
+				}
+				return -1;
+			}
+
+			auto _impl_Primary() -> uint32_t
+			{
+				_impl_SkipSpaces();
+				size_t const start = _position;
+				if (_position >= _text.size())
+				{
+					throw ParseError{ "unexpected end of formula", _position };
+				}
+
+				if (_impl_Accept('('))
+				{
+					uint32_t const inner = _impl_Sum();
+					_impl_Expect(')');
+					return inner;
+				}
+
+				char const c = _text[_position];
+				if (std::isdigit(static_cast<unsigned char>(c)) || c == '.')
+				{
+					char* end = nullptr;
+					double const value = std::strtod(_text.c_str() + _position, &end);
+					if (end == _text.c_str() + _position)
+					{
+						throw ParseError{ "malformed number", _position };
+					}
+					_position = static_cast<size_t>(end - _text.c_str());
+					return _graph.Constant(value);
+				}
+
+				if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+				{
+					while (_position < _text.size() && (std::isalnum(static_cast<unsigned char>(_text[_position])) || _text[_position] == '_'))
+					{
+						_position++;
+					}
+					std::string const name = _text.substr(start, _position - start);
+
+					if (auto index = _impl_Lookup(_graph.Variables(), name); index >= 0)
+					{
+						return _graph.Variable(static_cast<uint32_t>(index));
+					}
+					if (auto index = _impl_Lookup(_graph.Placeholders(), name); index >= 0)
+					{
+						return _graph.Placeholder(static_cast<uint32_t>(index));
+					}
+
+					constexpr std::pair<char const*, OpCode> functions[] = {
+						{ "log", OpCode::Log }, { "sin", OpCode::Sin }, { "cos", OpCode::Cos }, { "tan", OpCode::Tan } };
+					for (auto const& function : functions)
+					{
+						if (name == function.first)
+						{
+							_impl_Expect('(');
+							uint32_t const argument = _impl_Sum();
+							_impl_Expect(')');
+							return _graph.Unary(function.second, argument);
+						}
+					}
+
+					if (name == "pi")
+					{
+						return _graph.Constant(3.14159265358979323846);
+					}
+					if (name == "e")
+					{
+						return _graph.Constant(2.71828182845904523536);
+					}
+					throw ParseError{ "unknown identifier '" + name + "'", start };
+				}
+
+				throw ParseError{ std::string{ "unexpected '" } + c + "'", _position };
+			}
+
+			auto _impl_Power() -> uint32_t
+			{
+				uint32_t const base = _impl_Primary();
+				if (_impl_Accept('^'))
+				{
+					return _graph.Binary(OpCode::Power, base, _impl_Unary());
+				}
+				return base;
+			}
+
+			auto _impl_Unary() -> uint32_t
+			{
+				if (_impl_Accept('-'))
+				{
+					return _graph.Unary(OpCode::Negate, _impl_Unary());
+				}
+				if (_impl_Accept('+'))
+				{
+					return _impl_Unary();
+				}
+				return _impl_Power();
+			}
+
+			auto _impl_Product() -> uint32_t
+			{
+				uint32_t result = _impl_Unary();
+				while (true)
+				{
+					if (_impl_Accept('*'))
+					{
+						result = _graph.Binary(OpCode::Multiply, result, _impl_Unary());
+					}
+					else if (_impl_Accept('/'))
+					{
+						result = _graph.Binary(OpCode::Divide, result, _impl_Unary());
+					}
+					else
+					{
+						return result;
+					}
+				}
+			}
+
+			auto _impl_Sum() -> uint32_t
+			{
+				uint32_t result = _impl_Product();
+				while (true)
+				{
+					if (_impl_Accept('+'))
+					{
+						result = _graph.Binary(OpCode::Add, result, _impl_Product());
+					}
+					else if (_impl_Accept('-'))
+					{
+						result = _graph.Binary(OpCode::Subtract, result, _impl_Product());
+					}
+					else
+					{
+						return result;
+					}
+				}
+			}
+
+		public:
+			_impl_Parser(std::string const& text, Graph& graph) : _text{ text }, _graph{ graph }, _position{ 0 } {}
+
+			auto Parse() -> uint32_t
+			{
+				uint32_t const root = _impl_Sum();
+				_impl_SkipSpaces();
+				if (_position != _text.size())
+				{
+					throw ParseError{ std::string{ "unexpected '" } + _text[_position] + "'", _position };
+				}
+				return root;
+			}
+		};
+
+		inline auto Parse(std::string const& formula, std::vector<std::string> variables, std::vector<std::string> placeholders = {}) -> Graph
+		{
+			Graph graph{ std::move(variables), std::move(placeholders) };
+			graph.SetRoot(_impl_Parser{ formula, graph }.Parse());
+			return graph;
+		}
+
+		struct Instruction
+		{
+			OpCode op;
+			bool first_needs_grad;
+			bool second_needs_grad;
+			uint32_t target;
+			uint32_t first;
+			uint32_t second;
+		};
+
+		class Program
+		{
+		private:
+			std::vector<std::string> _variables;
+			std::vector<std::string> _placeholders;
+			std::vector<double> _constants;
+			std::vector<Instruction> _code;
+			uint32_t _n_registers;
+			uint32_t _result;
+
+		public:
+			Program() : _n_registers{ 0 }, _result{ 0 } {}
+
+			Program(std::vector<std::string> variables, std::vector<std::string> placeholders, std::vector<double> constants,
+				std::vector<Instruction> code, uint32_t n_registers, uint32_t result)
+				: _variables{ std::move(variables) }, _placeholders{ std::move(placeholders) }, _constants{ std::move(constants) },
+				_code{ std::move(code) }, _n_registers{ n_registers }, _result{ result } {}
+
+			auto Variables() const -> std::vector<std::string> const&
+			{
+				return _variables;
+			}
+
+			auto Placeholders() const -> std::vector<std::string> const&
+			{
+				return _placeholders;
+			}
+
+			auto Constants() const -> std::vector<double> const&
+			{
+				return _constants;
+			}
+
+			auto Code() const -> std::vector<Instruction> const&
+			{
+				return _code;
+			}
+
+			auto RegisterCount() const -> uint32_t
+			{
+				return _n_registers;
+			}
+
+			auto ResultRegister() const -> uint32_t
+			{
+				return _result;
+			}
+
+			auto VariableRegister(size_t index) const -> uint32_t
+			{
+				return static_cast<uint32_t>(_constants.size() + index);
+			}
+
+			auto PlaceholderRegister(size_t index) const -> uint32_t
+			{
+				return static_cast<uint32_t>(_constants.size() + _variables.size() + index);
+			}
+
+			auto Disassemble(std::ostream& stream) const -> void
+			{
+				for (size_t i = 0; i < _constants.size(); i++)
+				{
+					stream << "r" << i << " = " << _constants[i] << '\n';
+				}
+				for (size_t i = 0; i < _variables.size(); i++)
+				{
+					stream << "r" << VariableRegister(i) << " = var " << _variables[i] << '\n';
+				}
+				for (size_t i = 0; i < _placeholders.size(); i++)
+				{
+					stream << "r" << PlaceholderRegister(i) << " = hold " << _placeholders[i] << '\n';
+				}
+				for (auto const& instruction : _code)
+				{
+					stream << "r" << instruction.target << " = " << OpName(instruction.op) << " r" << instruction.first;
+					if (IsBinary(instruction.op))
+					{
+						stream << ", r" << instruction.second;
+					}
+					stream << '\n';
+				}
+				stream << "ret r" << _result << '\n';
+			}
+		};
+
+		inline auto Lower(Graph const& graph) -> Program
+		{
+			auto const& nodes = graph.Nodes();
+			std::vector<bool> live(nodes.size(), false);
+			live[graph.Root()] = true;
+			for (size_t i = nodes.size(); i-- > 0;)
+			{
+				if (live[i] && IsBinary(nodes[i].op))
+				{
+					live[nodes[i].first] = live[nodes[i].second] = true;
+				}
+				else if (live[i] && IsUnary(nodes[i].op))
+				{
+					live[nodes[i].first] = true;
+				}
+			}
+
+			std::vector<double> constants;
+			std::vector<uint32_t> registers(nodes.size(), 0);
+			for (size_t i = 0; i < nodes.size(); i++)
+			{
+				if (live[i] && nodes[i].op == OpCode::Constant)
+				{
+					registers[i] = static_cast<uint32_t>(constants.size());
+					constants.push_back(nodes[i].value);
+				}
+			}
+
+			uint32_t const n_inputs = static_cast<uint32_t>(constants.size() + graph.Variables().size() + graph.Placeholders().size());
+			std::vector<bool> needs_grad(nodes.size(), false);
+			std::vector<Instruction> code;
+			for (size_t i = 0; i < nodes.size(); i++)
+			{
+				Node const& node = nodes[i];
+				if (node.op == OpCode::Variable)
+				{
+					registers[i] = static_cast<uint32_t>(constants.size() + node.first);
+					needs_grad[i] = true;
+				}
+				else if (node.op == OpCode::Placeholder)
+				{
+					registers[i] = static_cast<uint32_t>(constants.size() + graph.Variables().size() + node.first);
+				}
+				else if (node.op != OpCode::Constant && live[i])
+				{
+					bool const binary = IsBinary(node.op);
+					needs_grad[i] = needs_grad[node.first] || (binary && needs_grad[node.second]);
+					registers[i] = n_inputs + static_cast<uint32_t>(code.size());
+					code.push_back({ node.op, needs_grad[node.first], binary && needs_grad[node.second],
+						registers[i], registers[node.first], binary ? registers[node.second] : 0 });
+				}
+			}
+
+			uint32_t const n_registers = n_inputs + static_cast<uint32_t>(code.size());
+			return { graph.Variables(), graph.Placeholders(), std::move(constants), std::move(code), n_registers, registers[graph.Root()] };
+		}
+
+		inline auto Compile(std::string const& formula, std::vector<std::string> variables, std::vector<std::string> placeholders = {}) -> Program
+		{
+			return Lower(Parse(formula, std::move(variables), std::move(placeholders)));
+		}
+
+		class Evaluator
+		{
+		private:
+			Program const& _program;
+			std::vector<double> _registers;
+			std::vector<double> _adjoints;
+
+			auto _impl_Load(double const* variables, double const* placeholders) -> void
+			{
+				if ((variables == nullptr && !_program.Variables().empty()) || (placeholders == nullptr && !_program.Placeholders().empty()))
+				{
+					throw std::invalid_argument{ "evaluator needs " + std::to_string(_program.Variables().size()) + " variables and " + std::to_string(_program.Placeholders().size()) + " placeholders" };
+				}
+				auto const& constants = _program.Constants();
+				std::copy(constants.begin(), constants.end(), _registers.begin());
+				std::copy(variables, variables + _program.Variables().size(), _registers.begin() + _program.VariableRegister(0));
+				std::copy(placeholders, placeholders + _program.Placeholders().size(), _registers.begin() + _program.PlaceholderRegister(0));
+			}
+
+			auto _impl_CheckSizes(std::vector<double> const& variables, std::vector<double> const& placeholders) const -> void
+			{
+				if (variables.size() != _program.Variables().size() || placeholders.size() != _program.Placeholders().size())
+				{
+					throw std::invalid_argument{ "evaluator needs " + std::to_string(_program.Variables().size()) + " variables and " + std::to_string(_program.Placeholders().size())
+						+ " placeholders, got " + std::to_string(variables.size()) + " and " + std::to_string(placeholders.size()) };
+				}
+			}
+
+		public:
+			Evaluator(Program const& program)
+				: _program{ program }, _registers(program.RegisterCount(), 0.0), _adjoints(program.RegisterCount(), 0.0) {}
+
+			Evaluator(Program&&) = delete;
+
+			auto Forward(double const* variables, double const* placeholders = nullptr) -> double
+			{
+				_impl_Load(variables, placeholders);
+				double* r = _registers.data();
+				for (auto const& instruction : _program.Code())
+				{
+					double const a = r[instruction.first];
+					double const b = r[instruction.second];
+					double& t = r[instruction.target];
+					switch (instruction.op)
+					{
+					case OpCode::Add: t = a + b; break;
+					case OpCode::Subtract: t = a - b; break;
+					case OpCode::Multiply: t = a * b; break;
+					case OpCode::Divide: t = a / b; break;
+					case OpCode::Power: t = std::pow(a, b); break;
+					case OpCode::Negate: t = -a; break;
+					case OpCode::Log: t = std::log(a); break;
+					case OpCode::Sin: t = std::sin(a); break;
+					case OpCode::Cos: t = std::cos(a); break;
+					case OpCode::Tan: t = std::tan(a); break;
+					default: break;
+					}
+				}
+				return r[_program.ResultRegister()];
+			}
+
+			auto Gradient(double const* variables, double const* placeholders, double* gradient) -> double
+			{
+				double const value = Forward(variables, placeholders);
+				double const* r = _registers.data();
+				double* g = _adjoints.data();
+
+				std::fill(_adjoints.begin(), _adjoints.end(), 0.0);
+				g[_program.ResultRegister()] = 1.0;
+
+				auto const& code = _program.Code();
+				for (size_t i = code.size(); i-- > 0;)
+				{
+					auto const& instruction = code[i];
+					double const seed = g[instruction.target];
+					if (seed == 0.0)
+					{
+						continue;
+					}
+					double const a = r[instruction.first];
+					double const b = r[instruction.second];
+					double const t = r[instruction.target];
+					double& ga = g[instruction.first];
+					double& gb = g[instruction.second];
+					bool const da = instruction.first_needs_grad;
+					bool const db = instruction.second_needs_grad;
+
+					switch (instruction.op)
+					{
+					case OpCode::Add:
+						if (da) ga += seed;
+						if (db) gb += seed;
+						break;
+					case OpCode::Subtract:
+						if (da) ga += seed;
+						if (db) gb -= seed;
+						break;
+					case OpCode::Multiply:
+						if (da) ga += seed * b;
+						if (db) gb += seed * a;
+						break;
+					case OpCode::Divide:
+						if (da) ga += seed / b;
+						if (db) gb -= seed * t / b;
+						break;
+					case OpCode::Power:
+						if (da) ga += seed * b * std::pow(a, b - 1.0);
+						if (db) gb += seed * t * std::log(a);
+						break;
+					case OpCode::Negate:
+						if (da) ga -= seed;
+						break;
+					case OpCode::Log:
+						if (da) ga += seed / a;
+						break;
+					case OpCode::Sin:
+						if (da) ga += seed * std::cos(a);
+						break;
+					case OpCode::Cos:
+						if (da) ga -= seed * std::sin(a);
+						break;
+					case OpCode::Tan:
+						if (da) ga += seed * (1.0 + t * t);
+						break;
+					default:
+						break;
+					}
+				}
+
+				for (size_t i = 0; i < _program.Variables().size(); i++)
+				{
+					gradient[i] = g[_program.VariableRegister(i)];
+				}
+				return value;
+			}
+
+			auto Forward(std::vector<double> const& variables, std::vector<double> const& placeholders = {}) -> double
+			{
+				_impl_CheckSizes(variables, placeholders);
+				return Forward(variables.data(), placeholders.data());
+			}
+
+			auto Gradient(std::vector<double> const& variables, std::vector<double> const& placeholders, std::vector<double>& gradient) -> double
+			{
+				_impl_CheckSizes(variables, placeholders);
+				gradient.resize(_program.Variables().size());
+				return Gradient(variables.data(), placeholders.data(), gradient.data());
+			}
+		};
+	}
+}
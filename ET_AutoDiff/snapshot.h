@@ -0,0 +1,234 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "variable_binding.h"
+
+namespace Et {
+
+	namespace Snapshot {
+
+		template <typename T, size_t MaxReaders = 64>
+		class Cell
+		{
+		private:
+			static constexpr uint64_t idle_v = UINT64_MAX;
+
+			struct _impl_Node
+			{
+				T value;
+				uint64_t version;
+				uint64_t retired_epoch;
+			};
+
+			struct alignas(64) _impl_Slot
+			{
+				std::atomic<uint64_t> epoch{ idle_v };
+				std::atomic<bool> claimed{ false };
+			};
+
+			alignas(64) std::atomic<_impl_Node*> _current;
+			alignas(64) std::atomic<uint64_t> _epoch;
+			uint64_t _version;
+			std::vector<_impl_Node*> _retired;
+			_impl_Slot _slots[MaxReaders];
+
+			auto _impl_OldestActiveEpoch() const -> uint64_t
+			{
+				uint64_t oldest = idle_v;
+				for (auto const& slot : _slots)
+				{
+					oldest = std::min(oldest, slot.epoch.load(std::memory_order_seq_cst));
+				}
+				return oldest;
+			}
+
+		public:
+			class Reader;
+
+			class Guard
+			{
+			private:
+				Reader* _reader;
+				_impl_Node const* _node;
+
+			public:
+				Guard(Reader* reader, _impl_Node const* node) : _reader{ reader }, _node{ node } {}
+
+				Guard(Guard&& other) noexcept : _reader{ std::exchange(other._reader, nullptr) }, _node{ other._node } {}
+
+				Guard(Guard const&) = delete;
+				auto operator=(Guard const&) -> Guard & = delete;
+				auto operator=(Guard&&) -> Guard & = delete;
+
+				~Guard()
+				{
+					if (_reader)
+					{
+						_reader->_impl_Leave();
+					}
+				}
+
+				auto operator*() const -> T const&
+				{
+					return _node->value;
+				}
+
+				auto operator->() const -> T const*
+				{
+					return &_node->value;
+				}
+
+				auto Version() const -> uint64_t
+				{
+					return _node->version;
+				}
+			};
+
+			class Reader
+			{
+			private:
+				friend class Guard;
+
+				Cell* _cell;
+				size_t _slot;
+				size_t _depth;
+
+				auto _impl_Leave() -> void
+				{
+					if (--_depth == 0)
+					{
+						_cell->_slots[_slot].epoch.store(idle_v, std::memory_order_release);
+					}
+				}
+
+			public:
+				Reader(Cell& cell) : _cell{ &cell }, _slot{ MaxReaders }, _depth{ 0 }
+				{
+					for (size_t i = 0; i < MaxReaders; i++)
+					{
+						bool expected = false;
+						if (cell._slots[i].claimed.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+						{
+							_slot = i;
+							return;
+						}
+					}
+					throw std::length_error{ "snapshot cell supports at most " + std::to_string(MaxReaders) + " concurrent readers" };
+				}
+
+				Reader(Reader const&) = delete;
+				auto operator=(Reader const&) -> Reader & = delete;
+
+				~Reader()
+				{
+					_cell->_slots[_slot].epoch.store(idle_v, std::memory_order_release);
+					_cell->_slots[_slot].claimed.store(false, std::memory_order_release);
+				}
+
+				auto Read() -> Guard
+				{
+					if (_depth++ == 0)
+					{
+						_cell->_slots[_slot].epoch.store(_cell->_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+					}
+					return Guard{ this, _cell->_current.load(std::memory_order_seq_cst) };
+				}
+			};
+
+			Cell(T initial) : _current{ new _impl_Node{ std::move(initial), 0, 0 } }, _epoch{ 1 }, _version{ 0 } {}
+
+			Cell(Cell const&) = delete;
+			auto operator=(Cell const&) -> Cell & = delete;
+
+			~Cell()
+			{
+				delete _current.load(std::memory_order_acquire);
+				for (auto* node : _retired)
+				{
+					delete node;
+				}
+			}
+
+			auto Publish(T value) -> uint64_t
+			{
+				auto* const node = new _impl_Node{ std::move(value), ++_version, 0 };
+				auto* const old = _current.exchange(node, std::memory_order_seq_cst);
+				old->retired_epoch = _epoch.fetch_add(1, std::memory_order_seq_cst);
+				_retired.push_back(old);
+				Reclaim();
+				return _version;
+			}
+
+			auto Reclaim() -> size_t
+			{
+				uint64_t const oldest = _impl_OldestActiveEpoch();
+				auto const reclaimable = std::stable_partition(_retired.begin(), _retired.end(), [oldest](_impl_Node const* node) { return node->retired_epoch >= oldest; });
+				size_t const reclaimed = static_cast<size_t>(_retired.end() - reclaimable);
+				for (auto it = reclaimable; it != _retired.end(); ++it)
+				{
+					delete *it;
+				}
+				_retired.erase(reclaimable, _retired.end());
+				return reclaimed;
+			}
+
+			auto Pending() const -> size_t
+			{
+				return _retired.size();
+			}
+
+			auto Version() const -> uint64_t
+			{
+				return _version;
+			}
+		};
+
+		struct Parameters
+		{
+			uint64_t step;
+			std::vector<double> values;
+		};
+
+		template <size_t MaxReaders = 64>
+		class ParameterPublisher
+		{
+		private:
+			VariableBinding _binding;
+			Cell<Parameters, MaxReaders> _cell;
+
+			auto _impl_Capture(uint64_t step) const -> Parameters
+			{
+				Parameters parameters{ step, std::vector<double>(_binding.Size()) };
+				_binding.Read(parameters.values.data());
+				return parameters;
+			}
+
+		public:
+			using reader_t = typename Cell<Parameters, MaxReaders>::Reader;
+
+			template <typename E>
+			ParameterPublisher(E& expr) : _binding{ expr }, _cell{ _impl_Capture(0) } {}
+
+			auto Publish(uint64_t step) -> uint64_t
+			{
+				return _cell.Publish(_impl_Capture(step));
+			}
+
+			auto MakeReader() -> reader_t
+			{
+				return reader_t{ _cell };
+			}
+
+			auto GetCell() -> Cell<Parameters, MaxReaders>&
+			{
+				return _cell;
+			}
+		};
+	}
+}
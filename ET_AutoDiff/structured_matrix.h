@@ -0,0 +1,559 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <ostream>
+#include <type_traits>
+#include "tensor.h"
+
+namespace Num
+{
+	enum class Triangle { Lower, Upper };
+
+	struct _impl_Structured {};
+
+	template <typename T>
+	constexpr bool is_structured_v = std::is_base_of_v<_impl_Structured, T>;
+
+	template <typename T>
+	constexpr bool is_entrywise_v = false;
+
+	template <typename D, typename V, size_t Count>
+	class StructuredMatrix : private Tensor, private _impl_Structured
+	{
+	public:
+		using num_type = V;
+		constexpr static size_t coefficients_v = Count;
+
+	protected:
+		std::array<V, Count> _values;
+
+	public:
+		constexpr StructuredMatrix(V const& value = 0.0) : _values{}
+		{
+			for (size_t i = 0; i < Count; i++)
+			{
+				_values[i] = value;
+			}
+		}
+
+		constexpr StructuredMatrix(std::array<V, Count> const& values) : _values{ values } {}
+
+		constexpr auto GetValues() const -> std::array<V, Count> const&
+		{
+			return _values;
+		}
+
+		constexpr auto operator[](size_t coefficient) -> V&
+		{
+			return _values[coefficient];
+		}
+
+		constexpr auto operator[](size_t coefficient) const -> V const&
+		{
+			return _values[coefficient];
+		}
+
+		constexpr auto operator+=(D const& other) -> D &
+		{
+			static_assert(is_entrywise_v<D>, "LowRank coefficients are factors, update them through map_coefficients");
+			for (size_t i = 0; i < Count; i++)
+			{
+				_values[i] += other[i];
+			}
+			return static_cast<D&>(*this);
+		}
+
+		constexpr auto operator-=(D const& other) -> D &
+		{
+			static_assert(is_entrywise_v<D>, "LowRank coefficients are factors, update them through map_coefficients");
+			for (size_t i = 0; i < Count; i++)
+			{
+				_values[i] -= other[i];
+			}
+			return static_cast<D&>(*this);
+		}
+	};
+
+	template <typename V, size_t N>
+	class Diagonal : public StructuredMatrix<Diagonal<V, N>, V, N>
+	{
+	public:
+		constexpr static size_t rows_v = N;
+		constexpr static size_t columns_v = N;
+
+		using StructuredMatrix<Diagonal<V, N>, V, N>::StructuredMatrix;
+
+		constexpr auto operator()(size_t i, size_t j) const -> V
+		{
+			return i == j ? this->_values[i] : V{ 0 };
+		}
+
+		constexpr auto Inverse() const -> Diagonal
+		{
+			Diagonal result;
+			for (size_t i = 0; i < N; i++)
+			{
+				result[i] = 1.0 / this->_values[i];
+			}
+			return result;
+		}
+	};
+
+	template <typename V, size_t N>
+	constexpr bool is_entrywise_v<Diagonal<V, N>> = true;
+
+	template <size_t N, size_t L, size_t U>
+	constexpr auto _impl_band_offset(int k) -> size_t
+	{
+		size_t offset = 0;
+		for (int d = -static_cast<int>(L); d < k; d++)
+		{
+			offset += N - static_cast<size_t>(d < 0 ? -d : d);
+		}
+		return offset;
+	}
+
+	template <typename V, size_t N, size_t L, size_t U>
+	class Banded : public StructuredMatrix<Banded<V, N, L, U>, V, _impl_band_offset<N, L, U>(static_cast<int>(U) + 1)>
+	{
+	public:
+		static_assert(L < N && U < N);
+		constexpr static size_t rows_v = N;
+		constexpr static size_t columns_v = N;
+		constexpr static size_t lower_v = L;
+		constexpr static size_t upper_v = U;
+
+		using StructuredMatrix<Banded<V, N, L, U>, V, _impl_band_offset<N, L, U>(static_cast<int>(U) + 1)>::StructuredMatrix;
+
+		constexpr static auto InBand(size_t i, size_t j) -> bool
+		{
+			return j + L >= i && i + U >= j;
+		}
+
+		constexpr static auto Index(size_t i, size_t j) -> size_t
+		{
+			return _impl_band_offset<N, L, U>(static_cast<int>(j) - static_cast<int>(i)) + std::min(i, j);
+		}
+
+		constexpr auto operator()(size_t i, size_t j) -> V&
+		{
+			return this->_values[Index(i, j)];
+		}
+
+		constexpr auto operator()(size_t i, size_t j) const -> V
+		{
+			return InBand(i, j) ? this->_values[Index(i, j)] : V{ 0 };
+		}
+
+		constexpr auto Band(int k) -> V*
+		{
+			return this->_values.data() + _impl_band_offset<N, L, U>(k);
+		}
+
+		constexpr auto Band(int k) const -> V const*
+		{
+			return this->_values.data() + _impl_band_offset<N, L, U>(k);
+		}
+	};
+
+	template <typename V, size_t N, size_t L, size_t U>
+	constexpr bool is_entrywise_v<Banded<V, N, L, U>> = true;
+
+	template <typename V, size_t N, Triangle T>
+	class Triangular : public StructuredMatrix<Triangular<V, N, T>, V, N * (N + 1) / 2>
+	{
+	public:
+		constexpr static size_t rows_v = N;
+		constexpr static size_t columns_v = N;
+		constexpr static Triangle triangle_v = T;
+
+		using StructuredMatrix<Triangular<V, N, T>, V, N * (N + 1) / 2>::StructuredMatrix;
+
+		constexpr static auto InTriangle(size_t i, size_t j) -> bool
+		{
+			return T == Triangle::Lower ? i >= j : i <= j;
+		}
+
+		constexpr static auto Index(size_t i, size_t j) -> size_t
+		{
+			if constexpr (T == Triangle::Lower)
+			{
+				return i - j + j * (2 * N - j + 1) / 2;
+			}
+			else
+			{
+				return i + j * (j + 1) / 2;
+			}
+		}
+
+		constexpr auto operator()(size_t i, size_t j) -> V&
+		{
+			return this->_values[Index(i, j)];
+		}
+
+		constexpr auto operator()(size_t i, size_t j) const -> V
+		{
+			return InTriangle(i, j) ? this->_values[Index(i, j)] : V{ 0 };
+		}
+
+		constexpr auto Column(size_t j) const -> V const*
+		{
+			return this->_values.data() + Index(T == Triangle::Lower ? j : 0, j);
+		}
+	};
+
+	template <typename V, size_t N, Triangle T>
+	constexpr bool is_entrywise_v<Triangular<V, N, T>> = true;
+
+	template <typename V, size_t N, size_t M, size_t R>
+	class LowRank : public StructuredMatrix<LowRank<V, N, M, R>, V, (N + M) * R>
+	{
+	public:
+		static_assert(R > 0);
+		constexpr static size_t rows_v = N;
+		constexpr static size_t columns_v = M;
+		constexpr static size_t rank_v = R;
+
+		using StructuredMatrix<LowRank<V, N, M, R>, V, (N + M) * R>::StructuredMatrix;
+
+		constexpr auto Left(size_t i, size_t r) -> V&
+		{
+			return this->_values[i + r * N];
+		}
+
+		constexpr auto Left(size_t i, size_t r) const -> V const&
+		{
+			return this->_values[i + r * N];
+		}
+
+		constexpr auto Right(size_t j, size_t r) -> V&
+		{
+			return this->_values[N * R + j + r * M];
+		}
+
+		constexpr auto Right(size_t j, size_t r) const -> V const&
+		{
+			return this->_values[N * R + j + r * M];
+		}
+
+		constexpr auto operator()(size_t i, size_t j) const -> V
+		{
+			V result{ 0 };
+			for (size_t r = 0; r < R; r++)
+			{
+				result += Left(i, r) * Right(j, r);
+			}
+			return result;
+		}
+	};
+
+	template <typename S, typename = std::enable_if_t<is_structured_v<S>>>
+	auto ToDense(S const& matrix)
+	{
+		auto result = TTest::TensorFactory::MakeZeroTensor<typename S::num_type, S::rows_v, S::columns_v>();
+		for (size_t j = 0; j < S::columns_v; j++)
+		{
+			for (size_t i = 0; i < S::rows_v; i++)
+			{
+				result(i, j) = matrix(i, j);
+			}
+		}
+		return result;
+	}
+
+	template <typename S, typename F, typename = std::enable_if_t<is_structured_v<S>>>
+	constexpr auto map_coefficients(S const& first, F&& function) -> S
+	{
+		S result;
+		for (size_t i = 0; i < S::coefficients_v; i++)
+		{
+			result[i] = function(first[i]);
+		}
+		return result;
+	}
+
+	template <typename S, typename F, typename = std::enable_if_t<is_structured_v<S>>>
+	constexpr auto map_coefficients(S const& first, S const& second, F&& function) -> S
+	{
+		S result;
+		for (size_t i = 0; i < S::coefficients_v; i++)
+		{
+			result[i] = function(first[i], second[i]);
+		}
+		return result;
+	}
+
+	template <typename S, typename = std::enable_if_t<is_entrywise_v<S>>>
+	constexpr auto operator+(S const& first, S const& second) -> S
+	{
+		return map_coefficients(first, second, [](auto x, auto y) { return x + y; });
+	}
+
+	template <typename S, typename = std::enable_if_t<is_entrywise_v<S>>>
+	constexpr auto operator-(S const& first, S const& second) -> S
+	{
+		return map_coefficients(first, second, [](auto x, auto y) { return x - y; });
+	}
+
+	template <typename S, typename = std::enable_if_t<is_entrywise_v<S>>>
+	constexpr auto operator-(S const& first) -> S
+	{
+		return map_coefficients(first, [](auto x) { return -x; });
+	}
+
+	template <typename S, typename = std::enable_if_t<is_entrywise_v<S>>>
+	constexpr auto operator*(S const& first, S const& second) -> S
+	{
+		return map_coefficients(first, second, [](auto x, auto y) { return x * y; });
+	}
+
+	template <typename A, typename S, typename = std::enable_if_t<std::is_arithmetic_v<A> && is_entrywise_v<S>>>
+	constexpr auto operator*(A scalar, S const& first) -> S
+	{
+		return map_coefficients(first, [scalar](auto x) { return scalar * x; });
+	}
+
+	template <typename S, typename = std::enable_if_t<is_entrywise_v<S>>>
+	constexpr auto sin(S const& first) -> S
+	{
+		return map_coefficients(first, [](auto x) { return std::sin(x); });
+	}
+
+	template <typename S, typename = std::enable_if_t<is_entrywise_v<S>>>
+	constexpr auto tan(S const& first) -> S
+	{
+		return map_coefficients(first, [](auto x) { return std::tan(x); });
+	}
+
+	template <typename S, typename = std::enable_if_t<is_entrywise_v<S>>>
+	auto operator/(S const& first, S const& second)
+	{
+		return ToDense(first) / ToDense(second);
+	}
+
+	template <typename S, typename = std::enable_if_t<is_entrywise_v<S>>>
+	auto pow(S const& first, S const& second)
+	{
+		return TTest::pow(ToDense(first), ToDense(second));
+	}
+
+	template <typename S, typename = std::enable_if_t<is_entrywise_v<S>>>
+	auto cos(S const& first)
+	{
+		return TTest::cos(ToDense(first));
+	}
+
+	template <typename S, typename = std::enable_if_t<is_entrywise_v<S>>>
+	auto sec(S const& first)
+	{
+		return TTest::sec(ToDense(first));
+	}
+
+	template <typename S, typename = std::enable_if_t<is_entrywise_v<S>>>
+	auto log(S const& first)
+	{
+		return TTest::log(ToDense(first));
+	}
+
+	template <typename S, typename = std::enable_if_t<is_structured_v<S>>>
+	auto operator<<(std::ostream& stream, S const& matrix) -> std::ostream&
+	{
+		stream << '[';
+		for (size_t i = 0; i < S::coefficients_v; i++)
+		{
+			stream << (i > 0 ? ", " : "") << matrix[i];
+		}
+		return stream << ']';
+	}
+
+	template <typename V1, typename V2>
+	using _impl_product_t = std::decay_t<decltype(std::declval<V1>() * std::declval<V2>())>;
+
+	template <typename V1, typename V2, size_t N, size_t K>
+	auto matmul(Diagonal<V1, N> const& first, TTest::Tensor<V2, TTest::i_integrals_t<2>, N, K> const& second)
+	{
+		ET_PERF_SCOPE("Num::matmul_diagonal", sizeof(V1) * N + (sizeof(V2) + sizeof(_impl_product_t<V1, V2>)) * N * K);
+		auto result = TTest::TensorFactory::MakeZeroTensor<_impl_product_t<V1, V2>, N, K>();
+		V2 const* b = second.cbegin();
+		auto* c = result.cbegin();
+		for (size_t j = 0; j < K; j++)
+		{
+			for (size_t i = 0; i < N; i++)
+			{
+				c[i + j * N] = first[i] * b[i + j * N];
+			}
+		}
+		return result;
+	}
+
+	template <typename V1, typename V2, size_t N, size_t K>
+	auto solve(Diagonal<V1, N> const& first, TTest::Tensor<V2, TTest::i_integrals_t<2>, N, K> const& second)
+	{
+		ET_PERF_SCOPE("Num::solve_diagonal", sizeof(V1) * N + (sizeof(V2) + sizeof(_impl_product_t<V1, V2>)) * N * K);
+		auto result = TTest::TensorFactory::MakeZeroTensor<_impl_product_t<V1, V2>, N, K>();
+		V2 const* b = second.cbegin();
+		auto* c = result.cbegin();
+		for (size_t j = 0; j < K; j++)
+		{
+			for (size_t i = 0; i < N; i++)
+			{
+				c[i + j * N] = b[i + j * N] / first[i];
+			}
+		}
+		return result;
+	}
+
+	template <typename V1, typename V2, size_t N, size_t L, size_t U, size_t K>
+	auto matmul(Banded<V1, N, L, U> const& first, TTest::Tensor<V2, TTest::i_integrals_t<2>, N, K> const& second)
+	{
+		using value_t = _impl_product_t<V1, V2>;
+		ET_PERF_SCOPE("Num::matmul_banded", sizeof(V1) * first.coefficients_v + (sizeof(V2) + sizeof(value_t)) * N * K);
+		auto result = TTest::TensorFactory::MakeZeroTensor<value_t, N, K>();
+		V2 const* b = second.cbegin();
+		value_t* c = result.cbegin();
+		for (size_t j = 0; j < K; j++)
+		{
+			for (int k = -static_cast<int>(L); k <= static_cast<int>(U); k++)
+			{
+				V1 const* band = first.Band(k);
+				size_t const row_begin = k < 0 ? static_cast<size_t>(-k) : 0;
+				size_t const row_end = k > 0 ? N - static_cast<size_t>(k) : N;
+				for (size_t i = row_begin; i < row_end; i++)
+				{
+					c[i + j * N] += band[i - row_begin] * b[i + k + j * N];
+				}
+			}
+		}
+		return result;
+	}
+
+	template <typename V1, typename V2, size_t N, size_t L, size_t U, size_t K>
+	auto solve(Banded<V1, N, L, U> const& first, TTest::Tensor<V2, TTest::i_integrals_t<2>, N, K> const& second)
+	{
+		using value_t = _impl_product_t<V1, V2>;
+		ET_PERF_SCOPE("Num::solve_banded", sizeof(V1) * first.coefficients_v + (sizeof(V2) + sizeof(value_t)) * N * K);
+		Banded<V1, N, L, U> lu{ first };
+		auto result = TTest::TensorFactory::MakeZeroTensor<value_t, N, K>();
+		std::copy(second.cbegin(), second.cend(), result.cbegin());
+		value_t* x = result.cbegin();
+		for (size_t p = 0; p < N; p++)
+		{
+			for (size_t i = p + 1; i <= std::min(N - 1, p + L); i++)
+			{
+				V1 const factor = lu(i, p) / lu(p, p);
+				for (size_t j = p + 1; j <= std::min(N - 1, p + U); j++)
+				{
+					lu(i, j) -= factor * lu(p, j);
+				}
+				for (size_t column = 0; column < K; column++)
+				{
+					x[i + column * N] -= factor * x[p + column * N];
+				}
+			}
+		}
+		for (size_t column = 0; column < K; column++)
+		{
+			value_t* b = x + column * N;
+			for (size_t i = N; i-- > 0;)
+			{
+				for (size_t j = i + 1; j <= std::min(N - 1, i + U); j++)
+				{
+					b[i] -= lu(i, j) * b[j];
+				}
+				b[i] /= lu(i, i);
+			}
+		}
+		return result;
+	}
+
+	template <typename V1, typename V2, size_t N, Triangle T, size_t K>
+	auto matmul(Triangular<V1, N, T> const& first, TTest::Tensor<V2, TTest::i_integrals_t<2>, N, K> const& second)
+	{
+		using value_t = _impl_product_t<V1, V2>;
+		ET_PERF_SCOPE("Num::matmul_triangular", sizeof(V1) * first.coefficients_v + (sizeof(V2) + sizeof(value_t)) * N * K);
+		auto result = TTest::TensorFactory::MakeZeroTensor<value_t, N, K>();
+		V2 const* b = second.cbegin();
+		value_t* c = result.cbegin();
+		for (size_t j = 0; j < K; j++)
+		{
+			for (size_t p = 0; p < N; p++)
+			{
+				V1 const* column = first.Column(p);
+				value_t const factor = b[p + j * N];
+				size_t const row_begin = T == Triangle::Lower ? p : 0;
+				size_t const row_end = T == Triangle::Lower ? N : p + 1;
+				for (size_t i = row_begin; i < row_end; i++)
+				{
+					c[i + j * N] += column[i - row_begin] * factor;
+				}
+			}
+		}
+		return result;
+	}
+
+	template <typename V1, typename V2, size_t N, Triangle T, size_t K>
+	auto solve(Triangular<V1, N, T> const& first, TTest::Tensor<V2, TTest::i_integrals_t<2>, N, K> const& second)
+	{
+		using value_t = _impl_product_t<V1, V2>;
+		ET_PERF_SCOPE("Num::solve_triangular", sizeof(V1) * first.coefficients_v + (sizeof(V2) + sizeof(value_t)) * N * K);
+		auto result = TTest::TensorFactory::MakeZeroTensor<value_t, N, K>();
+		std::copy(second.cbegin(), second.cend(), result.cbegin());
+		for (size_t j = 0; j < K; j++)
+		{
+			value_t* x = result.cbegin() + j * N;
+			if constexpr (T == Triangle::Lower)
+			{
+				for (size_t p = 0; p < N; p++)
+				{
+					V1 const* column = first.Column(p);
+					x[p] /= column[0];
+					for (size_t i = p + 1; i < N; i++)
+					{
+						x[i] -= column[i - p] * x[p];
+					}
+				}
+			}
+			else
+			{
+				for (size_t p = N; p-- > 0;)
+				{
+					V1 const* column = first.Column(p);
+					x[p] /= column[p];
+					for (size_t i = 0; i < p; i++)
+					{
+						x[i] -= column[i] * x[p];
+					}
+				}
+			}
+		}
+		return result;
+	}
+
+	template <typename V1, typename V2, size_t N, size_t M, size_t R, size_t K>
+	auto matmul(LowRank<V1, N, M, R> const& first, TTest::Tensor<V2, TTest::i_integrals_t<2>, M, K> const& second)
+	{
+		using value_t = _impl_product_t<V1, V2>;
+		ET_PERF_SCOPE("Num::matmul_low_rank", sizeof(V1) * first.coefficients_v + sizeof(V2) * M * K + sizeof(value_t) * N * K);
+		auto result = TTest::TensorFactory::MakeZeroTensor<value_t, N, K>();
+		V2 const* b = second.cbegin();
+		value_t* c = result.cbegin();
+		for (size_t j = 0; j < K; j++)
+		{
+			for (size_t r = 0; r < R; r++)
+			{
+				value_t projection{ 0 };
+				for (size_t p = 0; p < M; p++)
+				{
+					projection += first.Right(p, r) * b[p + j * M];
+				}
+				for (size_t i = 0; i < N; i++)
+				{
+					c[i + j * N] += first.Left(i, r) * projection;
+				}
+			}
+		}
+		return result;
+	}
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include "thread_pool.h"
+
+namespace Et {
+
+	struct SweepJob
+	{
+		size_t id;
+		double learning_rate;
+		std::vector<double> initial_values;
+	};
+
+	struct SweepOptions
+	{
+		size_t threads = std::max(1u, std::thread::hardware_concurrency());
+		int iterations = 1000;
+		int min_iterations = 100;
+		int reduction_factor = 3;
+		bool successive_halving = true;
+	};
+
+	struct SweepResult
+	{
+		SweepJob job;
+		double loss;
+		int iterations;
+		bool stopped_early;
+		bool diverged;
+		double seconds;
+	};
+
+	class _impl_SweepRungs
+	{
+	private:
+		SweepOptions const& _options;
+		std::mutex _mutex;
+		std::map<int, std::vector<double>> _losses;
+
+	public:
+		_impl_SweepRungs(SweepOptions const& options) : _options{ options } {}
+
+		auto IsRung(int iteration) const -> bool
+		{
+			if (!_options.successive_halving || _options.reduction_factor < 2 || iteration >= _options.iterations)
+			{
+				return false;
+			}
+			for (long long rung = _options.min_iterations; rung < _options.iterations; rung *= _options.reduction_factor)
+			{
+				if (rung == iteration)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		auto Promote(int iteration, double loss) -> bool
+		{
+			if (!std::isfinite(loss))
+			{
+				return false;
+			}
+			std::lock_guard<std::mutex> lock{ _mutex };
+			auto& losses = _losses[iteration];
+			losses.insert(std::upper_bound(losses.begin(), losses.end(), loss), loss);
+
+			size_t const keep = losses.size() / _options.reduction_factor;
+			if (keep == 0)
+			{
+				return true;
+			}
+			return loss <= losses[keep - 1];
+		}
+	};
+
+	class SweepControl
+	{
+	private:
+		SweepJob const& _job;
+		_impl_SweepRungs& _rungs;
+		int _iterations;
+		int _last_iteration;
+		double _last_loss;
+		bool _stopped;
+		bool _diverged;
+
+	public:
+		SweepControl(SweepJob const& job, _impl_SweepRungs& rungs, int iterations)
+			: _job{ job }, _rungs{ rungs }, _iterations{ iterations }, _last_iteration{ 0 },
+			_last_loss{ std::numeric_limits<double>::quiet_NaN() }, _stopped{ false }, _diverged{ false } {}
+
+		auto Job() const -> SweepJob const&
+		{
+			return _job;
+		}
+
+		auto Iterations() const -> int
+		{
+			return _iterations;
+		}
+
+		auto Report(int iteration, double loss) -> bool
+		{
+			_last_iteration = iteration;
+			_last_loss = loss;
+
+			if (!std::isfinite(loss))
+			{
+				_stopped = true;
+				_diverged = true;
+			}
+			else if (_rungs.IsRung(iteration))
+			{
+				_stopped = !_rungs.Promote(iteration, loss);
+			}
+			return !_stopped && iteration < _iterations;
+		}
+
+		auto LastIteration() const -> int
+		{
+			return _last_iteration;
+		}
+
+		auto LastLoss() const -> double
+		{
+			return _last_loss;
+		}
+
+		auto Stopped() const -> bool
+		{
+			return _stopped;
+		}
+
+		auto Diverged() const -> bool
+		{
+			return _diverged;
+		}
+	};
+
+	class SweepRunner
+	{
+	private:
+		SweepOptions _options;
+
+	public:
+		SweepRunner(SweepOptions const& options = {}) : _options{ options }
+		{
+			if (_options.iterations < 1 || _options.min_iterations < 1 || _options.threads == 0)
+			{
+				throw std::invalid_argument{ "sweep needs at least one iteration, one iteration before the first rung and one thread" };
+			}
+		}
+
+		template <typename F>
+		auto Run(std::vector<SweepJob> const& jobs, F&& job_function) -> std::vector<SweepResult>
+		{
+			std::vector<SweepResult> results(jobs.size());
+			_impl_SweepRungs rungs{ _options };
+			ThreadPool pool{ _options.threads };
+			TaskGroup group{ pool };
+
+			for (size_t i = 0; i < jobs.size(); i++)
+			{
+				group.Run([&, i]()
+				{
+					auto begin = std::chrono::steady_clock::now();
+					SweepControl control{ jobs[i], rungs, _options.iterations };
+					double loss = job_function(control);
+					auto end = std::chrono::steady_clock::now();
+
+					bool const diverged = control.Diverged() || !std::isfinite(loss);
+					results[i] = { jobs[i], loss, control.LastIteration(), control.Stopped() && !diverged, diverged,
+						std::chrono::duration<double>(end - begin).count() };
+				});
+			}
+			group.Wait();
+
+			std::stable_sort(results.begin(), results.end(), [](SweepResult const& first, SweepResult const& second)
+			{
+				if (first.diverged != second.diverged)
+				{
+					return !first.diverged;
+				}
+				if (first.stopped_early != second.stopped_early)
+				{
+					return !first.stopped_early;
+				}
+				return first.loss < second.loss;
+			});
+			return results;
+		}
+	};
+
+	inline auto MakeSweepJobs(std::vector<double> const& learning_rates, std::vector<std::vector<double>> const& initial_values) -> std::vector<SweepJob>
+	{
+		std::vector<SweepJob> jobs;
+		for (double learning_rate : learning_rates)
+		{
+			for (auto const& values : initial_values)
+			{
+				jobs.push_back({ jobs.size(), learning_rate, values });
+			}
+		}
+		return jobs;
+	}
+
+	inline auto PrintSweepTable(std::ostream& stream, std::vector<SweepResult> const& results) -> void
+	{
+		stream << std::left << std::setw(6) << "job" << std::setw(12) << "lr" << std::setw(28) << "init"
+			<< std::setw(16) << "loss" << std::setw(8) << "iters" << std::setw(9) << "status" << "time" << '\n';
+
+		for (auto const& result : results)
+		{
+			std::ostringstream init;
+			init << std::setprecision(4);
+			for (size_t i = 0; i < result.job.initial_values.size(); i++)
+			{
+				init << (i > 0 ? "," : "") << result.job.initial_values[i];
+			}
+			stream << std::left << std::setw(6) << result.job.id << std::setw(12) << result.job.learning_rate << std::setw(28) << init.str()
+				<< std::setw(16) << result.loss << std::setw(8) << result.iterations
+				<< std::setw(9) << (result.diverged ? "diverged" : result.stopped_early ? "halved" : "done") << result.seconds * 1e3 << "ms\n";
+		}
+	}
+}
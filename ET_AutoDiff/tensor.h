@@ -1,9 +1,14 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <array>
+#include <memory>
 #include <type_traits>
 #include <random>
+#include <ostream>
+#include "perf_counters.h"
+#include "tensor_allocations.h"
 
 namespace Num
 {
@@ -74,20 +79,112 @@ namespace Num
 	Scalar(long long const&)->Scalar<long double>;
 	Scalar(long double const&)->Scalar<long double>;
 
+	template <typename V, size_t N>
+	class Pack : private Tensor
+	{
+	public:
+		static_assert(N > 0 && (N & (N - 1)) == 0);
+		using num_type = V;
+		constexpr static size_t lanes_v = N;
+		constexpr static size_t alignment_v = sizeof(V) * N < 64 ? sizeof(V) * N : 64;
+
+	private:
+		alignas(alignment_v) std::array<V, N> _values;
+
+	public:
+		constexpr Pack(V const& value = 0.0) : _values{}
+		{
+			for (size_t i = 0; i < N; i++)
+			{
+				_values[i] = value;
+			}
+		}
+
+		constexpr Pack(std::array<V, N> const& values) : _values{ values } {}
+
+		constexpr auto Inverse() const -> Pack<V, N>
+		{
+			Pack<V, N> result;
+			for (size_t i = 0; i < N; i++)
+			{
+				result[i] = 1.0 / _values[i];
+			}
+			return result;
+		}
+
+		constexpr auto GetValues() const -> std::array<V, N> const&
+		{
+			return _values;
+		}
+
+		constexpr auto operator[](size_t lane) -> V&
+		{
+			return _values[lane];
+		}
+
+		constexpr auto operator[](size_t lane) const -> V const&
+		{
+			return _values[lane];
+		}
+
+		constexpr auto operator+=(Pack<V, N> const& other) -> Pack<V, N> &
+		{
+			for (size_t i = 0; i < N; i++)
+			{
+				_values[i] += other[i];
+			}
+			return *this;
+		}
+
+		constexpr auto operator-=(Pack<V, N> const& other) -> Pack<V, N> &
+		{
+			for (size_t i = 0; i < N; i++)
+			{
+				_values[i] -= other[i];
+			}
+			return *this;
+		}
+	};
+
 	template <typename T, typename = std::enable_if_t<is_tensor_v<T>>>
 	constexpr T zero_v = T{};
 
 	template <typename T, typename = std::enable_if_t<is_tensor_v<T>>>
 	constexpr T identity_v = T{ 1.0 };
 
+	struct One {};
+
+	template <typename T>
+	constexpr bool is_symbolic_v = std::is_same_v<std::decay_t<T>, One>;
+
+	constexpr auto operator*(One, One) -> One { return {}; }
+
+	template <typename T, typename = std::enable_if_t<!is_symbolic_v<T>>>
+	constexpr auto operator*(T const& value, One) -> T const& { return value; }
+
+	template <typename T, typename = std::enable_if_t<!is_symbolic_v<T>>>
+	constexpr auto operator*(One, T const& value) -> T const& { return value; }
+
+	template <typename T, typename = std::enable_if_t<!is_symbolic_v<T> && !std::is_reference_v<T>>>
+	auto operator*(T&&, One) -> T = delete;
+
+	template <typename T, typename = std::enable_if_t<!is_symbolic_v<T> && !std::is_reference_v<T>>>
+	auto operator*(One, T&&) -> T = delete;
+
+	template <typename T>
+	constexpr auto Materialize(One) -> T { return identity_v<T>; }
+
+	template <typename T>
+	constexpr auto Materialize(T const& value) -> T { return value; }
+
 	template <typename V1, typename V2>
-	constexpr auto operator+(Scalar<V1> const& first, Scalar<V2> const& second) -> Scalar<typename num_result_t<V1, V2>>
+	constexpr auto operator+(Scalar<V1> const& first, Scalar<V2> const& second) -> Scalar<num_result_t<V1, V2>>
 	{
 		return { first.GetValue() + second.GetValue() };
 	}
 
 	template <typename V1, typename V2>
-	constexpr auto operator-(Scalar<V1> const& first, Scalar<V2> const& second) -> Scalar<typename num_result_t<V1, V2>>
+	constexpr auto operator-(Scalar<V1> const& first, Scalar<V2> const& second) -> Scalar<num_result_t<V1, V2>>
 	{
 		return { first.GetValue() - second.GetValue() };
 	}
@@ -99,19 +196,19 @@ namespace Num
 	}
 
 	template <typename V1, typename V2>
-	constexpr auto operator*(Scalar<V1> const& first, Scalar<V2> const& second) -> Scalar<typename num_result_t<V1, V2>>
+	constexpr auto operator*(Scalar<V1> const& first, Scalar<V2> const& second) -> Scalar<num_result_t<V1, V2>>
 	{
 		return { first.GetValue() * second.GetValue() };
 	}
 
 	template <typename V1, typename V2>
-	constexpr auto operator/(Scalar<V1> const& first, Scalar<V2> const& second) -> Scalar<typename num_result_t<V1, V2>>
+	constexpr auto operator/(Scalar<V1> const& first, Scalar<V2> const& second) -> Scalar<num_result_t<V1, V2>>
 	{
 		return { first.GetValue() / second.GetValue() };
 	}
 
 	template <typename V1, typename V2>
-	constexpr auto pow(Scalar<V1> const& first, Scalar<V2> const& second) -> Scalar<typename num_result_t<V1, V2>>
+	constexpr auto pow(Scalar<V1> const& first, Scalar<V2> const& second) -> Scalar<num_result_t<V1, V2>>
 	{
 		return { std::pow(first.GetValue(),second.GetValue()) };
 	}
@@ -145,6 +242,149 @@ namespace Num
 	{
 		return { std::log(first.GetValue()) };
 	}
+
+	template <typename V1, typename V2, size_t N>
+	constexpr auto operator+(Pack<V1, N> const& first, Pack<V2, N> const& second) -> Pack<num_result_t<V1, V2>, N>
+	{
+		Pack<num_result_t<V1, V2>, N> result;
+		for (size_t i = 0; i < N; i++)
+		{
+			result[i] = first[i] + second[i];
+		}
+		return result;
+	}
+
+	template <typename V1, typename V2, size_t N>
+	constexpr auto operator-(Pack<V1, N> const& first, Pack<V2, N> const& second) -> Pack<num_result_t<V1, V2>, N>
+	{
+		Pack<num_result_t<V1, V2>, N> result;
+		for (size_t i = 0; i < N; i++)
+		{
+			result[i] = first[i] - second[i];
+		}
+		return result;
+	}
+
+	template <typename V, size_t N>
+	constexpr auto operator-(Pack<V, N> const& first) -> Pack<V, N>
+	{
+		Pack<V, N> result;
+		for (size_t i = 0; i < N; i++)
+		{
+			result[i] = -first[i];
+		}
+		return result;
+	}
+
+	template <typename V1, typename V2, size_t N>
+	constexpr auto operator*(Pack<V1, N> const& first, Pack<V2, N> const& second) -> Pack<num_result_t<V1, V2>, N>
+	{
+		Pack<num_result_t<V1, V2>, N> result;
+		for (size_t i = 0; i < N; i++)
+		{
+			result[i] = first[i] * second[i];
+		}
+		return result;
+	}
+
+	template <typename S, typename V, size_t N, typename = std::enable_if_t<std::is_arithmetic_v<S>>>
+	constexpr auto operator*(S scalar, Pack<V, N> const& first) -> Pack<V, N>
+	{
+		Pack<V, N> result;
+		for (size_t i = 0; i < N; i++)
+		{
+			result[i] = scalar * first[i];
+		}
+		return result;
+	}
+
+	template <typename V1, typename V2, size_t N>
+	constexpr auto operator/(Pack<V1, N> const& first, Pack<V2, N> const& second) -> Pack<num_result_t<V1, V2>, N>
+	{
+		Pack<num_result_t<V1, V2>, N> result;
+		for (size_t i = 0; i < N; i++)
+		{
+			result[i] = first[i] / second[i];
+		}
+		return result;
+	}
+
+	template <typename V1, typename V2, size_t N>
+	constexpr auto pow(Pack<V1, N> const& first, Pack<V2, N> const& second) -> Pack<num_result_t<V1, V2>, N>
+	{
+		Pack<num_result_t<V1, V2>, N> result;
+		for (size_t i = 0; i < N; i++)
+		{
+			result[i] = std::pow(first[i], second[i]);
+		}
+		return result;
+	}
+
+	template <typename V, size_t N>
+	constexpr auto sin(Pack<V, N> const& first) -> Pack<V, N>
+	{
+		Pack<V, N> result;
+		for (size_t i = 0; i < N; i++)
+		{
+			result[i] = std::sin(first[i]);
+		}
+		return result;
+	}
+
+	template <typename V, size_t N>
+	constexpr auto cos(Pack<V, N> const& first) -> Pack<V, N>
+	{
+		Pack<V, N> result;
+		for (size_t i = 0; i < N; i++)
+		{
+			result[i] = std::cos(first[i]);
+		}
+		return result;
+	}
+
+	template <typename V, size_t N>
+	constexpr auto tan(Pack<V, N> const& first) -> Pack<V, N>
+	{
+		Pack<V, N> result;
+		for (size_t i = 0; i < N; i++)
+		{
+			result[i] = std::tan(first[i]);
+		}
+		return result;
+	}
+
+	template <typename V, size_t N>
+	constexpr auto sec(Pack<V, N> const& first) -> Pack<V, N>
+	{
+		Pack<V, N> result;
+		for (size_t i = 0; i < N; i++)
+		{
+			result[i] = 1.0 / std::cos(first[i]);
+		}
+		return result;
+	}
+
+	template <typename V, size_t N>
+	constexpr auto log(Pack<V, N> const& first) -> Pack<V, N>
+	{
+		Pack<V, N> result;
+		for (size_t i = 0; i < N; i++)
+		{
+			result[i] = std::log(first[i]);
+		}
+		return result;
+	}
+
+	template <typename V, size_t N>
+	auto operator<<(std::ostream& stream, Pack<V, N> const& pack) -> std::ostream&
+	{
+		stream << '[';
+		for (size_t i = 0; i < N; i++)
+		{
+			stream << (i > 0 ? ", " : "") << pack[i];
+		}
+		return stream << ']';
+	}
 }
 
 namespace TTest
@@ -273,8 +513,24 @@ namespace TTest
 		using array_t = nD_array_t<V, Ds...>;
 		array_t* _data;
 
+		static auto _impl_Allocate() -> array_t*
+		{
+			AllocationTracker::Instance().OnAllocate(ShapeSlot<V, Ds...>());
+			return new array_t;
+		}
+
+		auto _impl_Free() -> void
+		{
+			if (_data != nullptr)
+			{
+				AllocationTracker::Instance().OnFree(ShapeSlot<V, Ds...>());
+				delete _data;
+				_data = nullptr;
+			}
+		}
+
 	public:
-		constexpr Tensor() : _data{ new array_t } {}
+		constexpr Tensor() : _data{ _impl_Allocate() } {}
 		
 		constexpr Tensor(Tensor<V, i_integrals_t<n_dims_v>, Ds...>&& temp_tensor) : _data{ temp_tensor._data }
 		{
@@ -286,6 +542,32 @@ namespace TTest
 			*_data = *other_tensor._data;
 		}
 
+		auto operator=(Tensor<V, i_integrals_t<n_dims_v>, Ds...>&& temp_tensor) -> Tensor &
+		{
+			if (this != &temp_tensor)
+			{
+				_impl_Free();
+				_data = temp_tensor._data;
+				temp_tensor._data = nullptr;
+			}
+			return *this;
+		}
+
+		auto operator=(Tensor<V, i_integrals_t<n_dims_v>, Ds...> const& other_tensor) -> Tensor &
+		{
+			if (_data == nullptr)
+			{
+				_data = _impl_Allocate();
+			}
+			*_data = *other_tensor._data;
+			return *this;
+		}
+
+		~Tensor()
+		{
+			_impl_Free();
+		}
+
 		constexpr auto operator()(Indices... indices) -> V&
 		{
 			return _impl_get_at_index<Indices...>(indices...);
@@ -378,7 +660,7 @@ namespace TTest
 		{
 			Tensor<V, i_integrals_t<sizeof...(Ds)>, Ds...> tensor;
 			std::uninitialized_fill(tensor.cbegin(), tensor.cend(), V{ 0 });
-			return std::move(tensor);
+			return tensor;
 		}
 
 		template <typename V, size_t... Ds>
@@ -386,7 +668,7 @@ namespace TTest
 		{
 			Tensor<V, i_integrals_t<sizeof...(Ds)>, Ds...> tensor;
 			std::uninitialized_fill(tensor.cbegin(), tensor.cend(), init_value);
-			return std::move(tensor);
+			return tensor;
 		}
 
 		template <typename V, size_t... Ds>
@@ -397,7 +679,7 @@ namespace TTest
 			std::uniform_real_distribution<V> distribution{ min_value, max_value };
 			Tensor<V, i_integrals_t<sizeof...(Ds)>, Ds...> tensor;
 			std::generate(tensor.cbegin(), tensor.cend(), [&]() {return distribution(rng); });
-			return std::move(tensor);
+			return tensor;
 		}
 	};
 
@@ -411,6 +693,7 @@ namespace TTest
 	constexpr auto operator+(Tensor<V1, i_integrals_t<sizeof...(Ds)>, Ds...> const& first, Tensor<V2, i_integrals_t<sizeof...(Ds)>, Ds...> const& second)
 	{
 		using value_t = std::decay_t<decltype(std::declval<V1>() + std::declval<V2>())>;
+		ET_PERF_SCOPE("TTest::add", (sizeof(V1) + sizeof(V2) + sizeof(value_t)) * total_size_v<Ds...>);
 		auto result = TensorFactory::MakeZeroTensor<value_t, Ds...>();
 		auto it1 = first.cbegin();
 		auto it2 = second.cbegin();
@@ -425,6 +708,7 @@ namespace TTest
 	constexpr auto operator*(Tensor<V1, i_integrals_t<sizeof...(Ds)>, Ds...> const& first, Tensor<V2, i_integrals_t<sizeof...(Ds)>, Ds...> const& second)
 	{
 		using value_t = std::decay_t<decltype(std::declval<V1>() + std::declval<V2>())>;
+		ET_PERF_SCOPE("TTest::multiply", (sizeof(V1) + sizeof(V2) + sizeof(value_t)) * total_size_v<Ds...>);
 		auto result = TensorFactory::MakeZeroTensor<value_t, Ds...>();
 		auto it1 = first.cbegin();
 		auto it2 = second.cbegin();
@@ -435,9 +719,10 @@ namespace TTest
 		return result;
 	}
 
-	template <typename S, typename V, size_t... Ds>
+	template <typename S, typename V, size_t... Ds, typename = std::enable_if_t<!is_tensor_v<S>>>
 	constexpr auto operator*(S scalar, Tensor<V, i_integrals_t<sizeof...(Ds)>, Ds...> const& first)
 	{
+		ET_PERF_SCOPE("TTest::scale", 2 * sizeof(V) * total_size_v<Ds...>);
 		auto result{ first };
 		for (auto it = result.cbegin(); it != result.cend(); it++)
 		{
@@ -450,6 +735,7 @@ namespace TTest
 	constexpr auto operator-(Tensor<V1, i_integrals_t<sizeof...(Ds)>, Ds...> const& first, Tensor<V2, i_integrals_t<sizeof...(Ds)>, Ds...> const& second)
 	{
 		using value_t = std::decay_t<decltype(std::declval<V1>() + std::declval<V2>())>;
+		ET_PERF_SCOPE("TTest::subtract", (sizeof(V1) + sizeof(V2) + sizeof(value_t)) * total_size_v<Ds...>);
 		auto result = TensorFactory::MakeZeroTensor<value_t, Ds...>();
 		auto it1 = first.cbegin();
 		auto it2 = second.cbegin();
@@ -464,6 +750,7 @@ namespace TTest
 	constexpr auto operator/(Tensor<V1, i_integrals_t<sizeof...(Ds)>, Ds...> const& first, Tensor<V2, i_integrals_t<sizeof...(Ds)>, Ds...> const& second)
 	{
 		using value_t = std::decay_t<decltype(std::declval<V1>() + std::declval<V2>())>;
+		ET_PERF_SCOPE("TTest::divide", (sizeof(V1) + sizeof(V2) + sizeof(value_t)) * total_size_v<Ds...>);
 		auto result = TensorFactory::MakeZeroTensor<value_t, Ds...>();
 		auto it1 = first.cbegin();
 		auto it2 = second.cbegin();
@@ -478,6 +765,7 @@ namespace TTest
 	constexpr auto pow(Tensor<V1, i_integrals_t<sizeof...(Ds)>, Ds...> const& first, Tensor<V2, i_integrals_t<sizeof...(Ds)>, Ds...> const& second)
 	{
 		using value_t = std::decay_t<decltype(std::declval<V1>() + std::declval<V2>())>;
+		ET_PERF_SCOPE("TTest::pow", (sizeof(V1) + sizeof(V2) + sizeof(value_t)) * total_size_v<Ds...>);
 		auto result = TensorFactory::MakeZeroTensor<value_t, Ds...>();
 		auto it1 = first.cbegin();
 		auto it2 = second.cbegin();
@@ -491,6 +779,7 @@ namespace TTest
 	template <typename V, size_t... Ds>
 	constexpr auto operator-(Tensor<V, i_integrals_t<sizeof...(Ds)>, Ds...> const& first)
 	{
+		ET_PERF_SCOPE("TTest::negate", 2 * sizeof(V) * total_size_v<Ds...>);
 		auto result = TensorFactory::MakeZeroTensor<V, Ds...>();
 		auto it1 = first.cbegin();
 		for (auto it2 = result.cbegin(); it2 != result.cend(); it1++, it2++)
@@ -503,6 +792,7 @@ namespace TTest
 	template <typename V, size_t... Ds>
 	constexpr auto sin(Tensor<V, i_integrals_t<sizeof...(Ds)>, Ds...> const& first)
 	{
+		ET_PERF_SCOPE("TTest::sin", 2 * sizeof(V) * total_size_v<Ds...>);
 		auto result = TensorFactory::MakeZeroTensor<V, Ds...>();
 		auto it1 = first.cbegin();
 		for (auto it2 = result.cbegin(); it2 != result.cend(); it1++, it2++)
@@ -515,6 +805,7 @@ namespace TTest
 	template <typename V, size_t... Ds>
 	constexpr auto cos(Tensor<V, i_integrals_t<sizeof...(Ds)>, Ds...> const& first)
 	{
+		ET_PERF_SCOPE("TTest::cos", 2 * sizeof(V) * total_size_v<Ds...>);
 		auto result = TensorFactory::MakeZeroTensor<V, Ds...>();
 		auto it1 = first.cbegin();
 		for (auto it2 = result.cbegin(); it2 != result.cend(); it1++, it2++)
@@ -527,6 +818,7 @@ namespace TTest
 	template <typename V, size_t... Ds>
 	constexpr auto tan(Tensor<V, i_integrals_t<sizeof...(Ds)>, Ds...> const& first)
 	{
+		ET_PERF_SCOPE("TTest::tan", 2 * sizeof(V) * total_size_v<Ds...>);
 		auto result = TensorFactory::MakeZeroTensor<V, Ds...>();
 		auto it1 = first.cbegin();
 		for (auto it2 = result.cbegin(); it2 != result.cend(); it1++, it2++)
@@ -539,6 +831,7 @@ namespace TTest
 	template <typename V, size_t... Ds>
 	constexpr auto log(Tensor<V, i_integrals_t<sizeof...(Ds)>, Ds...> const& first)
 	{
+		ET_PERF_SCOPE("TTest::log", 2 * sizeof(V) * total_size_v<Ds...>);
 		auto result = TensorFactory::MakeZeroTensor<V, Ds...>();
 		auto it1 = first.cbegin();
 		for (auto it2 = result.cbegin(); it2 != result.cend(); it1++, it2++)
@@ -551,6 +844,7 @@ namespace TTest
 	template <typename V, size_t... Ds>
 	constexpr auto cosec(Tensor<V, i_integrals_t<sizeof...(Ds)>, Ds...> const& first)
 	{
+		ET_PERF_SCOPE("TTest::cosec", 2 * sizeof(V) * total_size_v<Ds...>);
 		auto result = TensorFactory::MakeZeroTensor<V, Ds...>();
 		auto it1 = first.cbegin();
 		for (auto it2 = result.cbegin(); it2 != result.cend(); it1++, it2++)
@@ -563,6 +857,7 @@ namespace TTest
 	template <typename V, size_t... Ds>
 	constexpr auto sec(Tensor<V, i_integrals_t<sizeof...(Ds)>, Ds...> const& first)
 	{
+		ET_PERF_SCOPE("TTest::sec", 2 * sizeof(V) * total_size_v<Ds...>);
 		auto result = TensorFactory::MakeZeroTensor<V, Ds...>();
 		auto it1 = first.cbegin();
 		for (auto it2 = result.cbegin(); it2 != result.cend(); it1++, it2++)
@@ -575,6 +870,7 @@ namespace TTest
 	template <typename V, size_t... Ds>
 	constexpr auto cot(Tensor<V, i_integrals_t<sizeof...(Ds)>, Ds...> const& first)
 	{
+		ET_PERF_SCOPE("TTest::cot", 2 * sizeof(V) * total_size_v<Ds...>);
 		auto result = TensorFactory::MakeZeroTensor<V, Ds...>();
 		auto it1 = first.cbegin();
 		for (auto it2 = result.cbegin(); it2 != result.cend(); it1++, it2++)
@@ -583,4 +879,44 @@ namespace TTest
 		}
 		return result;
 	}
-}
\ No newline at end of file
+
+	template <typename V, size_t... Ds>
+	constexpr auto sum(Tensor<V, i_integrals_t<sizeof...(Ds)>, Ds...> const& first) -> V
+	{
+		ET_PERF_SCOPE("TTest::sum", sizeof(V) * total_size_v<Ds...>);
+		V result{ 0 };
+		for (auto it = first.cbegin(); it != first.cend(); it++)
+		{
+			result += *it;
+		}
+		return result;
+	}
+
+	template <typename V1, typename V2, typename V3>
+	auto gemm(size_t m, size_t k, V1 const* first, V2 const* second, V3* result, size_t column_begin, size_t column_end) -> void
+	{
+		for (size_t j = column_begin; j < column_end; j++)
+		{
+			V3* result_column = result + j * m;
+			for (size_t p = 0; p < k; p++)
+			{
+				V1 const* first_column = first + p * m;
+				V3 const factor = second[p + j * k];
+				for (size_t i = 0; i < m; i++)
+				{
+					result_column[i] += first_column[i] * factor;
+				}
+			}
+		}
+	}
+
+	template <typename V1, typename V2, size_t M, size_t K, size_t N>
+	auto matmul(Tensor<V1, i_integrals_t<2>, M, K> const& first, Tensor<V2, i_integrals_t<2>, K, N> const& second)
+	{
+		using value_t = std::decay_t<decltype(std::declval<V1>() * std::declval<V2>())>;
+		ET_PERF_SCOPE("TTest::matmul", sizeof(V1) * M * K + sizeof(V2) * K * N + sizeof(value_t) * M * N);
+		auto result = TensorFactory::MakeZeroTensor<value_t, M, N>();
+		gemm(M, K, first.cbegin(), second.cbegin(), result.cbegin(), 0, N);
+		return result;
+	}
+}
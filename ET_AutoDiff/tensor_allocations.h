@@ -0,0 +1,242 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "type_name.h"
+
+#if defined(TTEST_TRACK_ALLOCATIONS)
+#include <map>
+#endif
+
+namespace TTest
+{
+	struct AllocationStats
+	{
+		uint64_t live_bytes;
+		uint64_t peak_bytes;
+		uint64_t allocations;
+		uint64_t frees;
+	};
+
+	struct ShapeRecord
+	{
+		std::string shape;
+		uint64_t bytes_per_tensor;
+		std::atomic<uint64_t> allocations{ 0 };
+		std::atomic<uint64_t> live{ 0 };
+	};
+
+	struct AllocationSample
+	{
+		std::string name;
+		uint64_t allocations;
+		uint64_t bytes;
+		uint64_t live;
+	};
+
+	class AllocationTracker
+	{
+	private:
+		std::atomic<uint64_t> _live_bytes{ 0 };
+		std::atomic<uint64_t> _peak_bytes{ 0 };
+		std::atomic<uint64_t> _allocations{ 0 };
+		std::atomic<uint64_t> _frees{ 0 };
+
+		std::mutex _mutex;
+		std::vector<std::unique_ptr<ShapeRecord>> _shapes;
+#if defined(TTEST_TRACK_ALLOCATIONS)
+		std::map<std::string, AllocationSample> _sites;
+#endif
+
+	public:
+		static auto Instance() -> AllocationTracker&
+		{
+			static AllocationTracker tracker;
+			return tracker;
+		}
+
+		auto RegisterShape(std::string shape, uint64_t bytes_per_tensor) -> ShapeRecord&
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			_shapes.push_back(std::make_unique<ShapeRecord>());
+			_shapes.back()->shape = std::move(shape);
+			_shapes.back()->bytes_per_tensor = bytes_per_tensor;
+			return *_shapes.back();
+		}
+
+		auto OnAllocate(ShapeRecord& shape) -> void
+		{
+			uint64_t const bytes = shape.bytes_per_tensor;
+			shape.allocations.fetch_add(1, std::memory_order_relaxed);
+			shape.live.fetch_add(1, std::memory_order_relaxed);
+			_allocations.fetch_add(1, std::memory_order_relaxed);
+			uint64_t const live = _live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+			uint64_t peak = _peak_bytes.load(std::memory_order_relaxed);
+			while (live > peak && !_peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+#if defined(TTEST_TRACK_ALLOCATIONS)
+			_impl_Attribute(shape);
+#endif
+		}
+
+		auto OnFree(ShapeRecord& shape) -> void
+		{
+			shape.live.fetch_sub(1, std::memory_order_relaxed);
+			_frees.fetch_add(1, std::memory_order_relaxed);
+			_live_bytes.fetch_sub(shape.bytes_per_tensor, std::memory_order_relaxed);
+		}
+
+		auto Stats() const -> AllocationStats
+		{
+			return { _live_bytes.load(std::memory_order_relaxed), _peak_bytes.load(std::memory_order_relaxed),
+				_allocations.load(std::memory_order_relaxed), _frees.load(std::memory_order_relaxed) };
+		}
+
+		auto Shapes() -> std::vector<AllocationSample>
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			std::vector<AllocationSample> shapes;
+			for (auto const& shape : _shapes)
+			{
+				uint64_t const allocations = shape->allocations.load(std::memory_order_relaxed);
+				shapes.push_back({ shape->shape, allocations, allocations * shape->bytes_per_tensor, shape->live.load(std::memory_order_relaxed) });
+			}
+			return shapes;
+		}
+
+		auto Sites() -> std::vector<AllocationSample>
+		{
+			std::vector<AllocationSample> sites;
+#if defined(TTEST_TRACK_ALLOCATIONS)
+			std::lock_guard<std::mutex> lock{ _mutex };
+			for (auto const& site : _sites)
+			{
+				sites.push_back(site.second);
+			}
+#endif
+			return sites;
+		}
+
+		auto ResetPeak() -> void
+		{
+			_peak_bytes.store(_live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+
+#if defined(TTEST_TRACK_ALLOCATIONS)
+		inline static thread_local char const* _current_site = nullptr;
+
+	private:
+		auto _impl_Attribute(ShapeRecord const& shape) -> void
+		{
+			std::lock_guard<std::mutex> lock{ _mutex };
+			std::string const name = _current_site != nullptr ? _current_site : "<unattributed>";
+			auto& site = _sites[name];
+			site.name = name;
+			site.allocations++;
+			site.bytes += shape.bytes_per_tensor;
+		}
+#endif
+	};
+
+	template <typename V, size_t... Ds>
+	auto ShapeSlot() -> ShapeRecord&
+	{
+		static ShapeRecord& record = AllocationTracker::Instance().RegisterShape(
+			std::string{ Et::type_name<V>() } + ((std::string{ "[" } + std::to_string(Ds) + "]") + ...),
+			sizeof(V) * (Ds * ...));
+		return record;
+	}
+
+	class AllocationCheckpoint
+	{
+	private:
+		AllocationStats _begin;
+
+	public:
+		AllocationCheckpoint() : _begin{ AllocationTracker::Instance().Stats() } {}
+
+		auto Allocations() const -> uint64_t
+		{
+			return AllocationTracker::Instance().Stats().allocations - _begin.allocations;
+		}
+
+		auto Frees() const -> uint64_t
+		{
+			return AllocationTracker::Instance().Stats().frees - _begin.frees;
+		}
+
+		auto LiveBytesDelta() const -> int64_t
+		{
+			return static_cast<int64_t>(AllocationTracker::Instance().Stats().live_bytes) - static_cast<int64_t>(_begin.live_bytes);
+		}
+
+		auto AllocationFree() const -> bool
+		{
+			return Allocations() == 0;
+		}
+	};
+
+#if defined(TTEST_TRACK_ALLOCATIONS)
+	class AllocationSite
+	{
+	private:
+		char const* _parent;
+
+	public:
+		AllocationSite(char const* name) : _parent{ AllocationTracker::_current_site }
+		{
+			AllocationTracker::_current_site = name;
+		}
+
+		AllocationSite(AllocationSite const&) = delete;
+		auto operator=(AllocationSite const&) -> AllocationSite & = delete;
+
+		~AllocationSite()
+		{
+			AllocationTracker::_current_site = _parent;
+		}
+	};
+
+#define ET_ALLOC_IMPL_CONCAT(a, b) a##b
+#define ET_ALLOC_IMPL_NAME(a, b) ET_ALLOC_IMPL_CONCAT(a, b)
+#define TTEST_ALLOCATION_SITE(name) ::TTest::AllocationSite ET_ALLOC_IMPL_NAME(_ttest_allocation_site_, __LINE__){ name }
+#else
+#define TTEST_ALLOCATION_SITE(name)
+#endif
+
+	inline auto ReportAllocations(std::ostream& stream) -> void
+	{
+		auto& tracker = AllocationTracker::Instance();
+		auto const stats = tracker.Stats();
+		auto const flags = stream.flags();
+
+		stream << "live bytes " << stats.live_bytes << ", peak bytes " << stats.peak_bytes
+			<< ", allocations " << stats.allocations << ", frees " << stats.frees << '\n';
+
+		auto print = [&](char const* title, std::vector<AllocationSample> samples, bool with_live)
+		{
+			std::sort(samples.begin(), samples.end(), [](auto const& first, auto const& second) { return first.bytes > second.bytes; });
+			stream << std::left << std::setw(32) << title << std::setw(14) << "allocations" << std::setw(16) << "bytes" << (with_live ? "live" : "") << '\n';
+			for (auto const& sample : samples)
+			{
+				stream << std::left << std::setw(32) << sample.name << std::setw(14) << sample.allocations << std::setw(16) << sample.bytes;
+				if (with_live)
+				{
+					stream << sample.live;
+				}
+				stream << '\n';
+			}
+		};
+		print("shape", tracker.Shapes(), true);
+#if defined(TTEST_TRACK_ALLOCATIONS)
+		print("site", tracker.Sites(), false);
+#endif
+		stream.flags(flags);
+	}
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "trace.h"
+
+namespace Et {
+
+	class ThreadPool
+	{
+	public:
+		using task_t = std::function<void()>;
+
+	private:
+		struct _impl_TaskQueue
+		{
+			std::mutex _mutex;
+			std::deque<task_t> _tasks;
+		};
+
+		std::vector<std::unique_ptr<_impl_TaskQueue>> _queues;
+		std::vector<std::thread> _threads;
+		size_t _n_workers;
+		std::atomic<size_t> _pending;
+		std::mutex _sleep_mutex;
+		std::condition_variable _wake;
+		bool _stopping;
+
+		inline static thread_local ThreadPool* _current_pool = nullptr;
+		inline static thread_local size_t _current_index = 0;
+
+		auto _impl_InjectionQueue() -> _impl_TaskQueue&
+		{
+			return *_queues.back();
+		}
+
+		auto _impl_PopBack(_impl_TaskQueue& queue, task_t& task) -> bool
+		{
+			std::lock_guard<std::mutex> lock{ queue._mutex };
+			if (queue._tasks.empty())
+			{
+				return false;
+			}
+			task = std::move(queue._tasks.back());
+			queue._tasks.pop_back();
+			return true;
+		}
+
+		auto _impl_PopFront(_impl_TaskQueue& queue, task_t& task) -> bool
+		{
+			std::lock_guard<std::mutex> lock{ queue._mutex };
+			if (queue._tasks.empty())
+			{
+				return false;
+			}
+			task = std::move(queue._tasks.front());
+			queue._tasks.pop_front();
+			return true;
+		}
+
+		auto _impl_FindTask(task_t& task) -> bool
+		{
+			size_t const n_workers = _n_workers;
+			size_t const own_index = _current_pool == this ? _current_index : n_workers;
+
+			if (own_index < n_workers && _impl_PopBack(*_queues[own_index], task))
+			{
+				return true;
+			}
+			if (_impl_PopFront(_impl_InjectionQueue(), task))
+			{
+				return true;
+			}
+			for (size_t offset = 1; offset <= n_workers; offset++)
+			{
+				size_t const victim = (own_index + offset) % n_workers;
+				if (victim != own_index && _impl_PopFront(*_queues[victim], task))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		auto _impl_WorkerLoop(size_t index) -> void
+		{
+			_current_pool = this;
+			_current_index = index;
+
+			task_t task;
+			while (true)
+			{
+				if (_impl_FindTask(task))
+				{
+					_pending.fetch_sub(1, std::memory_order_relaxed);
+					{
+						ET_TRACE_SCOPE("Task");
+						task();
+					}
+					task = nullptr;
+					continue;
+				}
+
+				std::unique_lock<std::mutex> lock{ _sleep_mutex };
+				_wake.wait(lock, [this]() { return _stopping || _pending.load(std::memory_order_acquire) > 0; });
+				if (_stopping && _pending.load(std::memory_order_acquire) == 0)
+				{
+					return;
+				}
+			}
+		}
+
+	public:
+		ThreadPool(size_t n_threads = std::thread::hardware_concurrency()) : _n_workers{ n_threads > 0 ? n_threads : 1 }, _pending{ 0 }, _stopping{ false }
+		{
+			n_threads = _n_workers;
+			for (size_t i = 0; i <= n_threads; i++)
+			{
+				_queues.push_back(std::make_unique<_impl_TaskQueue>());
+			}
+			for (size_t i = 0; i < n_threads; i++)
+			{
+				_threads.emplace_back([this, i]() { _impl_WorkerLoop(i); });
+			}
+		}
+
+		ThreadPool(ThreadPool const&) = delete;
+		auto operator=(ThreadPool const&) -> ThreadPool & = delete;
+
+		~ThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock{ _sleep_mutex };
+				_stopping = true;
+			}
+			_wake.notify_all();
+			for (auto& thread : _threads)
+			{
+				thread.join();
+			}
+		}
+
+		auto Size() const -> size_t
+		{
+			return _n_workers;
+		}
+
+		auto Submit(task_t task) -> void
+		{
+#if defined(ET_TRACE)
+			task = [context = Trace::Tracer::Instance().Context(), inner = std::move(task)]()
+			{
+				Trace::ContextScope scope{ context };
+				inner();
+			};
+#endif
+			auto& queue = _current_pool == this ? *_queues[_current_index] : _impl_InjectionQueue();
+			{
+				std::lock_guard<std::mutex> lock{ queue._mutex };
+				queue._tasks.push_back(std::move(task));
+			}
+			_pending.fetch_add(1, std::memory_order_release);
+			{
+				std::lock_guard<std::mutex> lock{ _sleep_mutex };
+			}
+			_wake.notify_one();
+		}
+
+		auto TryRunOne() -> bool
+		{
+			task_t task;
+			if (!_impl_FindTask(task))
+			{
+				return false;
+			}
+			_pending.fetch_sub(1, std::memory_order_relaxed);
+			{
+				ET_TRACE_SCOPE("Task");
+				task();
+			}
+			return true;
+		}
+
+		static auto Current() -> ThreadPool*
+		{
+			return _current_pool;
+		}
+	};
+
+	class TaskGroup
+	{
+	private:
+		ThreadPool& _pool;
+		std::atomic<size_t> _outstanding;
+		std::mutex _mutex;
+		std::condition_variable _done;
+		std::exception_ptr _error;
+
+		auto _impl_Join() -> void
+		{
+			while (true)
+			{
+				if (_outstanding.load(std::memory_order_acquire) == 0)
+				{
+					std::lock_guard<std::mutex> lock{ _mutex };
+					return;
+				}
+				if (_pool.TryRunOne())
+				{
+					continue;
+				}
+				std::unique_lock<std::mutex> lock{ _mutex };
+				_done.wait_for(lock, std::chrono::milliseconds(1), [this]() { return _outstanding.load(std::memory_order_acquire) == 0; });
+			}
+		}
+
+	public:
+		TaskGroup(ThreadPool& pool) : _pool{ pool }, _outstanding{ 0 } {}
+
+		TaskGroup(TaskGroup const&) = delete;
+		auto operator=(TaskGroup const&) -> TaskGroup & = delete;
+
+		~TaskGroup()
+		{
+			_impl_Join();
+		}
+
+		template <typename F>
+		auto Run(F&& function) -> void
+		{
+			_outstanding.fetch_add(1, std::memory_order_relaxed);
+			_pool.Submit([this, function = std::forward<F>(function)]() mutable
+			{
+				std::exception_ptr error;
+				try
+				{
+					function();
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+
+				std::lock_guard<std::mutex> lock{ _mutex };
+				if (error && !_error)
+				{
+					_error = error;
+				}
+				if (_outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					_done.notify_all();
+				}
+			});
+		}
+
+		auto Wait() -> void
+		{
+			_impl_Join();
+			if (_error)
+			{
+				std::rethrow_exception(std::exchange(_error, nullptr));
+			}
+		}
+	};
+
+	template <typename F>
+	auto ParallelFor(ThreadPool& pool, size_t begin, size_t end, size_t grain, F&& function) -> void
+	{
+		if (end <= begin)
+		{
+			return;
+		}
+		grain = grain > 0 ? grain : 1;
+		size_t const n_parts = std::min((end - begin + grain - 1) / grain, pool.Size() + 1);
+		size_t const part_size = (end - begin + n_parts - 1) / n_parts;
+
+		TaskGroup group{ pool };
+		for (size_t part = 1; part < n_parts; part++)
+		{
+			size_t const part_begin = begin + part * part_size;
+			size_t const part_end = std::min(end, part_begin + part_size);
+			if (part_begin < part_end)
+			{
+				group.Run([&function, part_begin, part_end]() { function(part_begin, part_end); });
+			}
+		}
+		function(begin, std::min(end, begin + part_size));
+		group.Wait();
+	}
+}
@@ -0,0 +1,365 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace Et {
+
+	namespace Trace {
+
+		struct TraceOptions
+		{
+			uint64_t sample_every = 1;
+			size_t events_per_thread = size_t{ 1 } << 16;
+		};
+	}
+}
+
+#if defined(ET_TRACE)
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Et {
+
+	namespace Trace {
+
+		struct Event
+		{
+			char const* name;
+			uint64_t begin;
+			uint64_t duration;
+			uint64_t iteration;
+		};
+
+		class ThreadBuffer
+		{
+		private:
+			std::vector<Event> _events;
+			std::atomic<uint64_t> _written;
+			uint32_t _thread_id;
+
+		public:
+			ThreadBuffer(size_t capacity, uint32_t thread_id) : _events(capacity > 0 ? capacity : 1), _written{ 0 }, _thread_id{ thread_id } {}
+
+			auto Push(Event const& event) -> void
+			{
+				uint64_t const written = _written.load(std::memory_order_relaxed);
+				_events[written % _events.size()] = event;
+				_written.store(written + 1, std::memory_order_release);
+			}
+
+			auto Events() const -> std::vector<Event>
+			{
+				uint64_t const written = _written.load(std::memory_order_acquire);
+				uint64_t const kept = written < _events.size() ? written : _events.size();
+				std::vector<Event> events;
+				events.reserve(static_cast<size_t>(kept));
+				for (uint64_t i = written - kept; i < written; i++)
+				{
+					events.push_back(_events[i % _events.size()]);
+				}
+				return events;
+			}
+
+			auto Dropped() const -> uint64_t
+			{
+				uint64_t const written = _written.load(std::memory_order_acquire);
+				return written > _events.size() ? written - _events.size() : 0;
+			}
+
+			auto ThreadId() const -> uint32_t
+			{
+				return _thread_id;
+			}
+		};
+
+		struct IterationContext
+		{
+			uint64_t generation = 0;
+			uint64_t next = 0;
+			bool sampled = false;
+		};
+
+		class Tracer
+		{
+		private:
+			std::mutex _mutex;
+			std::vector<std::shared_ptr<ThreadBuffer>> _buffers;
+			TraceOptions _options;
+			std::atomic<int64_t> _origin;
+			std::atomic<uint64_t> _sample_every;
+			std::atomic<uint64_t> _generation;
+			std::atomic<bool> _enabled;
+
+			struct _impl_ThreadSlot
+			{
+				std::shared_ptr<ThreadBuffer> buffer;
+				uint64_t generation = 0;
+			};
+
+			static auto _impl_SteadyNanoseconds() -> int64_t
+			{
+				return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+			}
+
+			static auto _impl_LocalContext() -> IterationContext&
+			{
+				thread_local IterationContext context;
+				return context;
+			}
+
+			auto _impl_CurrentContext() const -> IterationContext
+			{
+				uint64_t const generation = _generation.load(std::memory_order_acquire);
+				IterationContext const& context = _impl_LocalContext();
+				return context.generation == generation ? context : IterationContext{ generation, 0, true };
+			}
+
+		public:
+			Tracer() : _origin{ _impl_SteadyNanoseconds() }, _sample_every{ 1 }, _generation{ 0 }, _enabled{ false } {}
+
+			static auto Instance() -> Tracer&
+			{
+				static Tracer tracer;
+				return tracer;
+			}
+
+			auto Start(TraceOptions const& options) -> void
+			{
+				std::lock_guard<std::mutex> lock{ _mutex };
+				_options = options;
+				_options.sample_every = options.sample_every > 0 ? options.sample_every : 1;
+				_buffers.clear();
+				_origin.store(_impl_SteadyNanoseconds(), std::memory_order_relaxed);
+				_sample_every.store(_options.sample_every, std::memory_order_relaxed);
+				_generation.fetch_add(1, std::memory_order_release);
+				_enabled.store(true, std::memory_order_release);
+			}
+
+			auto Stop() -> void
+			{
+				_enabled.store(false, std::memory_order_release);
+			}
+
+			auto NextIteration() -> uint64_t
+			{
+				IterationContext context = _impl_CurrentContext();
+				uint64_t const iteration = context.next++;
+				context.sampled = iteration % _sample_every.load(std::memory_order_relaxed) == 0;
+				_impl_LocalContext() = context;
+				return iteration;
+			}
+
+			auto Context() const -> IterationContext
+			{
+				return _impl_CurrentContext();
+			}
+
+			auto Adopt(IterationContext const& context) -> IterationContext
+			{
+				IterationContext const previous = _impl_LocalContext();
+				_impl_LocalContext() = context;
+				return previous;
+			}
+
+			auto Active() const -> bool
+			{
+				return _enabled.load(std::memory_order_relaxed) && _impl_CurrentContext().sampled;
+			}
+
+			auto Now() const -> uint64_t
+			{
+				return static_cast<uint64_t>(_impl_SteadyNanoseconds() - _origin.load(std::memory_order_relaxed));
+			}
+
+			auto Iteration() const -> uint64_t
+			{
+				uint64_t const next = _impl_CurrentContext().next;
+				return next > 0 ? next - 1 : 0;
+			}
+
+			auto LocalBuffer() -> ThreadBuffer&
+			{
+				thread_local _impl_ThreadSlot slot;
+				uint64_t const generation = _generation.load(std::memory_order_acquire);
+				if (slot.generation != generation)
+				{
+					std::lock_guard<std::mutex> lock{ _mutex };
+					slot.buffer = std::make_shared<ThreadBuffer>(_options.events_per_thread, static_cast<uint32_t>(_buffers.size() + 1));
+					slot.generation = generation;
+					_buffers.push_back(slot.buffer);
+				}
+				return *slot.buffer;
+			}
+
+			auto WriteChromeJson(std::ostream& stream) -> void
+			{
+				std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+				{
+					std::lock_guard<std::mutex> lock{ _mutex };
+					buffers = _buffers;
+				}
+
+				stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+				bool first = true;
+				for (auto const& buffer : buffers)
+				{
+					stream << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->ThreadId()
+						<< ",\"args\":{\"name\":\"thread " << buffer->ThreadId() << "\",\"dropped\":" << buffer->Dropped() << "}}";
+					first = false;
+
+					for (auto const& event : buffer->Events())
+					{
+						stream << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->ThreadId()
+							<< ",\"ts\":" << event.begin / 1000 << '.' << std::to_string(1000 + event.begin % 1000).substr(1)
+							<< ",\"dur\":" << event.duration / 1000 << '.' << std::to_string(1000 + event.duration % 1000).substr(1)
+							<< ",\"args\":{\"iteration\":" << event.iteration << "}}";
+					}
+				}
+				stream << "\n]}\n";
+			}
+		};
+
+		class Span
+		{
+		private:
+			char const* _name;
+			uint64_t _begin;
+			uint64_t _iteration;
+			bool _active;
+
+		public:
+			Span(char const* name) : _name{ name }, _begin{ 0 }, _iteration{ 0 }, _active{ Tracer::Instance().Active() }
+			{
+				if (_active)
+				{
+					_iteration = Tracer::Instance().Iteration();
+					_begin = Tracer::Instance().Now();
+				}
+			}
+
+			Span(Span const&) = delete;
+			auto operator=(Span const&) -> Span & = delete;
+
+			~Span()
+			{
+				if (_active)
+				{
+					auto& tracer = Tracer::Instance();
+					uint64_t const end = tracer.Now();
+					tracer.LocalBuffer().Push({ _name, _begin, end - _begin, _iteration });
+				}
+			}
+		};
+
+		class WaitSpan
+		{
+		private:
+			char const* _name = nullptr;
+			uint64_t _begin = 0;
+			uint64_t _iteration = 0;
+
+		public:
+			auto Begin(char const* name) -> void
+			{
+				auto& tracer = Tracer::Instance();
+				if (tracer.Active())
+				{
+					_name = name;
+					_iteration = tracer.Iteration();
+					_begin = tracer.Now();
+				}
+			}
+
+			auto End() -> void
+			{
+				if (_name)
+				{
+					auto& tracer = Tracer::Instance();
+					uint64_t const end = tracer.Now();
+					tracer.LocalBuffer().Push({ _name, _begin, end - _begin, _iteration });
+					_name = nullptr;
+				}
+			}
+		};
+
+		class ContextScope
+		{
+		private:
+			IterationContext _previous;
+
+		public:
+			ContextScope(IterationContext const& context) : _previous{ Tracer::Instance().Adopt(context) } {}
+
+			ContextScope(ContextScope const&) = delete;
+			auto operator=(ContextScope const&) -> ContextScope & = delete;
+
+			~ContextScope()
+			{
+				Tracer::Instance().Adopt(_previous);
+			}
+		};
+
+		inline auto Start(TraceOptions const& options = {}) -> void
+		{
+			Tracer::Instance().Start(options);
+		}
+
+		inline auto Stop() -> void
+		{
+			Tracer::Instance().Stop();
+		}
+
+		inline auto WriteChromeJson(std::ostream& stream) -> void
+		{
+			Tracer::Instance().WriteChromeJson(stream);
+		}
+
+		inline auto WriteChromeJson(std::string const& path) -> void
+		{
+			std::ofstream stream{ path };
+			Tracer::Instance().WriteChromeJson(stream);
+		}
+	}
+}
+
+#define ET_TRACE_IMPL_CONCAT(a, b) a##b
+#define ET_TRACE_IMPL_NAME(a, b) ET_TRACE_IMPL_CONCAT(a, b)
+#define ET_TRACE_SCOPE(name) ::Et::Trace::Span ET_TRACE_IMPL_NAME(_et_trace_span_, __LINE__){ name }
+#define ET_TRACE_ITERATION() ::Et::Trace::Tracer::Instance().NextIteration()
+
+#else
+
+namespace Et {
+
+	namespace Trace {
+
+		class WaitSpan
+		{
+		public:
+			auto Begin(char const*) -> void {}
+
+			auto End() -> void {}
+		};
+
+		inline auto Start(TraceOptions const& = {}) -> void {}
+
+		inline auto Stop() -> void {}
+
+		inline auto WriteChromeJson(std::ostream&) -> void {}
+
+		inline auto WriteChromeJson(std::string const&) -> void {}
+	}
+}
+
+#define ET_TRACE_SCOPE(name)
+#define ET_TRACE_ITERATION()
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace Et {
+
+	template <typename T>
+	constexpr auto _impl_raw_type_name() -> std::string_view
+	{
+#if defined(_MSC_VER)
+		return __FUNCSIG__;
+#else
+		return __PRETTY_FUNCTION__;
+#endif
+	}
+
+	constexpr size_t _impl_type_name_prefix_v = _impl_raw_type_name<void>().find("void");
+	constexpr size_t _impl_type_name_suffix_v = _impl_raw_type_name<void>().size() - _impl_type_name_prefix_v - 4;
+
+	template <typename T>
+	constexpr auto type_name() -> std::string_view
+	{
+		std::string_view const name = _impl_raw_type_name<T>();
+		return name.substr(_impl_type_name_prefix_v, name.size() - _impl_type_name_prefix_v - _impl_type_name_suffix_v);
+	}
+
+	inline auto short_type_name(std::string_view name, int max_depth = 1) -> std::string
+	{
+		std::string result;
+		int depth = 0;
+		for (char c : name)
+		{
+			if (c == '<')
+			{
+				if (depth++ == max_depth)
+				{
+					result += "<...";
+				}
+			}
+			else if (c == '>')
+			{
+				if (--depth == max_depth)
+				{
+					result += '>';
+					continue;
+				}
+			}
+			if (depth <= max_depth)
+			{
+				result += c;
+			}
+		}
+		return result;
+	}
+}
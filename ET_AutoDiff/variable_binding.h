@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <type_traits>
+#include <vector>
+#include "graph_stats.h"
+
+namespace Et {
+
+	class VariableBinding
+	{
+	private:
+		struct _impl_Variable
+		{
+			void* expr;
+			size_t offset;
+			size_t count;
+			auto (*read)(void const*, double*) -> void;
+			auto (*write)(void*, double const*) -> void;
+		};
+
+		std::vector<_impl_Variable> _variables;
+		std::vector<size_t> _occurrences;
+		size_t _size;
+
+		template <typename E>
+		static auto _impl_Read(void const* expr, double* values) -> void
+		{
+			using value_t = typename E::value_t;
+			static_assert(std::is_same_v<typename value_t::num_type, double>, "variable bindings hold double parameters");
+			auto const* raw = reinterpret_cast<double const*>(&(*static_cast<E const*>(expr))());
+			std::copy(raw, raw + sizeof(value_t) / sizeof(double), values);
+		}
+
+		template <typename E>
+		static auto _impl_Write(void* expr, double const* values) -> void
+		{
+			using value_t = typename E::value_t;
+			auto& variable = *static_cast<E*>(expr);
+			value_t value = variable();
+			std::copy(values, values + sizeof(value_t) / sizeof(double), reinterpret_cast<double*>(&value));
+			variable.Assign(value);
+		}
+
+		template <typename E>
+		auto _impl_Collect(E& expr) -> void
+		{
+			if constexpr (is_binary_v<E>)
+			{
+				_impl_Collect(expr.FirstExpr());
+				_impl_Collect(expr.SecondExpr());
+			}
+			else if constexpr (is_unary_v<E>)
+			{
+				_impl_Collect(expr.FirstExpr());
+			}
+			else if constexpr (is_variable_v<E>)
+			{
+				using value_t = typename E::value_t;
+				void* const address = &expr;
+				constexpr size_t count = sizeof(value_t) / sizeof(typename value_t::num_type);
+				auto const found = std::find_if(_variables.begin(), _variables.end(), [address](auto const& variable) { return variable.expr == address; });
+				size_t const offset = found == _variables.end() ? _size : found->offset;
+				if (found == _variables.end())
+				{
+					_variables.push_back({ address, _size, count, &_impl_Read<E>, &_impl_Write<E> });
+					_size += count;
+				}
+				for (size_t i = 0; i < count; i++)
+				{
+					_occurrences.push_back(offset + i);
+				}
+			}
+		}
+
+	public:
+		template <typename E>
+		VariableBinding(E& expr) : _size{ 0 }
+		{
+			_impl_Collect(expr);
+		}
+
+		auto Size() const -> size_t
+		{
+			return _size;
+		}
+
+		auto GradientSize() const -> size_t
+		{
+			return _occurrences.size();
+		}
+
+		auto Read(double* parameters) const -> void
+		{
+			for (auto const& variable : _variables)
+			{
+				variable.read(variable.expr, parameters + variable.offset);
+			}
+		}
+
+		auto Write(double const* parameters) const -> void
+		{
+			for (auto const& variable : _variables)
+			{
+				variable.write(variable.expr, parameters + variable.offset);
+			}
+		}
+
+		auto Fold(double const* gradients, double* folded) const -> void
+		{
+			std::fill(folded, folded + _size, 0.0);
+			for (size_t i = 0; i < _occurrences.size(); i++)
+			{
+				folded[_occurrences[i]] += gradients[i];
+			}
+		}
+	};
+}
@@ -0,0 +1,441 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include "tensor.h"
+
+namespace TTest
+{
+	template <typename V>
+	struct Fill
+	{
+		V value;
+
+		constexpr auto operator()(size_t) const -> V
+		{
+			return value;
+		}
+	};
+
+	template <typename V>
+	struct Iota
+	{
+		V start;
+		V step;
+
+		constexpr auto operator()(size_t index) const -> V
+		{
+			return start + static_cast<V>(index) * step;
+		}
+	};
+
+	template <typename V>
+	struct UniformRandom
+	{
+		V min_value;
+		V max_value;
+		uint64_t seed;
+
+		constexpr auto operator()(size_t index) const -> V
+		{
+			uint64_t bits = seed + (static_cast<uint64_t>(index) + 1) * 0x9E3779B97F4A7C15ull;
+			bits = (bits ^ (bits >> 30)) * 0xBF58476D1CE4E5B9ull;
+			bits = (bits ^ (bits >> 27)) * 0x94D049BB133111EBull;
+			bits ^= bits >> 31;
+			return min_value + (max_value - min_value) * static_cast<V>(static_cast<double>(bits >> 11) * 0x1.0p-53);
+		}
+	};
+
+	template <typename V>
+	struct Broadcast
+	{
+		V const* value;
+
+		constexpr auto operator()(size_t) const -> V
+		{
+			return *value;
+		}
+	};
+
+	template <typename F, typename G>
+	struct _impl_MapGenerator
+	{
+		F function;
+		G generator;
+
+		constexpr auto operator()(size_t index) const
+		{
+			return function(generator(index));
+		}
+	};
+
+	template <typename F, typename G1, typename G2>
+	struct _impl_ZipGenerator
+	{
+		F function;
+		G1 first;
+		G2 second;
+
+		constexpr auto operator()(size_t index) const
+		{
+			return function(first(index), second(index));
+		}
+	};
+
+	template <typename G>
+	class GeneratorIterator
+	{
+	private:
+		G const* _generator;
+		size_t _index;
+
+	public:
+		using iterator_category = std::random_access_iterator_tag;
+		using value_type = std::decay_t<decltype(std::declval<G const&>()(size_t{ 0 }))>;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = value_type;
+
+		constexpr GeneratorIterator(G const* generator, size_t index) : _generator{ generator }, _index{ index } {}
+
+		constexpr auto operator*() const -> value_type
+		{
+			return (*_generator)(_index);
+		}
+
+		constexpr auto operator[](size_t offset) const -> value_type
+		{
+			return (*_generator)(_index + offset);
+		}
+
+		constexpr auto operator++() -> GeneratorIterator &
+		{
+			_index++;
+			return *this;
+		}
+
+		constexpr auto operator++(int) -> GeneratorIterator
+		{
+			return GeneratorIterator{ _generator, _index++ };
+		}
+
+		constexpr auto operator+(size_t offset) const -> GeneratorIterator
+		{
+			return GeneratorIterator{ _generator, _index + offset };
+		}
+
+		constexpr auto operator-(GeneratorIterator const& other) const -> difference_type
+		{
+			return static_cast<difference_type>(_index) - static_cast<difference_type>(other._index);
+		}
+
+		constexpr auto operator==(GeneratorIterator const& other) const -> bool
+		{
+			return _index == other._index;
+		}
+
+		constexpr auto operator!=(GeneratorIterator const& other) const -> bool
+		{
+			return _index != other._index;
+		}
+	};
+
+	template <typename V, typename G, size_t... Ds>
+	class VirtualTensor : private TensorBase
+	{
+	public:
+		constexpr static size_t n_dims_v = sizeof...(Ds);
+		constexpr static size_t n_elems_v = total_size_v<Ds...>;
+		using generator_t = G;
+
+	private:
+		G _generator;
+
+		template <size_t D, size_t... Rest, typename T, typename... Ts>
+		constexpr static auto _impl_Offset(T index, Ts... indices) -> size_t
+		{
+			if constexpr (sizeof...(Ts) > 0)
+			{
+				return static_cast<size_t>(index) + D * _impl_Offset<Rest...>(indices...);
+			}
+			else
+			{
+				return static_cast<size_t>(index);
+			}
+		}
+
+	public:
+		constexpr VirtualTensor(G generator) : _generator{ generator } {}
+
+		template <typename... Is>
+		constexpr auto operator()(Is... indices) const -> V
+		{
+			static_assert(sizeof...(Is) == n_dims_v);
+			return static_cast<V>(_generator(_impl_Offset<Ds...>(indices...)));
+		}
+
+		constexpr auto Generator() const -> G const&
+		{
+			return _generator;
+		}
+
+		constexpr auto cbegin() const -> GeneratorIterator<G>
+		{
+			return { &_generator, 0 };
+		}
+
+		constexpr auto cend() const -> GeneratorIterator<G>
+		{
+			return { &_generator, n_elems_v };
+		}
+
+		auto Materialize() const
+		{
+			Tensor<V, i_integrals_t<n_dims_v>, Ds...> tensor;
+			V* out = tensor.cbegin();
+			for (size_t i = 0; i < n_elems_v; i++)
+			{
+				out[i] = static_cast<V>(_generator(i));
+			}
+			return tensor;
+		}
+	};
+
+	struct VirtualTensorFactory
+	{
+		template <typename V, size_t... Ds, typename G>
+		constexpr static auto MakeGenerated(G generator)
+		{
+			return VirtualTensor<V, G, Ds...>{ generator };
+		}
+
+		template <typename V, size_t... Ds>
+		constexpr static auto MakeConstant(V const& value)
+		{
+			return MakeGenerated<V, Ds...>(Fill<V>{ value });
+		}
+
+		template <typename V, size_t... Ds>
+		constexpr static auto MakeIota(V const& start, V const& step = V{ 1 })
+		{
+			return MakeGenerated<V, Ds...>(Iota<V>{ start, step });
+		}
+
+		template <typename V, size_t... Ds>
+		constexpr static auto MakeRandom(V const& min_value, V const& max_value, uint64_t seed)
+		{
+			return MakeGenerated<V, Ds...>(UniformRandom<V>{ min_value, max_value, seed });
+		}
+
+		template <typename V, size_t... Ds>
+		constexpr static auto MakeBroadcast(V const& value)
+		{
+			return MakeGenerated<V, Ds...>(Broadcast<V>{ &value });
+		}
+
+		template <typename V, size_t... Ds>
+		static auto MakeBroadcast(V const&& value) = delete;
+	};
+
+	template <typename T>
+	struct _impl_elementwise
+	{
+		constexpr static bool is_virtual_v = false;
+		constexpr static bool is_elementwise_v = false;
+	};
+
+	template <typename V, typename Tup, size_t... Ds>
+	struct _impl_elementwise<Tensor<V, Tup, Ds...>>
+	{
+		constexpr static bool is_virtual_v = false;
+		constexpr static bool is_elementwise_v = true;
+		using value_t = V;
+		using shape_t = value_list<Ds...>;
+	};
+
+	template <typename V, typename G, size_t... Ds>
+	struct _impl_elementwise<VirtualTensor<V, G, Ds...>>
+	{
+		constexpr static bool is_virtual_v = true;
+		constexpr static bool is_elementwise_v = true;
+		using value_t = V;
+		using shape_t = value_list<Ds...>;
+	};
+
+	template <typename T>
+	constexpr bool is_virtual_tensor_v = _impl_elementwise<std::decay_t<T>>::is_virtual_v;
+
+	template <typename T>
+	constexpr size_t _impl_stored_bytes_v = is_virtual_tensor_v<T> ? 0 : sizeof(typename _impl_elementwise<std::decay_t<T>>::value_t);
+
+	template <typename T1, typename T2, typename = void>
+	constexpr bool _impl_virtual_operands_v = false;
+
+	template <typename T1, typename T2>
+	constexpr bool _impl_virtual_operands_v<T1, T2, std::enable_if_t<_impl_elementwise<T1>::is_elementwise_v && _impl_elementwise<T2>::is_elementwise_v>> =
+		(_impl_elementwise<T1>::is_virtual_v || _impl_elementwise<T2>::is_virtual_v) && std::is_same_v<typename _impl_elementwise<T1>::shape_t, typename _impl_elementwise<T2>::shape_t>;
+
+	template <typename R, typename F, typename T1, typename T2, size_t... Ds>
+	constexpr auto _impl_Zip(F function, T1 const& first, T2 const& second, value_list<Ds...>)
+	{
+		if constexpr (is_virtual_tensor_v<T1> && is_virtual_tensor_v<T2>)
+		{
+			using generator_t = _impl_ZipGenerator<F, typename T1::generator_t, typename T2::generator_t>;
+			return VirtualTensor<R, generator_t, Ds...>{ generator_t{ function, first.Generator(), second.Generator() } };
+		}
+		else
+		{
+			ET_PERF_SCOPE("TTest::virtual_zip", (_impl_stored_bytes_v<T1> + _impl_stored_bytes_v<T2> + sizeof(R)) * total_size_v<Ds...>);
+			Tensor<R, i_integrals_t<sizeof...(Ds)>, Ds...> result;
+			R* out = result.cbegin();
+			auto it1 = first.cbegin();
+			auto it2 = second.cbegin();
+			for (size_t i = 0; i < total_size_v<Ds...>; i++)
+			{
+				out[i] = function(it1[i], it2[i]);
+			}
+			return result;
+		}
+	}
+
+	template <typename F, typename V, typename G, size_t... Ds>
+	constexpr auto _impl_Map(F function, VirtualTensor<V, G, Ds...> const& first)
+	{
+		return VirtualTensor<V, _impl_MapGenerator<F, G>, Ds...>{ _impl_MapGenerator<F, G>{ function, first.Generator() } };
+	}
+
+	template <typename T1, typename T2>
+	using _impl_virtual_result_t = std::decay_t<decltype(std::declval<typename _impl_elementwise<T1>::value_t>() + std::declval<typename _impl_elementwise<T2>::value_t>())>;
+
+	template <typename T1, typename T2, typename = std::enable_if_t<_impl_virtual_operands_v<T1, T2>>>
+	constexpr auto operator+(T1 const& first, T2 const& second)
+	{
+		return _impl_Zip<_impl_virtual_result_t<T1, T2>>(std::plus<>{}, first, second, typename _impl_elementwise<T1>::shape_t{});
+	}
+
+	template <typename T1, typename T2, typename = std::enable_if_t<_impl_virtual_operands_v<T1, T2>>>
+	constexpr auto operator-(T1 const& first, T2 const& second)
+	{
+		return _impl_Zip<_impl_virtual_result_t<T1, T2>>(std::minus<>{}, first, second, typename _impl_elementwise<T1>::shape_t{});
+	}
+
+	template <typename T1, typename T2, typename = std::enable_if_t<_impl_virtual_operands_v<T1, T2>>>
+	constexpr auto operator*(T1 const& first, T2 const& second)
+	{
+		return _impl_Zip<_impl_virtual_result_t<T1, T2>>(std::multiplies<>{}, first, second, typename _impl_elementwise<T1>::shape_t{});
+	}
+
+	template <typename T1, typename T2, typename = std::enable_if_t<_impl_virtual_operands_v<T1, T2>>>
+	constexpr auto operator/(T1 const& first, T2 const& second)
+	{
+		return _impl_Zip<_impl_virtual_result_t<T1, T2>>(std::divides<>{}, first, second, typename _impl_elementwise<T1>::shape_t{});
+	}
+
+	template <typename S>
+	struct _impl_Scale
+	{
+		S scalar;
+
+		template <typename V>
+		constexpr auto operator()(V const& value) const -> V
+		{
+			return scalar * value;
+		}
+	};
+
+	struct _impl_Negate
+	{
+		template <typename V>
+		constexpr auto operator()(V const& value) const -> V
+		{
+			return -value;
+		}
+	};
+
+	struct _impl_Sin
+	{
+		template <typename V>
+		auto operator()(V const& value) const -> V
+		{
+			return sin(value);
+		}
+	};
+
+	struct _impl_Cos
+	{
+		template <typename V>
+		auto operator()(V const& value) const -> V
+		{
+			return cos(value);
+		}
+	};
+
+	struct _impl_Tan
+	{
+		template <typename V>
+		auto operator()(V const& value) const -> V
+		{
+			return tan(value);
+		}
+	};
+
+	struct _impl_Log
+	{
+		template <typename V>
+		auto operator()(V const& value) const -> V
+		{
+			return log(value);
+		}
+	};
+
+	template <typename S, typename V, typename G, size_t... Ds, typename = std::enable_if_t<!is_tensor_v<S>>>
+	constexpr auto operator*(S scalar, VirtualTensor<V, G, Ds...> const& first)
+	{
+		return _impl_Map(_impl_Scale<S>{ scalar }, first);
+	}
+
+	template <typename V, typename G, size_t... Ds>
+	constexpr auto operator-(VirtualTensor<V, G, Ds...> const& first)
+	{
+		return _impl_Map(_impl_Negate{}, first);
+	}
+
+	template <typename V, typename G, size_t... Ds>
+	constexpr auto sin(VirtualTensor<V, G, Ds...> const& first)
+	{
+		return _impl_Map(_impl_Sin{}, first);
+	}
+
+	template <typename V, typename G, size_t... Ds>
+	constexpr auto cos(VirtualTensor<V, G, Ds...> const& first)
+	{
+		return _impl_Map(_impl_Cos{}, first);
+	}
+
+	template <typename V, typename G, size_t... Ds>
+	constexpr auto tan(VirtualTensor<V, G, Ds...> const& first)
+	{
+		return _impl_Map(_impl_Tan{}, first);
+	}
+
+	template <typename V, typename G, size_t... Ds>
+	constexpr auto log(VirtualTensor<V, G, Ds...> const& first)
+	{
+		return _impl_Map(_impl_Log{}, first);
+	}
+
+	template <typename V, typename G, size_t... Ds>
+	constexpr auto sum(VirtualTensor<V, G, Ds...> const& first) -> V
+	{
+		ET_PERF_SCOPE("TTest::virtual_sum", 0);
+		V result{ 0 };
+		G const& generator = first.Generator();
+		for (size_t i = 0; i < total_size_v<Ds...>; i++)
+		{
+			result += static_cast<V>(generator(i));
+		}
+		return result;
+	}
+}
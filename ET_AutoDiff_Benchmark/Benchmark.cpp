@@ -0,0 +1,285 @@
+#include <memory>
+#include <string>
+#include <utility>
+#include "benchmark.h"
+#include "scaling.h"
+#include "convergence.h"
+#include "compile_cost.h"
+#include "et_autodiff.h"
+#include "virtual_tensor.h"
+#include "structured_matrix.h"
+#include "runtime_expr.h"
+#include "readme_objective_generated.h"
+
+auto SizeLabel(uint64_t bytes) -> std::string
+{
+	char const* units[] = { "B", "KiB", "MiB", "GiB" };
+	int unit = 0;
+	while (bytes >= 1024 && unit < 3 && bytes % 1024 == 0)
+	{
+		bytes /= 1024;
+		unit++;
+	}
+	return std::to_string(bytes) + units[unit];
+}
+
+template <size_t N>
+void TensorOps(Bench::Runner& Runner)
+{
+	constexpr uint64_t Bytes = sizeof(double) * N;
+	if (!Runner.Fits(Bytes))
+	{
+		return;
+	}
+
+	auto x = TTest::TensorFactory::MakeTensorWithRandomValues<double, N>(0.5, 1.5);
+	auto y = TTest::TensorFactory::MakeTensorWithRandomValues<double, N>(0.5, 1.5);
+	auto a = TTest::TensorFactory::MakeTensorWithRandomValues<double, N>(0.5, 1.5);
+	std::string const Size = "/" + SizeLabel(Bytes);
+
+	auto binary = [&](char const* Name, auto Op)
+	{
+		Runner.Run(std::string{ "tensor/" } + Name + Size, N, 3 * Bytes, [&]() { auto z = Op(x, y); Bench::DoNotOptimize(z.cbegin()[0]); });
+	};
+	auto unary = [&](char const* Name, auto Op)
+	{
+		Runner.Run(std::string{ "tensor/" } + Name + Size, N, 2 * Bytes, [&]() { auto z = Op(x); Bench::DoNotOptimize(z.cbegin()[0]); });
+	};
+
+	binary("add", [](auto const& l, auto const& r) { return l + r; });
+	binary("subtract", [](auto const& l, auto const& r) { return l - r; });
+	binary("multiply", [](auto const& l, auto const& r) { return l * r; });
+	binary("divide", [](auto const& l, auto const& r) { return l / r; });
+	binary("pow", [](auto const& l, auto const& r) { return pow(l, r); });
+	unary("scale", [](auto const& v) { return 4.0 * v; });
+	unary("negate", [](auto const& v) { return -v; });
+	unary("sin", [](auto const& v) { return sin(v); });
+	unary("cos", [](auto const& v) { return cos(v); });
+	unary("tan", [](auto const& v) { return tan(v); });
+	unary("log", [](auto const& v) { return log(v); });
+	unary("sec", [](auto const& v) { return sec(v); });
+	unary("cosec", [](auto const& v) { return cosec(v); });
+	unary("cot", [](auto const& v) { return cot(v); });
+	Runner.Run("tensor/sum" + Size, N, Bytes, [&]() { Bench::DoNotOptimize(sum(x)); });
+
+	Runner.Run("expression/unfused" + Size, N, 4 * Bytes, [&]()
+	{
+		auto z = 4.0 * x * y - tan(a) + a + log(a / y);
+		Bench::DoNotOptimize(z.cbegin()[0]);
+	});
+
+	auto z = TTest::TensorFactory::MakeZeroTensor<double, N>();
+	Runner.Run("expression/fused" + Size, N, 4 * Bytes, [&]()
+	{
+		double const* px = x.cbegin();
+		double const* py = y.cbegin();
+		double const* pa = a.cbegin();
+		double* pz = z.cbegin();
+		for (size_t i = 0; i < N; i++)
+		{
+			pz[i] = 4.0 * px[i] * py[i] - std::tan(pa[i]) + pa[i] + std::log(pa[i] / py[i]);
+		}
+		Bench::DoNotOptimize(pz[0]);
+	});
+
+	auto Scale = TTest::VirtualTensorFactory::MakeConstant<double, N>(4.0);
+	auto Noise = TTest::VirtualTensorFactory::MakeRandom<double, N>(0.5, 1.5, 7);
+	Runner.Run("expression/generated/materialized" + Size, N, 2 * Bytes, [&]()
+	{
+		auto z = (Noise.Materialize() + Scale.Materialize()) * y;
+		Bench::DoNotOptimize(z.cbegin()[0]);
+	});
+	Runner.Run("expression/generated/virtual" + Size, N, 2 * Bytes, [&]()
+	{
+		auto z = (Noise + Scale) * y;
+		Bench::DoNotOptimize(z.cbegin()[0]);
+	});
+}
+
+template <size_t... Ns>
+void AllTensorOps(Bench::Runner& Runner, std::index_sequence<Ns...>)
+{
+	(TensorOps<size_t{ 8 } << (3 * Ns)>(Runner), ...);
+}
+
+template <size_t N>
+void MatmulOp(Bench::Runner& Runner)
+{
+	constexpr uint64_t Bytes = 3 * sizeof(double) * N * N;
+	if (!Runner.Fits(Bytes))
+	{
+		return;
+	}
+	auto a = TTest::TensorFactory::MakeTensorWithRandomValues<double, N, N>(0.5, 1.5);
+	auto b = TTest::TensorFactory::MakeTensorWithRandomValues<double, N, N>(0.5, 1.5);
+	Runner.Run("tensor/matmul/" + std::to_string(N) + "x" + std::to_string(N), 2 * N * N * N, Bytes, [&]()
+	{
+		auto c = matmul(a, b);
+		Bench::DoNotOptimize(c.cbegin()[0]);
+	});
+
+	auto banded = std::make_unique<Num::Banded<double, N, 2, 2>>(1.0);
+	auto lower = std::make_unique<Num::Triangular<double, N, Num::Triangle::Lower>>(1.0);
+	auto low_rank = std::make_unique<Num::LowRank<double, N, N, 4>>(0.5);
+	std::string const Shape = "/" + std::to_string(N) + "x" + std::to_string(N);
+	Runner.Run("structured/matmul/banded" + Shape, 2 * banded->coefficients_v * N, sizeof(double) * (banded->coefficients_v + 2 * N * N), [&]()
+	{
+		auto c = matmul(*banded, b);
+		Bench::DoNotOptimize(c.cbegin()[0]);
+	});
+	Runner.Run("structured/matmul/triangular" + Shape, 2 * lower->coefficients_v * N, sizeof(double) * (lower->coefficients_v + 2 * N * N), [&]()
+	{
+		auto c = matmul(*lower, b);
+		Bench::DoNotOptimize(c.cbegin()[0]);
+	});
+	Runner.Run("structured/matmul/low_rank" + Shape, 2 * low_rank->coefficients_v * N, sizeof(double) * (low_rank->coefficients_v + 2 * N * N), [&]()
+	{
+		auto c = matmul(*low_rank, b);
+		Bench::DoNotOptimize(c.cbegin()[0]);
+	});
+	Runner.Run("structured/solve/triangular" + Shape, lower->coefficients_v * N, sizeof(double) * (lower->coefficients_v + 2 * N * N), [&]()
+	{
+		auto c = solve(*lower, b);
+		Bench::DoNotOptimize(c.cbegin()[0]);
+	});
+}
+
+template <size_t K, typename X, typename C>
+auto Chain(X& x, C& c)
+{
+	if constexpr (K == 0)
+	{
+		return x * c;
+	}
+	else
+	{
+		return Chain<K - 1>(x, c) + sin(x * c);
+	}
+}
+
+template <size_t K, typename V>
+void ChainGraph(Bench::Runner& Runner, std::string const& Type, V const& Start)
+{
+	Et::ConstantExpr C{ V{ 0.5 } };
+	Et::VariableExpr X{ Start };
+	Et::PlaceholderExpr<V> P;
+
+	auto Y = Chain<K>(X, C) + P;
+	Et::GradientDescentOptimizer Optimizer{ Y };
+	constexpr uint64_t Nodes = 5 * K + 5;
+	std::string const Suffix = "/" + Type + "/" + std::to_string(Nodes) + "nodes";
+
+	Runner.Run("autodiff/forward" + Suffix, Nodes, 0, [&]()
+	{
+		Optimizer.ForwardPass(Et::H(P, V{ 1.0 }));
+		Bench::DoNotOptimize(Optimizer.GetPreResult());
+	});
+	Runner.Run("autodiff/forward+minimize" + Suffix, Nodes, 0, [&]()
+	{
+		Optimizer.ForwardPass(Et::H(P, V{ 1.0 })).Minimize(1e-9);
+		Bench::DoNotOptimize(X());
+	});
+}
+
+void ScalarAndPackGraphs(Bench::Runner& Runner)
+{
+	ChainGraph<0>(Runner, "scalar", Et::ScalarD{ 0.3 });
+	ChainGraph<4>(Runner, "scalar", Et::ScalarD{ 0.3 });
+	ChainGraph<16>(Runner, "scalar", Et::ScalarD{ 0.3 });
+	ChainGraph<0>(Runner, "pack8", Et::PackD<8>{ 0.3 });
+	ChainGraph<4>(Runner, "pack8", Et::PackD<8>{ 0.3 });
+	ChainGraph<16>(Runner, "pack8", Et::PackD<8>{ 0.3 });
+}
+
+template <size_t N>
+void WideGraph(Bench::Runner& Runner)
+{
+	using V = Et::PackD<N>;
+	Et::ConstantExpr C{ V{ 0.5 } };
+	Et::VariableExpr X1{ V{ 0.1 } }, X2{ V{ 0.2 } }, X3{ V{ 0.3 } }, X4{ V{ 0.4 } };
+	Et::PlaceholderExpr<V> P;
+
+	auto Y = (sin(X1 * C) + cos(X2 * X1)) * (sin(X3 * C) + cos(X4 * X3)) + (X1 * X2 + X3 * X4) * P;
+	Et::GradientDescentOptimizer Optimizer{ Y };
+	Et::ThreadPool Pool{ std::max<size_t>(Runner.GetOptions().threads, 2) - 1 };
+	std::string const Suffix = "/pack" + std::to_string(N);
+
+	Runner.Run("autodiff/wide/sequential" + Suffix, N, 0, [&]()
+	{
+		Optimizer.ForwardPass(Et::H(P, V{ 1e-9 })).Minimize(1e-9);
+		Bench::DoNotOptimize(X1());
+	});
+	Runner.Run("autodiff/wide/parallel" + Suffix, N, 0, [&]()
+	{
+		Optimizer.ParallelForwardPass(Pool, Et::H(P, V{ 1e-9 })).ParallelMinimize(Pool, 1e-9);
+		Bench::DoNotOptimize(X1());
+	});
+}
+
+void OptimizerUpdates(Bench::Runner& Runner)
+{
+	Et::ConstantExpr C1{ 4 }, C2{ 2 };
+	Et::VariableExpr X1{ 5.53 }, X2{ -3.12 };
+	Et::PlaceholderExpr P;
+
+	auto Y = X1 * X1 + X2 * X2 + C1 * X1 + C2 * X2 + P;
+	Et::GradientDescentOptimizer Optimizer{ Y };
+
+	Runner.Run("update/et/readme", 1, 0, [&]()
+	{
+		Optimizer.ForwardPass(Et::H(P, -6.3)).Minimize(0.01);
+		Bench::DoNotOptimize(X1());
+	});
+
+	auto Program = Et::Runtime::Compile("x1^2 + x2^2 + 4*x1 + 2*x2 + p", { "x1", "x2" }, { "p" });
+	Et::Runtime::Evaluator Evaluator{ Program };
+	double Variables[2]{ 5.53, -3.12 }, Placeholders[1]{ -6.3 }, Gradient[2];
+
+	Runner.Run("update/runtime/readme", 1, 0, [&]()
+	{
+		Evaluator.Gradient(Variables, Placeholders, Gradient);
+		Variables[0] -= 0.01 * Gradient[0];
+		Variables[1] -= 0.01 * Gradient[1];
+		Bench::DoNotOptimize(Variables[0]);
+	});
+
+	Runner.Run("update/generated/readme", 1, 0, [&]()
+	{
+		ReadmeObjective_gradient(Variables, Placeholders, Gradient);
+		Variables[0] -= 0.01 * Gradient[0];
+		Variables[1] -= 0.01 * Gradient[1];
+		Bench::DoNotOptimize(Variables[0]);
+	});
+}
+
+int main(int argc, char** argv)
+{
+	Bench::Runner Runner{ Bench::ParseOptions(argc, argv) };
+	if (Runner.GetOptions().scaling)
+	{
+		Bench::ScalingSuite{ Runner }.Run();
+		return 0;
+	}
+	if (Runner.GetOptions().compile_cost)
+	{
+		return Bench::CompileCostSuite{ Runner }.Run();
+	}
+	if (Runner.GetOptions().convergence)
+	{
+		Bench::ConvergenceSuite{ Runner }.Run();
+		return 0;
+	}
+	Runner.PrintHeader(std::cout);
+
+	AllTensorOps(Runner, std::make_index_sequence<9>{});
+	MatmulOp<16>(Runner);
+	MatmulOp<64>(Runner);
+	MatmulOp<256>(Runner);
+	ScalarAndPackGraphs(Runner);
+	WideGraph<256>(Runner);
+	WideGraph<4096>(Runner);
+	OptimizerUpdates(Runner);
+
+	Runner.Finish();
+	return 0;
+}
@@ -0,0 +1,352 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Bench {
+
+	template <typename T>
+	inline auto DoNotOptimize(T const& value) -> void
+	{
+#if defined(_MSC_VER)
+		static char volatile sink;
+		sink = *reinterpret_cast<char const volatile*>(&value);
+		_ReadWriteBarrier();
+#else
+		asm volatile("" : : "r,m"(value) : "memory");
+#endif
+	}
+
+	struct Options
+	{
+		uint64_t max_bytes = uint64_t{ 64 } << 20;
+		int warmup = 2;
+		int repetitions = 15;
+		double min_repetition_seconds = 0.002;
+		double max_benchmark_seconds = 2.0;
+		size_t threads = std::max(1u, std::thread::hardware_concurrency());
+		bool scaling = false;
+		bool convergence = false;
+		bool compile_cost = false;
+		std::string filter;
+		std::string json_path;
+		std::string csv_path;
+		std::string compare_path;
+		std::string compiler;
+	};
+
+	struct Result
+	{
+		std::string name;
+		uint64_t items;
+		uint64_t bytes;
+		uint64_t batch;
+		std::vector<double> samples;
+		double median_ns;
+		double p90_ns;
+		double p99_ns;
+		double min_ns;
+	};
+
+	inline auto _impl_Percentile(std::vector<double> const& sorted, double fraction) -> double
+	{
+		double const position = fraction * static_cast<double>(sorted.size() - 1);
+		size_t const lower = static_cast<size_t>(position);
+		size_t const upper = std::min(lower + 1, sorted.size() - 1);
+		return sorted[lower] + (sorted[upper] - sorted[lower]) * (position - static_cast<double>(lower));
+	}
+
+	class Runner
+	{
+	private:
+		Options _options;
+		std::vector<Result> _results;
+
+		using clock_t = std::chrono::steady_clock;
+
+		template <typename F>
+		static auto _impl_TimeBatch(F& body, uint64_t batch) -> double
+		{
+			auto const begin = clock_t::now();
+			for (uint64_t i = 0; i < batch; i++)
+			{
+				body();
+			}
+			return std::chrono::duration<double>(clock_t::now() - begin).count();
+		}
+
+	public:
+		Runner(Options options) : _options{ std::move(options) } {}
+
+		auto GetOptions() const -> Options const&
+		{
+			return _options;
+		}
+
+		auto Fits(uint64_t bytes) const -> bool
+		{
+			return bytes <= _options.max_bytes;
+		}
+
+		template <typename F>
+		auto Measure(std::string const& name, uint64_t items, uint64_t bytes, F&& body) const -> Result
+		{
+			uint64_t batch = 1;
+			double elapsed = _impl_TimeBatch(body, batch);
+			while (elapsed < _options.min_repetition_seconds && batch < (uint64_t{ 1 } << 40))
+			{
+				batch *= elapsed > 0.0 ? std::clamp<uint64_t>(static_cast<uint64_t>(_options.min_repetition_seconds / elapsed * 1.2), 2, 100) : 100;
+				elapsed = _impl_TimeBatch(body, batch);
+			}
+			for (int i = 1; i < _options.warmup; i++)
+			{
+				_impl_TimeBatch(body, batch);
+			}
+
+			Result result{ name, items, bytes, batch, {}, 0.0, 0.0, 0.0, 0.0 };
+			double total = 0.0;
+			for (int i = 0; i < _options.repetitions; i++)
+			{
+				double const seconds = _impl_TimeBatch(body, batch);
+				result.samples.push_back(seconds * 1e9 / static_cast<double>(batch));
+				total += seconds;
+				if (total > _options.max_benchmark_seconds && result.samples.size() >= 3)
+				{
+					break;
+				}
+			}
+
+			std::vector<double> sorted = result.samples;
+			std::sort(sorted.begin(), sorted.end());
+			result.median_ns = _impl_Percentile(sorted, 0.5);
+			result.p90_ns = _impl_Percentile(sorted, 0.9);
+			result.p99_ns = _impl_Percentile(sorted, 0.99);
+			result.min_ns = sorted.front();
+			return result;
+		}
+
+		template <typename F>
+		auto Run(std::string const& name, uint64_t items, uint64_t bytes, F&& body) -> void
+		{
+			if (!Selected(name))
+			{
+				return;
+			}
+			Result result = Measure(name, items, bytes, std::forward<F>(body));
+			_impl_PrintRow(std::cout, result);
+			_results.push_back(std::move(result));
+		}
+
+		auto Selected(std::string const& name) const -> bool
+		{
+			return _options.filter.empty() || name.find(_options.filter) != std::string::npos;
+		}
+
+		auto PrintHeader(std::ostream& stream) const -> void
+		{
+			stream << std::left << std::setw(44) << "benchmark" << std::right << std::setw(14) << "median ns" << std::setw(14) << "p90 ns"
+				<< std::setw(14) << "p99 ns" << std::setw(14) << "items/s" << std::setw(12) << "GB/s" << std::setw(6) << "reps" << '\n';
+		}
+
+		auto WriteJson(std::ostream& stream) const -> void
+		{
+			auto const flags = stream.flags();
+			auto const precision = stream.precision();
+			stream << "{\n\"context\": {\"max_bytes\": " << _options.max_bytes << ", \"repetitions\": " << _options.repetitions
+				<< ", \"warmup\": " << _options.warmup << ", \"compiler\": \"" << _impl_Compiler() << "\"},\n\"benchmarks\": [\n";
+			for (size_t i = 0; i < _results.size(); i++)
+			{
+				auto const& result = _results[i];
+				stream << std::setprecision(6) << "{\"name\": \"" << result.name << "\", \"items\": " << result.items << ", \"bytes\": " << result.bytes
+					<< ", \"batch\": " << result.batch << ", \"repetitions\": " << result.samples.size()
+					<< ", \"median_ns\": " << result.median_ns << ", \"p90_ns\": " << result.p90_ns << ", \"p99_ns\": " << result.p99_ns
+					<< ", \"min_ns\": " << result.min_ns << ", \"items_per_second\": " << _impl_PerSecond(result.items, result.median_ns)
+					<< ", \"bytes_per_second\": " << _impl_PerSecond(result.bytes, result.median_ns) << "}" << (i + 1 < _results.size() ? "," : "") << '\n';
+			}
+			stream << "]\n}\n";
+			stream.flags(flags);
+			stream.precision(precision);
+		}
+
+		auto Compare(std::istream& baseline, std::ostream& stream) const -> void
+		{
+			std::map<std::string, double> medians;
+			std::string line;
+			while (std::getline(baseline, line))
+			{
+				size_t const name = line.find("\"name\": \"");
+				size_t const median = line.find("\"median_ns\": ");
+				if (name != std::string::npos && median != std::string::npos)
+				{
+					size_t const begin = name + 9;
+					medians[line.substr(begin, line.find('"', begin) - begin)] = std::atof(line.c_str() + median + 13);
+				}
+			}
+
+			auto const flags = stream.flags();
+			auto const precision = stream.precision();
+			stream << '\n' << std::left << std::setw(44) << "benchmark" << std::right << std::setw(14) << "baseline ns" << std::setw(14) << "current ns" << std::setw(10) << "speedup" << '\n';
+			for (auto const& result : _results)
+			{
+				auto const it = medians.find(result.name);
+				if (it != medians.end() && result.median_ns > 0.0)
+				{
+					stream << std::left << std::setw(44) << result.name << std::right << std::fixed << std::setprecision(1)
+						<< std::setw(14) << it->second << std::setw(14) << result.median_ns << std::setprecision(3) << std::setw(9) << it->second / result.median_ns << "x\n";
+				}
+			}
+			stream.flags(flags);
+			stream.precision(precision);
+		}
+
+		auto Finish() const -> void
+		{
+			if (!_options.json_path.empty())
+			{
+				std::ofstream stream{ _options.json_path };
+				WriteJson(stream);
+			}
+			if (!_options.compare_path.empty())
+			{
+				std::ifstream baseline{ _options.compare_path };
+				if (baseline)
+				{
+					Compare(baseline, std::cout);
+				}
+				else
+				{
+					std::cerr << "cannot read baseline " << _options.compare_path << '\n';
+				}
+			}
+		}
+
+	private:
+		static auto _impl_PerSecond(uint64_t count, double ns) -> double
+		{
+			return ns > 0.0 ? static_cast<double>(count) * 1e9 / ns : 0.0;
+		}
+
+		static auto _impl_Compiler() -> std::string
+		{
+			std::ostringstream stream;
+#if defined(__clang__)
+			stream << "clang " << __clang_major__ << '.' << __clang_minor__;
+#elif defined(__GNUC__)
+			stream << "gcc " << __GNUC__ << '.' << __GNUC_MINOR__;
+#elif defined(_MSC_VER)
+			stream << "msvc " << _MSC_VER;
+#else
+			stream << "unknown";
+#endif
+			return stream.str();
+		}
+
+		static auto _impl_PrintRow(std::ostream& stream, Result const& result) -> void
+		{
+			auto const flags = stream.flags();
+			auto const precision = stream.precision();
+			stream << std::left << std::setw(44) << result.name << std::right << std::fixed << std::setprecision(1)
+				<< std::setw(14) << result.median_ns << std::setw(14) << result.p90_ns << std::setw(14) << result.p99_ns
+				<< std::scientific << std::setprecision(3) << std::setw(14) << _impl_PerSecond(result.items, result.median_ns)
+				<< std::fixed << std::setprecision(2) << std::setw(12) << _impl_PerSecond(result.bytes, result.median_ns) * 1e-9
+				<< std::setw(6) << result.samples.size() << '\n';
+			stream.flags(flags);
+			stream.precision(precision);
+		}
+	};
+
+	inline auto ParseOptions(int argc, char** argv) -> Options
+	{
+		Options options;
+		for (int i = 1; i < argc; i++)
+		{
+			std::string const flag = argv[i];
+			if (flag == "--scaling")
+			{
+				options.scaling = true;
+				continue;
+			}
+			if (flag == "--convergence")
+			{
+				options.convergence = true;
+				continue;
+			}
+			if (flag == "--compile-cost")
+			{
+				options.compile_cost = true;
+				continue;
+			}
+			char const* value = i + 1 < argc ? argv[i + 1] : nullptr;
+			if (value == nullptr)
+			{
+				std::cerr << "missing value for " << flag << '\n';
+				std::exit(2);
+			}
+			if (flag == "--max-bytes")
+			{
+				options.max_bytes = std::strtoull(value, nullptr, 10);
+			}
+			else if (flag == "--warmup")
+			{
+				options.warmup = std::atoi(value);
+			}
+			else if (flag == "--repetitions")
+			{
+				options.repetitions = std::max(1, std::atoi(value));
+			}
+			else if (flag == "--min-time")
+			{
+				options.min_repetition_seconds = std::atof(value);
+			}
+			else if (flag == "--max-time")
+			{
+				options.max_benchmark_seconds = std::atof(value);
+			}
+			else if (flag == "--threads")
+			{
+				options.threads = std::max(1, std::atoi(value));
+			}
+			else if (flag == "--filter")
+			{
+				options.filter = value;
+			}
+			else if (flag == "--json")
+			{
+				options.json_path = value;
+			}
+			else if (flag == "--csv")
+			{
+				options.csv_path = value;
+			}
+			else if (flag == "--compare")
+			{
+				options.compare_path = value;
+			}
+			else if (flag == "--compiler")
+			{
+				options.compiler = value;
+			}
+			else
+			{
+				std::cerr << "unknown flag " << flag << "\nflags: --max-bytes N --warmup N --repetitions N --min-time S --max-time S --filter TEXT --json PATH --compare PATH --scaling --convergence --compile-cost --compiler PATH --threads N --csv PATH\n";
+				std::exit(2);
+			}
+			i++;
+		}
+		return options;
+	}
+}
@@ -0,0 +1,391 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "benchmark.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define ET_BENCH_HAS_FORK 1
+#endif
+
+#if !defined(ET_AUTODIFF_BENCHMARK_CXX)
+#define ET_AUTODIFF_BENCHMARK_CXX "c++"
+#endif
+
+#if !defined(ET_AUTODIFF_BENCHMARK_INCLUDE_DIR)
+#define ET_AUTODIFF_BENCHMARK_INCLUDE_DIR "ET_AutoDiff"
+#endif
+
+namespace Bench {
+
+	struct CompileCase
+	{
+		std::string name;
+		std::string source;
+	};
+
+	struct CompileCost
+	{
+		std::string name;
+		bool ok;
+		double seconds;
+		double cpu_seconds;
+		uint64_t max_rss_bytes;
+		uint64_t object_bytes;
+	};
+
+	class CompileCostSuite
+	{
+	private:
+		Runner const& _runner;
+		std::string _compiler;
+		std::string _compiler_id;
+		std::filesystem::path _work_dir;
+		std::vector<CompileCost> _results;
+
+		constexpr static double memory_tolerance_v = 1.10;
+		constexpr static double object_tolerance_v = 1.05;
+		constexpr static char const* reference_case_v = "compile/include";
+
+		static auto _impl_Prelude() -> std::string
+		{
+			return "#include \"et_autodiff.h\"\n#include \"tensor.h\"\n\n";
+		}
+
+		static auto _impl_GraphSource(size_t terms) -> std::string
+		{
+			std::ostringstream source;
+			source << _impl_Prelude()
+				<< "auto Train(double start, double placeholder) -> double\n{\n"
+				<< "\tEt::ConstantExpr C{ 0.5 };\n\tEt::VariableExpr X{ start };\n\tEt::PlaceholderExpr P;\n\n\tauto Y = X * C";
+			for (size_t i = 1; i < terms; i++)
+			{
+				source << " + sin(X * C)";
+			}
+			source << " + P;\n\tEt::GradientDescentOptimizer Optimizer{ Y };\n"
+				<< "\treturn Optimizer.ForwardPass(Et::H(P, placeholder)).Minimize(0.01).GetPreResult();\n}\n";
+			return source.str();
+		}
+
+		static auto _impl_TensorSource(size_t rank) -> std::string
+		{
+			std::string dims, indices;
+			for (size_t i = 0; i < rank; i++)
+			{
+				dims += ", 2";
+				indices += i == 0 ? "0" : ", 0";
+			}
+			std::ostringstream source;
+			source << _impl_Prelude()
+				<< "auto Evaluate(double value) -> double\n{\n"
+				<< "\tauto A = TTest::TensorFactory::MakeTensorWithInitValue<double" << dims << ">(value);\n"
+				<< "\tauto B = A + A * A;\n\tauto C = TTest::sin(B) - B;\n"
+				<< "\treturn TTest::sum(C) + C(" << indices << ");\n}\n";
+			return source.str();
+		}
+
+		auto _impl_Cases() const -> std::vector<CompileCase>
+		{
+			std::vector<CompileCase> cases;
+			cases.push_back({ "compile/include", _impl_Prelude() + "auto Touch() -> int\n{\n\treturn 0;\n}\n" });
+			for (size_t terms : { 1, 4, 8, 16 })
+			{
+				cases.push_back({ "compile/graph/" + std::to_string(terms) + "terms", _impl_GraphSource(terms) });
+			}
+			for (size_t rank = 1; rank <= 6; rank++)
+			{
+				cases.push_back({ "compile/tensor/rank" + std::to_string(rank), _impl_TensorSource(rank) });
+			}
+			return cases;
+		}
+
+		auto _impl_Compile(std::filesystem::path const& source, std::filesystem::path const& object) const -> CompileCost
+		{
+			CompileCost cost{ {}, false, 0.0, 0.0, 0, 0 };
+#if defined(ET_BENCH_HAS_FORK)
+			std::vector<std::string> arguments{ _compiler, "-std=c++17", "-O2", "-I", ET_AUTODIFF_BENCHMARK_INCLUDE_DIR, "-c", source.string(), "-o", object.string() };
+			std::vector<char*> argv;
+			for (auto& argument : arguments)
+			{
+				argv.push_back(argument.data());
+			}
+			argv.push_back(nullptr);
+
+			std::filesystem::remove(object);
+			auto const begin = std::chrono::steady_clock::now();
+			pid_t const pid = fork();
+			if (pid == 0)
+			{
+				execvp(argv[0], argv.data());
+				_exit(127);
+			}
+			if (pid < 0)
+			{
+				return cost;
+			}
+
+			int status = 0;
+			rusage usage{};
+			if (wait4(pid, &status, 0, &usage) != pid)
+			{
+				return cost;
+			}
+			cost.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			cost.cpu_seconds = static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#if defined(__APPLE__)
+			cost.max_rss_bytes = static_cast<uint64_t>(usage.ru_maxrss);
+#else
+			cost.max_rss_bytes = static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+			cost.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 && std::filesystem::exists(object);
+			cost.object_bytes = cost.ok ? static_cast<uint64_t>(std::filesystem::file_size(object)) : 0;
+#else
+			(void)source;
+			(void)object;
+#endif
+			return cost;
+		}
+
+		auto _impl_Measure(CompileCase const& compile_case) const -> CompileCost
+		{
+			std::string file = compile_case.name;
+			std::replace(file.begin(), file.end(), '/', '_');
+			auto const source = _work_dir / (file + ".cpp");
+			auto const object = _work_dir / (file + ".o");
+			std::ofstream{ source } << compile_case.source;
+
+			CompileCost best{ compile_case.name, false, 0.0, 0.0, 0, 0 };
+			for (int i = 0; i < _runner.GetOptions().repetitions; i++)
+			{
+				CompileCost const cost = _impl_Compile(source, object);
+				if (!cost.ok)
+				{
+					return best;
+				}
+				best.seconds = best.ok ? std::min(best.seconds, cost.seconds) : cost.seconds;
+				best.cpu_seconds = best.ok ? std::min(best.cpu_seconds, cost.cpu_seconds) : cost.cpu_seconds;
+				best.max_rss_bytes = std::max(best.max_rss_bytes, cost.max_rss_bytes);
+				best.object_bytes = cost.object_bytes;
+				best.ok = true;
+			}
+			return best;
+		}
+
+		static auto _impl_PrintRow(std::ostream& stream, CompileCost const& cost) -> void
+		{
+			auto const flags = stream.flags();
+			auto const precision = stream.precision();
+			stream << std::left << std::setw(32) << cost.name << std::right;
+			if (cost.ok)
+			{
+				stream << std::fixed << std::setprecision(3) << std::setw(12) << cost.seconds << std::setw(12) << cost.cpu_seconds
+					<< std::setprecision(1) << std::setw(14) << static_cast<double>(cost.max_rss_bytes) / (1 << 20)
+					<< std::setw(14) << cost.object_bytes << '\n';
+			}
+			else
+			{
+				stream << std::setw(12) << "failed" << '\n';
+			}
+			stream.flags(flags);
+			stream.precision(precision);
+		}
+
+		static auto _impl_ReferenceSeconds(std::vector<CompileCost> const& costs) -> double
+		{
+			for (auto const& cost : costs)
+			{
+				if (cost.name == reference_case_v && cost.ok)
+				{
+					return cost.cpu_seconds;
+				}
+			}
+			return 0.0;
+		}
+
+		// The first line of --version names the compiler and its release, which is what the costs depend on;
+		// the path alone does not, since /usr/bin/c++ can point at a different compiler on every machine
+		auto _impl_Identify() const -> std::string
+		{
+			std::string id;
+#if defined(ET_BENCH_HAS_FORK)
+			if (FILE* const pipe = popen((_compiler + " --version 2>/dev/null").c_str(), "r"))
+			{
+				char buffer[256];
+				if (std::fgets(buffer, sizeof(buffer), pipe) != nullptr)
+				{
+					id = buffer;
+				}
+				pclose(pipe);
+			}
+#endif
+			id.erase(std::remove_if(id.begin(), id.end(), [](char c) { return c == '"' || c == '\\' || c == '\n' || c == '\r'; }), id.end());
+			return id.empty() ? _compiler : id;
+		}
+
+		static auto _impl_Text(std::string const& line, std::string const& key) -> std::string
+		{
+			size_t const position = line.find("\"" + key + "\": \"");
+			if (position == std::string::npos)
+			{
+				return {};
+			}
+			size_t const begin = position + key.size() + 5;
+			return line.substr(begin, line.find('"', begin) - begin);
+		}
+
+		static auto _impl_Field(std::string const& line, std::string const& key) -> double
+		{
+			size_t const position = line.find("\"" + key + "\": ");
+			return position == std::string::npos ? 0.0 : std::atof(line.c_str() + position + key.size() + 4);
+		}
+
+	public:
+		CompileCostSuite(Runner const& runner) : _runner{ runner },
+			_compiler{ runner.GetOptions().compiler.empty() ? ET_AUTODIFF_BENCHMARK_CXX : runner.GetOptions().compiler },
+			_compiler_id{ _impl_Identify() }, _work_dir{ std::filesystem::temp_directory_path() / "et_autodiff_compile_cost" } {}
+
+		auto WriteJson(std::ostream& stream) const -> void
+		{
+			stream << "{\n\"context\": {\"compiler\": \"" << _compiler << "\", \"compiler_id\": \"" << _compiler_id << "\", \"repetitions\": " << _runner.GetOptions().repetitions << "},\n\"compile\": [\n";
+			for (size_t i = 0; i < _results.size(); i++)
+			{
+				auto const& cost = _results[i];
+				stream << "{\"name\": \"" << cost.name << "\", \"ok\": " << (cost.ok ? "true" : "false") << ", \"seconds\": " << cost.seconds
+					<< ", \"cpu_seconds\": " << cost.cpu_seconds << ", \"max_rss_bytes\": " << cost.max_rss_bytes
+					<< ", \"object_bytes\": " << cost.object_bytes << "}" << (i + 1 < _results.size() ? "," : "") << '\n';
+			}
+			stream << "]\n}\n";
+		}
+
+		// Returns the number of regressions, or nothing when the baseline was recorded with another compiler and the costs are not comparable
+		auto Compare(std::istream& baseline, std::ostream& stream) const -> std::optional<size_t>
+		{
+			std::map<std::string, CompileCost> costs;
+			std::vector<CompileCost> baseline_costs;
+			std::string baseline_id;
+			std::string line;
+			while (std::getline(baseline, line))
+			{
+				if (line.find("\"context\": ") != std::string::npos)
+				{
+					baseline_id = _impl_Text(line, "compiler_id");
+				}
+				size_t const name = line.find("\"name\": \"");
+				if (name != std::string::npos)
+				{
+					size_t const begin = name + 9;
+					std::string const key = line.substr(begin, line.find('"', begin) - begin);
+					costs[key] = { key, true, _impl_Field(line, "seconds"), _impl_Field(line, "cpu_seconds"),
+						static_cast<uint64_t>(_impl_Field(line, "max_rss_bytes")), static_cast<uint64_t>(_impl_Field(line, "object_bytes")) };
+					baseline_costs.push_back(costs[key]);
+				}
+			}
+
+			if (baseline_id != _compiler_id)
+			{
+				stream << "\nbaseline was recorded with " << (baseline_id.empty() ? std::string{ "an unrecorded compiler" } : "'" + baseline_id + "'")
+					<< ", this run uses '" << _compiler_id << "'; skipping the comparison, record a baseline for this compiler with the compile-cost-baseline target\n";
+				return std::nullopt;
+			}
+
+			double const reference = _impl_ReferenceSeconds(_results);
+			double const baseline_reference = _impl_ReferenceSeconds(baseline_costs);
+			bool const timed = reference > 0.0 && baseline_reference > 0.0;
+
+			auto const flags = stream.flags();
+			auto const precision = stream.precision();
+			stream << '\n' << std::left << std::setw(32) << "benchmark" << std::right << std::setw(12) << "rel. time" << std::setw(12) << "memory" << std::setw(12) << "object" << '\n';
+			size_t regressions = 0;
+			for (auto const& cost : _results)
+			{
+				auto const it = costs.find(cost.name);
+				if (it == costs.end() || !cost.ok)
+				{
+					continue;
+				}
+				double const time_ratio = timed && it->second.cpu_seconds > 0.0
+					? (cost.cpu_seconds / reference) / (it->second.cpu_seconds / baseline_reference) : 0.0;
+				double const memory_ratio = static_cast<double>(cost.max_rss_bytes) / static_cast<double>(std::max<uint64_t>(it->second.max_rss_bytes, 1));
+				double const object_ratio = static_cast<double>(cost.object_bytes) / static_cast<double>(std::max<uint64_t>(it->second.object_bytes, 1));
+				bool const regressed = memory_ratio > memory_tolerance_v || object_ratio > object_tolerance_v;
+				regressions += regressed ? 1 : 0;
+				stream << std::left << std::setw(32) << cost.name << std::right << std::fixed << std::setprecision(3);
+				if (time_ratio > 0.0)
+				{
+					stream << std::setw(11) << time_ratio << 'x';
+				}
+				else
+				{
+					stream << std::setw(12) << "-";
+				}
+				stream << std::setw(11) << memory_ratio << 'x' << std::setw(11) << object_ratio << 'x' << (regressed ? "  REGRESSION" : "") << '\n';
+			}
+			stream << "time is relative to " << reference_case_v << " in the same run and is not gated; memory and object size are gated\n";
+			stream.flags(flags);
+			stream.precision(precision);
+			return regressions;
+		}
+
+		auto Run() -> int
+		{
+#if !defined(ET_BENCH_HAS_FORK)
+			std::cerr << "compile cost measurement needs fork and wait4\n";
+			return 2;
+#else
+			std::filesystem::create_directories(_work_dir);
+			std::cout << "compiler: " << _compiler << " (" << _compiler_id << ")\n" << std::left << std::setw(32) << "benchmark" << std::right << std::setw(12) << "wall s"
+				<< std::setw(12) << "cpu s" << std::setw(14) << "peak MiB" << std::setw(14) << "object bytes" << '\n';
+
+			bool failed = false;
+			for (auto const& compile_case : _impl_Cases())
+			{
+				if (!_runner.Selected(compile_case.name))
+				{
+					continue;
+				}
+				CompileCost const cost = _impl_Measure(compile_case);
+				_impl_PrintRow(std::cout, cost);
+				failed = failed || !cost.ok;
+				_results.push_back(cost);
+			}
+
+			auto const& options = _runner.GetOptions();
+			if (!options.json_path.empty())
+			{
+				std::ofstream stream{ options.json_path };
+				WriteJson(stream);
+			}
+			size_t regressions = 0;
+			if (!options.compare_path.empty())
+			{
+				std::ifstream baseline{ options.compare_path };
+				if (!baseline)
+				{
+					std::cerr << "cannot read baseline " << options.compare_path << ", refresh it with the compile-cost-baseline target\n";
+					return 1;
+				}
+				regressions = Compare(baseline, std::cout).value_or(0);
+			}
+			if (regressions > 0)
+			{
+				std::cout << regressions << " compile cost regression(s) against " << options.compare_path << '\n';
+			}
+			return failed || regressions > 0 ? 1 : 0;
+#endif
+		}
+	};
+}
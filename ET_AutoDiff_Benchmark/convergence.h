@@ -0,0 +1,330 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+#include "benchmark.h"
+#include "et_autodiff.h"
+#include "runtime_expr.h"
+#include "readme_objective_generated.h"
+
+namespace Bench {
+
+	struct CurvePoint
+	{
+		uint64_t iteration;
+		double seconds;
+		double loss;
+	};
+
+	struct ConvergenceResult
+	{
+		std::string problem;
+		std::string optimizer;
+		double learning_rate;
+		uint64_t iterations;
+		double seconds;
+		double final_loss;
+		bool converged;
+		std::vector<CurvePoint> curve;
+	};
+
+	struct StepResult
+	{
+		double loss;
+		bool converged;
+	};
+
+	class Dataset
+	{
+	private:
+		size_t _n_features;
+		std::vector<double> _samples;
+
+	public:
+		Dataset(size_t n_samples, size_t n_features, double noise_stddev, bool binary_labels) : _n_features{ n_features }, _samples(n_samples * (n_features + 1))
+		{
+			std::mt19937 rng{ 42 };
+			std::uniform_real_distribution<double> feature{ -1.0, 1.0 };
+			std::normal_distribution<double> noise{ 0.0, noise_stddev };
+			for (size_t i = 0; i < n_samples; i++)
+			{
+				double* sample = &_samples[i * (n_features + 1)];
+				double target = 0.5;
+				for (size_t j = 0; j < n_features; j++)
+				{
+					sample[j] = feature(rng);
+					target += (j % 2 == 0 ? 1.5 : -2.0) * sample[j];
+				}
+				target += noise(rng);
+				sample[n_features] = binary_labels ? (target > 0.0 ? 1.0 : -1.0) : target;
+			}
+		}
+
+		auto Size() const -> size_t
+		{
+			return _samples.size() / (_n_features + 1);
+		}
+
+		auto Sample(size_t i) const -> double const*
+		{
+			return &_samples[i * (_n_features + 1)];
+		}
+	};
+
+	class ConvergenceSuite
+	{
+	private:
+		Runner const& _runner;
+		std::vector<ConvergenceResult> _results;
+
+		constexpr static uint64_t max_iterations_v = 1000000;
+
+		template <typename F>
+		auto _impl_Track(std::string const& problem, std::string const& optimizer, double learning_rate, F&& step) -> void
+		{
+			if (!_runner.Selected(problem + "/" + optimizer))
+			{
+				return;
+			}
+
+			using clock_t = std::chrono::steady_clock;
+			double const budget = _runner.GetOptions().max_benchmark_seconds;
+			ConvergenceResult result{ problem, optimizer, learning_rate, 0, 0.0, 0.0, false, {} };
+			uint64_t next_sample = 1;
+			auto const begin = clock_t::now();
+			double seconds = 0.0;
+
+			while (result.iterations < max_iterations_v)
+			{
+				StepResult const step_result = step();
+				result.iterations++;
+				result.final_loss = step_result.loss;
+				result.converged = step_result.converged;
+				bool const sample = result.iterations >= next_sample || result.converged || !std::isfinite(step_result.loss);
+				if (sample || result.iterations % 64 == 0)
+				{
+					seconds = std::chrono::duration<double>(clock_t::now() - begin).count();
+				}
+				if (sample)
+				{
+					result.curve.push_back({ result.iterations, seconds, step_result.loss });
+					next_sample = result.iterations + result.iterations / 4 + 1;
+				}
+				if (result.converged || !std::isfinite(step_result.loss) || seconds > budget)
+				{
+					break;
+				}
+			}
+			result.seconds = std::chrono::duration<double>(clock_t::now() - begin).count();
+			if (result.curve.empty() || result.curve.back().iteration != result.iterations)
+			{
+				result.curve.push_back({ result.iterations, result.seconds, result.final_loss });
+			}
+
+			_impl_PrintRow(std::cout, result);
+			_results.push_back(std::move(result));
+		}
+
+		static auto _impl_PrintRow(std::ostream& stream, ConvergenceResult const& result) -> void
+		{
+			auto const flags = stream.flags();
+			auto const precision = stream.precision();
+			stream << std::left << std::setw(22) << result.problem << std::setw(12) << result.optimizer << std::right
+				<< std::setw(10) << result.learning_rate << std::setw(12) << result.iterations
+				<< std::setw(16) << std::setprecision(8) << result.final_loss
+				<< std::setw(16) << std::fixed << std::setprecision(3) << result.seconds * 1e3 << std::setw(16);
+			if (result.converged)
+			{
+				stream << result.seconds * 1e3 << '\n';
+			}
+			else
+			{
+				stream << "-" << '\n';
+			}
+			stream.flags(flags);
+			stream.precision(precision);
+		}
+
+		template <typename E>
+		auto _impl_EtGraph(std::string const& problem, double learning_rate, double optimum, double tolerance, E& expr) -> void
+		{
+			Et::GradientDescentOptimizer optimizer{ expr };
+			_impl_Track(problem, "et", learning_rate, [&]() -> StepResult
+			{
+				double const loss = optimizer.ForwardPass().Minimize(learning_rate).GetPreResult();
+				return { loss, std::abs(loss - optimum) <= tolerance };
+			});
+		}
+
+		auto _impl_Runtime(std::string const& problem, std::string const& optimizer_name, double learning_rate, double tolerance,
+			Et::Runtime::Program const& program, Dataset const& data, std::vector<double> variables) -> void
+		{
+			Et::Runtime::Evaluator evaluator{ program };
+			size_t const n_variables = variables.size();
+			std::vector<double> gradient(n_variables), total(n_variables);
+			double const scale = 1.0 / static_cast<double>(data.Size());
+
+			_impl_Track(problem, optimizer_name, learning_rate, [&]() -> StepResult
+			{
+				std::fill(total.begin(), total.end(), 0.0);
+				double loss = 0.0;
+				for (size_t i = 0; i < data.Size(); i++)
+				{
+					loss += evaluator.Gradient(variables.data(), data.Sample(i), gradient.data());
+					for (size_t j = 0; j < n_variables; j++)
+					{
+						total[j] += gradient[j];
+					}
+				}
+				double norm = 0.0;
+				for (size_t j = 0; j < n_variables; j++)
+				{
+					total[j] *= scale;
+					norm += total[j] * total[j];
+					variables[j] -= learning_rate * total[j];
+				}
+				return { loss * scale, std::sqrt(norm) <= tolerance };
+			});
+		}
+
+	public:
+		ConvergenceSuite(Runner const& runner) : _runner{ runner } {}
+
+		auto Readme() -> void
+		{
+			for (double learning_rate : { 0.01, 0.1 })
+			{
+				Et::ConstantExpr C1{ 4 }, C2{ 2 }, P{ -6.3 };
+				Et::VariableExpr X1{ 5.53 }, X2{ -3.12 };
+				auto Y = X1 * X1 + X2 * X2 + C1 * X1 + C2 * X2 + P;
+				_impl_EtGraph("readme", learning_rate, -11.3, 1e-9, Y);
+
+				auto const program = Et::Runtime::Compile("x1^2 + x2^2 + 4*x1 + 2*x2 - 6.3", { "x1", "x2" }, {});
+				Et::Runtime::Evaluator evaluator{ program };
+				double variables[2]{ 5.53, -3.12 }, gradient[2];
+				_impl_Track("readme", "runtime", learning_rate, [&]() -> StepResult
+				{
+					double const loss = evaluator.Gradient(variables, nullptr, gradient);
+					variables[0] -= learning_rate * gradient[0];
+					variables[1] -= learning_rate * gradient[1];
+					return { loss, std::abs(loss + 11.3) <= 1e-9 };
+				});
+
+				double generated_variables[2]{ 5.53, -3.12 }, placeholders[1]{ -6.3 };
+				_impl_Track("readme", "generated", learning_rate, [&]() -> StepResult
+				{
+					double const loss = ReadmeObjective_gradient(generated_variables, placeholders, gradient);
+					generated_variables[0] -= learning_rate * gradient[0];
+					generated_variables[1] -= learning_rate * gradient[1];
+					return { loss, std::abs(loss + 11.3) <= 1e-9 };
+				});
+			}
+		}
+
+		auto Rosenbrock() -> void
+		{
+			for (double learning_rate : { 0.0005, 0.001 })
+			{
+				Et::ConstantExpr A{ 1.0 }, B{ 100.0 };
+				Et::VariableExpr X{ -1.2 }, Y{ 1.0 };
+				auto F = (A - X) * (A - X) + B * (Y - X * X) * (Y - X * X);
+				_impl_EtGraph("rosenbrock", learning_rate, 0.0, 1e-6, F);
+
+				auto const program = Et::Runtime::Compile("(1 - x)^2 + 100*(y - x^2)^2", { "x", "y" }, {});
+				Et::Runtime::Evaluator evaluator{ program };
+				double variables[2]{ -1.2, 1.0 }, gradient[2];
+				_impl_Track("rosenbrock", "runtime", learning_rate, [&]() -> StepResult
+				{
+					double const loss = evaluator.Gradient(variables, nullptr, gradient);
+					variables[0] -= learning_rate * gradient[0];
+					variables[1] -= learning_rate * gradient[1];
+					return { loss, loss <= 1e-6 };
+				});
+			}
+		}
+
+		auto AtScale() -> void
+		{
+			size_t const n_samples = static_cast<size_t>(std::clamp<uint64_t>(_runner.GetOptions().max_bytes / 32, 256, 1 << 16));
+
+			Dataset const regression{ n_samples, 3, 0.1, false };
+			auto const least_squares = Et::Runtime::Compile("(w1*x1 + w2*x2 + w3*x3 + b - y)^2", { "w1", "w2", "w3", "b" }, { "x1", "x2", "x3", "y" });
+			for (double learning_rate : { 0.1, 0.5 })
+			{
+				_impl_Runtime("least-squares", "runtime", learning_rate, 1e-6, least_squares, regression, { 0.0, 0.0, 0.0, 0.0 });
+			}
+
+			Dataset const classification{ n_samples, 2, 1.0, true };
+			auto const logistic = Et::Runtime::Compile("log(1 + e^(-y*(w1*x1 + w2*x2 + b)))", { "w1", "w2", "b" }, { "x1", "x2", "y" });
+			for (double learning_rate : { 0.5, 2.0 })
+			{
+				_impl_Runtime("logistic", "runtime", learning_rate, 1e-4, logistic, classification, { 0.0, 0.0, 0.0 });
+			}
+		}
+
+		auto WriteCsv(std::ostream& stream) const -> void
+		{
+			stream << "problem,optimizer,learning_rate,iteration,seconds,loss\n";
+			for (auto const& result : _results)
+			{
+				for (auto const& point : result.curve)
+				{
+					stream << result.problem << ',' << result.optimizer << ',' << result.learning_rate << ','
+						<< point.iteration << ',' << point.seconds << ',' << std::setprecision(12) << point.loss << std::setprecision(6) << '\n';
+				}
+			}
+		}
+
+		auto WriteJson(std::ostream& stream) const -> void
+		{
+			stream << "{\n\"convergence\": [\n";
+			for (size_t i = 0; i < _results.size(); i++)
+			{
+				auto const& result = _results[i];
+				stream << "{\"problem\": \"" << result.problem << "\", \"optimizer\": \"" << result.optimizer << "\", \"learning_rate\": " << result.learning_rate
+					<< ", \"iterations\": " << result.iterations << ", \"seconds\": " << result.seconds << ", \"final_loss\": " << std::setprecision(12) << result.final_loss
+					<< std::setprecision(6) << ", \"converged\": " << (result.converged ? "true" : "false")
+					<< ", \"time_to_tolerance\": ";
+				if (result.converged)
+				{
+					stream << result.seconds;
+				}
+				else
+				{
+					stream << "null";
+				}
+				stream << "}" << (i + 1 < _results.size() ? "," : "") << '\n';
+			}
+			stream << "]\n}\n";
+		}
+
+		auto Run() -> void
+		{
+			std::cout << std::left << std::setw(22) << "problem" << std::setw(12) << "optimizer" << std::right << std::setw(10) << "lr"
+				<< std::setw(12) << "iterations" << std::setw(16) << "final loss" << std::setw(16) << "wall ms" << std::setw(16) << "to tol. ms" << '\n';
+
+			Readme();
+			Rosenbrock();
+			AtScale();
+
+			auto const& options = _runner.GetOptions();
+			if (!options.csv_path.empty())
+			{
+				std::ofstream stream{ options.csv_path };
+				WriteCsv(stream);
+			}
+			if (!options.json_path.empty())
+			{
+				std::ofstream stream{ options.json_path };
+				WriteJson(stream);
+			}
+		}
+	};
+}
@@ -0,0 +1,425 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "benchmark.h"
+#include "et_autodiff.h"
+#include "graph_stats.h"
+#include "runtime_expr.h"
+#include "sweep.h"
+#include "tensor.h"
+#include "thread_pool.h"
+
+namespace Bench {
+
+	struct ScalingRow
+	{
+		std::string kernel;
+		uint64_t bytes;
+		size_t threads;
+		double median_ns;
+		double flops;
+		double traffic;
+		double speedup;
+	};
+
+	struct Roofline
+	{
+		double bandwidth;
+		double flops;
+
+		auto Attainable(double intensity) const -> double
+		{
+			return std::min(flops, intensity * bandwidth);
+		}
+	};
+
+	class Workers
+	{
+	private:
+		std::unique_ptr<Et::ThreadPool> _pool;
+		size_t _threads;
+
+	public:
+		Workers(size_t threads) : _pool{ threads > 1 ? std::make_unique<Et::ThreadPool>(threads - 1) : nullptr }, _threads{ threads } {}
+
+		auto Threads() const -> size_t
+		{
+			return _threads;
+		}
+
+		auto Pool() const -> Et::ThreadPool*
+		{
+			return _pool.get();
+		}
+
+		template <typename F>
+		auto For(size_t n, size_t grain, F&& function) -> void
+		{
+			if (_pool)
+			{
+				Et::ParallelFor(*_pool, 0, n, grain, std::forward<F>(function));
+			}
+			else
+			{
+				function(size_t{ 0 }, n);
+			}
+		}
+	};
+
+	class ScalingSuite
+	{
+	private:
+		Runner const& _runner;
+		std::vector<size_t> _thread_counts;
+		std::vector<ScalingRow> _rows;
+		Roofline _roofline{ 0.0, 0.0 };
+
+		constexpr static size_t grain_v = 4096;
+
+		template <typename F>
+		auto _impl_Sweep(std::string const& kernel, uint64_t bytes, double flops, double traffic, F&& body) -> void
+		{
+			if (!_runner.Selected(kernel))
+			{
+				return;
+			}
+			double single_thread_ns = 0.0;
+			for (size_t threads : _thread_counts)
+			{
+				Workers workers{ threads };
+				Result const result = _runner.Measure(kernel, 0, 0, [&]() { body(workers); });
+				single_thread_ns = threads == 1 ? result.median_ns : single_thread_ns;
+				_rows.push_back({ kernel, bytes, threads, result.median_ns, flops, traffic,
+					single_thread_ns > 0.0 ? single_thread_ns / result.median_ns : 0.0 });
+				_impl_PrintRow(std::cout, _rows.back());
+			}
+		}
+
+		auto _impl_PrintRow(std::ostream& stream, ScalingRow const& row) const -> void
+		{
+			auto const flags = stream.flags();
+			auto const precision = stream.precision();
+			double const seconds = row.median_ns * 1e-9;
+			double const intensity = row.traffic > 0.0 ? row.flops / row.traffic : 0.0;
+			double const attainable = _roofline.Attainable(intensity);
+			stream << std::left << std::setw(34) << row.kernel << std::right << std::setw(12) << row.bytes << std::setw(8) << row.threads
+				<< std::fixed << std::setprecision(1) << std::setw(16) << row.median_ns
+				<< std::setprecision(2) << std::setw(10) << row.traffic / seconds * 1e-9 << std::setw(10) << row.flops / seconds * 1e-9
+				<< std::setprecision(3) << std::setw(10) << intensity
+				<< std::setprecision(1) << std::setw(10) << (attainable > 0.0 ? 100.0 * row.flops / seconds / attainable : 0.0)
+				<< std::setprecision(2) << std::setw(9) << row.speedup << std::setw(9) << row.speedup / static_cast<double>(row.threads) << '\n';
+			stream.flags(flags);
+			stream.precision(precision);
+		}
+
+		template <size_t N>
+		auto _impl_WideGraph() -> void
+		{
+			using V = Et::PackD<N>;
+			if (!_runner.Fits(sizeof(V)))
+			{
+				return;
+			}
+			Et::ConstantExpr C{ V{ 0.5 } };
+			Et::VariableExpr X1{ V{ 0.1 } }, X2{ V{ 0.2 } }, X3{ V{ 0.3 } }, X4{ V{ 0.4 } };
+			Et::PlaceholderExpr<V> P;
+
+			auto Y = (sin(X1 * C) + cos(X2 * X1)) * (sin(X3 * C) + cos(X4 * X3)) + (X1 * X2 + X3 * X4) * P;
+			Et::GradientDescentOptimizer optimizer{ Y };
+			constexpr Et::GraphStats stats = Et::graph_stats_v<decltype(Y)>;
+			double const flops = 3.0 * static_cast<double>((stats.unary + stats.binary) * N);
+			double const traffic = 2.0 * static_cast<double>(stats.storage_bytes);
+
+			_impl_Sweep("library/autodiff/wide", sizeof(V), flops, traffic, [&](Workers& workers)
+			{
+				if (workers.Pool() != nullptr)
+				{
+					optimizer.ParallelForwardPass(*workers.Pool(), Et::H(P, V{ 1e-9 })).ParallelMinimize(*workers.Pool(), 1e-9);
+				}
+				else
+				{
+					optimizer.ForwardPass(Et::H(P, V{ 1e-9 })).Minimize(1e-9);
+				}
+				DoNotOptimize(X1());
+			});
+		}
+
+		auto _impl_Sizes() const -> std::vector<uint64_t>
+		{
+			std::vector<uint64_t> sizes;
+			for (uint64_t bytes = 4096; bytes <= _runner.GetOptions().max_bytes; bytes *= 8)
+			{
+				sizes.push_back(bytes);
+			}
+			return sizes;
+		}
+
+	public:
+		ScalingSuite(Runner const& runner) : _runner{ runner }
+		{
+			size_t const max_threads = runner.GetOptions().threads;
+			for (size_t threads = 1; threads < max_threads; threads *= 2)
+			{
+				_thread_counts.push_back(threads);
+			}
+			_thread_counts.push_back(max_threads);
+		}
+
+		auto MeasureRoofline() -> Roofline
+		{
+			size_t const n = static_cast<size_t>(std::max<uint64_t>(_runner.GetOptions().max_bytes, 4096) / sizeof(double));
+			std::vector<double> a(n, 0.0), b(n, 1.0), c(n, 2.0);
+			constexpr size_t accumulators_v = 16;
+			constexpr size_t fma_iterations_v = 1 << 16;
+
+			for (size_t threads : _thread_counts)
+			{
+				Workers workers{ threads };
+				Result const triad = _runner.Measure("stream-triad", 0, 0, [&]()
+				{
+					workers.For(n, grain_v, [&](size_t begin, size_t end)
+					{
+						for (size_t i = begin; i < end; i++)
+						{
+							a[i] = b[i] + 3.0 * c[i];
+						}
+					});
+					DoNotOptimize(a[0]);
+				});
+				_roofline.bandwidth = std::max(_roofline.bandwidth, 3.0 * sizeof(double) * static_cast<double>(n) / (triad.median_ns * 1e-9));
+
+				Result const fma = _runner.Measure("fma-peak", 0, 0, [&]()
+				{
+					workers.For(threads, 1, [&](size_t begin, size_t end)
+					{
+						for (size_t t = begin; t < end; t++)
+						{
+							double acc[accumulators_v];
+							for (size_t j = 0; j < accumulators_v; j++)
+							{
+								acc[j] = static_cast<double>(j + t);
+							}
+							for (size_t i = 0; i < fma_iterations_v; i++)
+							{
+								for (size_t j = 0; j < accumulators_v; j++)
+								{
+									acc[j] = acc[j] * 0.999999 + 1e-6;
+								}
+							}
+							DoNotOptimize(acc);
+						}
+					});
+				});
+				double const flops = 2.0 * accumulators_v * fma_iterations_v * static_cast<double>(threads);
+				_roofline.flops = std::max(_roofline.flops, flops / (fma.median_ns * 1e-9));
+			}
+
+			std::cout << "peak bandwidth " << _roofline.bandwidth * 1e-9 << " GB/s, peak compute " << _roofline.flops * 1e-9 << " GFLOP/s\n\n"
+				<< std::left << std::setw(34) << "kernel" << std::right << std::setw(12) << "bytes" << std::setw(8) << "threads" << std::setw(16) << "median ns"
+				<< std::setw(10) << "GB/s" << std::setw(10) << "GFLOP/s" << std::setw(10) << "flop/B" << std::setw(10) << "roof %"
+				<< std::setw(9) << "speedup" << std::setw(9) << "effic." << '\n';
+			return _roofline;
+		}
+
+		auto ParallelAutodiff() -> void
+		{
+			_impl_WideGraph<512>();
+			_impl_WideGraph<4096>();
+		}
+
+		auto Sweep() -> void
+		{
+			auto const jobs = Et::MakeSweepJobs({ 0.001, 0.005, 0.01, 0.05 }, { { 5.53, -3.12 }, { -20.0, 20.0 }, { 100.0, 0.0 }, { 1.0, 1.0 } });
+			for (int iterations : { 250, 2000 })
+			{
+				_impl_Sweep("library/sweep/" + std::to_string(iterations) + "iters", 0, 0.0, 0.0, [&](Workers& workers)
+				{
+					Et::SweepOptions options;
+					options.threads = workers.Threads();
+					options.iterations = iterations;
+					options.successive_halving = false;
+					auto const results = Et::SweepRunner{ options }.Run(jobs, [](Et::SweepControl& control)
+					{
+						Et::ConstantExpr C1{ 4 }, C2{ 2 };
+						Et::VariableExpr X1{ control.Job().initial_values[0] }, X2{ control.Job().initial_values[1] };
+						Et::PlaceholderExpr P;
+
+						auto Y = X1 * X1 + X2 * X2 + C1 * X1 + C2 * X2 + P;
+						Et::GradientDescentOptimizer optimizer{ Y };
+						for (int i = 1; control.Report(i, optimizer.ForwardPass(Et::H(P, -6.3)).Minimize(control.Job().learning_rate).GetPreResult()); i++);
+						return double(optimizer.GetPostResult());
+					});
+					DoNotOptimize(results.front().loss);
+				});
+			}
+		}
+
+		auto Elementwise() -> void
+		{
+			for (uint64_t bytes : _impl_Sizes())
+			{
+				size_t const n = static_cast<size_t>(bytes / sizeof(double));
+				std::vector<double> x(n, 1.5), y(n, 0.5), z(n, 0.0);
+				_impl_Sweep("baseline/elementwise/multiply", bytes, static_cast<double>(n), 3.0 * static_cast<double>(bytes), [&](Workers& workers)
+				{
+					workers.For(n, grain_v, [&](size_t begin, size_t end)
+					{
+						for (size_t i = begin; i < end; i++)
+						{
+							z[i] = x[i] * y[i];
+						}
+					});
+					DoNotOptimize(z[0]);
+				});
+			}
+		}
+
+		auto Reduction() -> void
+		{
+			for (uint64_t bytes : _impl_Sizes())
+			{
+				size_t const n = static_cast<size_t>(bytes / sizeof(double));
+				std::vector<double> x(n, 1.0);
+				_impl_Sweep("baseline/reduction/sum", bytes, static_cast<double>(n), static_cast<double>(bytes), [&](Workers& workers)
+				{
+					std::mutex mutex;
+					double total = 0.0;
+					workers.For(n, grain_v, [&](size_t begin, size_t end)
+					{
+						double partial = 0.0;
+						for (size_t i = begin; i < end; i++)
+						{
+							partial += x[i];
+						}
+						std::lock_guard<std::mutex> lock{ mutex };
+						total += partial;
+					});
+					DoNotOptimize(total);
+				});
+			}
+		}
+
+		auto Gemm() -> void
+		{
+			for (size_t n = 64; n <= 1024 && 3 * n * n * sizeof(double) <= std::max<uint64_t>(_runner.GetOptions().max_bytes, 3 * 64 * 64 * sizeof(double)); n *= 2)
+			{
+				std::vector<double> a(n * n, 0.5), b(n * n, 2.0), c(n * n, 0.0);
+				double const flops = 2.0 * static_cast<double>(n) * static_cast<double>(n) * static_cast<double>(n);
+				_impl_Sweep("baseline/gemm", 3 * n * n * sizeof(double), flops, 3.0 * static_cast<double>(n * n * sizeof(double)), [&](Workers& workers)
+				{
+					std::fill(c.begin(), c.end(), 0.0);
+					workers.For(n, 1, [&](size_t begin, size_t end)
+					{
+						TTest::gemm(n, n, a.data(), b.data(), c.data(), begin, end);
+					});
+					DoNotOptimize(c[0]);
+				});
+			}
+		}
+
+		auto DataParallelTraining() -> void
+		{
+			auto const program = Et::Runtime::Compile("(w*x + b - y)^2", { "w", "b" }, { "x", "y" });
+			double const flops_per_sample = 4.0 * static_cast<double>(program.Code().size());
+
+			for (uint64_t bytes : _impl_Sizes())
+			{
+				size_t const n = static_cast<size_t>(bytes / (2 * sizeof(double)));
+				std::vector<double> xs(n), ys(n);
+				for (size_t i = 0; i < n; i++)
+				{
+					xs[i] = static_cast<double>(i % 97) / 97.0;
+					ys[i] = 3.0 * xs[i] - 1.0;
+				}
+				_impl_Sweep("baseline/training/least-squares", bytes, flops_per_sample * static_cast<double>(n), static_cast<double>(bytes), [&](Workers& workers)
+				{
+					std::mutex mutex;
+					std::array<double, 2> total{ 0.0, 0.0 };
+					double const weights[2] = { 0.5, 0.0 };
+					workers.For(n, grain_v, [&](size_t begin, size_t end)
+					{
+						Et::Runtime::Evaluator evaluator{ program };
+						std::array<double, 2> sum{ 0.0, 0.0 };
+						double gradient[2];
+						for (size_t i = begin; i < end; i++)
+						{
+							double const sample[2] = { xs[i], ys[i] };
+							evaluator.Gradient(weights, sample, gradient);
+							sum[0] += gradient[0];
+							sum[1] += gradient[1];
+						}
+						std::lock_guard<std::mutex> lock{ mutex };
+						total[0] += sum[0];
+						total[1] += sum[1];
+					});
+					DoNotOptimize(total);
+				});
+			}
+		}
+
+		auto WriteCsv(std::ostream& stream) const -> void
+		{
+			stream << "kernel,bytes,threads,median_ns,gbytes_per_second,gflops,intensity,roofline_gflops,roofline_fraction,speedup,efficiency\n";
+			for (auto const& row : _rows)
+			{
+				double const seconds = row.median_ns * 1e-9;
+				double const intensity = row.traffic > 0.0 ? row.flops / row.traffic : 0.0;
+				double const attainable = _roofline.Attainable(intensity);
+				stream << row.kernel << ',' << row.bytes << ',' << row.threads << ',' << row.median_ns << ','
+					<< row.traffic / seconds * 1e-9 << ',' << row.flops / seconds * 1e-9 << ',' << intensity << ',' << attainable * 1e-9 << ','
+					<< (attainable > 0.0 ? row.flops / seconds / attainable : 0.0) << ',' << row.speedup << ',' << row.speedup / static_cast<double>(row.threads) << '\n';
+			}
+		}
+
+		auto WriteJson(std::ostream& stream) const -> void
+		{
+			stream << "{\n\"roofline\": {\"bandwidth_gbytes_per_second\": " << _roofline.bandwidth * 1e-9
+				<< ", \"peak_gflops\": " << _roofline.flops * 1e-9 << "},\n\"scaling\": [\n";
+			for (size_t i = 0; i < _rows.size(); i++)
+			{
+				auto const& row = _rows[i];
+				double const seconds = row.median_ns * 1e-9;
+				double const intensity = row.traffic > 0.0 ? row.flops / row.traffic : 0.0;
+				double const attainable = _roofline.Attainable(intensity);
+				stream << "{\"kernel\": \"" << row.kernel << "\", \"bytes\": " << row.bytes << ", \"threads\": " << row.threads
+					<< ", \"median_ns\": " << row.median_ns << ", \"gbytes_per_second\": " << row.traffic / seconds * 1e-9
+					<< ", \"gflops\": " << row.flops / seconds * 1e-9 << ", \"intensity\": " << intensity
+					<< ", \"roofline_fraction\": " << (attainable > 0.0 ? row.flops / seconds / attainable : 0.0)
+					<< ", \"speedup\": " << row.speedup << ", \"efficiency\": " << row.speedup / static_cast<double>(row.threads) << "}"
+					<< (i + 1 < _rows.size() ? "," : "") << '\n';
+			}
+			stream << "]\n}\n";
+		}
+
+		auto Run() -> void
+		{
+			MeasureRoofline();
+			ParallelAutodiff();
+			Sweep();
+			Elementwise();
+			Reduction();
+			Gemm();
+			DataParallelTraining();
+
+			auto const& options = _runner.GetOptions();
+			if (!options.csv_path.empty())
+			{
+				std::ofstream stream{ options.csv_path };
+				WriteCsv(stream);
+			}
+			if (!options.json_path.empty())
+			{
+				std::ofstream stream{ options.json_path };
+				WriteJson(stream);
+			}
+		}
+	};
+}
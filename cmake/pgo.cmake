@@ -0,0 +1,43 @@
+# Two-stage profile-guided build driven by the benchmark suite.
+# Invoked by the `pgo` target: cmake -DSOURCE_DIR=... -DBINARY_DIR=... -DCXX_COMPILER=... -DCXX_COMPILER_ID=... -DGENERATOR=... -P pgo.cmake
+
+set(PROFILE_DIR "${BINARY_DIR}/profiles")
+if(NOT DEFINED PGO_TRAINING_ARGS)
+	set(PGO_TRAINING_ARGS --max-bytes 16777216 --repetitions 5 --max-time 0.5)
+endif()
+
+function(run)
+	execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "PGO step failed (${result}): ${ARGN}")
+	endif()
+endfunction()
+
+function(configure_and_build stage directory)
+	run("${CMAKE_COMMAND}" -S "${SOURCE_DIR}" -B "${directory}" -G "${GENERATOR}"
+		-DCMAKE_BUILD_TYPE=Release
+		-DCMAKE_CXX_COMPILER=${CXX_COMPILER}
+		-DET_AUTODIFF_PGO=${stage}
+		-DET_AUTODIFF_PGO_DIR=${PROFILE_DIR}
+		-DET_AUTODIFF_BUILD_TESTS=OFF)
+	run("${CMAKE_COMMAND}" --build "${directory}" --config Release --target ET_AutoDiff_Benchmark ET_AutoDiff_Example)
+endfunction()
+
+file(REMOVE_RECURSE "${PROFILE_DIR}")
+
+message(STATUS "PGO stage 1: instrumented build")
+configure_and_build(GENERATE "${BINARY_DIR}/generate")
+
+message(STATUS "PGO stage 1: training run")
+run("${BINARY_DIR}/generate/ET_AutoDiff_Benchmark" ${PGO_TRAINING_ARGS})
+
+if(CXX_COMPILER_ID MATCHES "Clang")
+	find_program(LLVM_PROFDATA NAMES llvm-profdata REQUIRED)
+	file(GLOB raw_profiles "${PROFILE_DIR}/*.profraw")
+	run("${LLVM_PROFDATA}" merge -output=${PROFILE_DIR}/default.profdata ${raw_profiles})
+endif()
+
+message(STATUS "PGO stage 2: optimized build")
+configure_and_build(USE "${BINARY_DIR}/use")
+
+message(STATUS "PGO binaries: ${BINARY_DIR}/use/ET_AutoDiff_Benchmark and ${BINARY_DIR}/use/ET_AutoDiff_Example")